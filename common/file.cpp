@@ -21,6 +21,8 @@
  */
 
 #include "file.h"
+#include "endian.h"
+#include "util.h"
 #include <stdarg.h>
 #include <stdio.h>
 #include <assert.h>
@@ -28,6 +30,9 @@
 #include <algorithm>
 #include <sys/stat.h>   // for stat()
 #include <sys/types.h>
+#ifdef POSIX
+#include <sys/mman.h>	// for mmap()
+#endif
 #ifndef _MSC_VER
 #include <unistd.h>	// for unlink()
 #else
@@ -222,18 +227,28 @@ File::File() {
 	_file = NULL;
 	_mode = FILEMODE_READ;
 	_xormode = 0;
+	_readBuffer = NULL;
+	_readBufferStart = _readPos = _readEnd = 0;
+	_mapping = _viewBuffer = NULL;
+	_mappingSize = _viewBufferSize = 0;
 }
 
 File::File(const Filename &filepath, const char *mode) {
 	_file = NULL;
 	_mode = FILEMODE_READ;
 	_xormode = 0;
+	_readBuffer = NULL;
+	_readBufferStart = _readPos = _readEnd = 0;
+	_mapping = _viewBuffer = NULL;
+	_mappingSize = _viewBufferSize = 0;
 
 	open(filepath, mode);
 }
 
 File::~File() {
 	close();
+	delete[] _readBuffer;
+	delete[] _viewBuffer;
 }
 
 void File::open(const Filename &filepath, const char *mode) {
@@ -267,34 +282,89 @@ void File::open(const Filename &filepath, const char *mode) {
 }
 
 void File::close() {
+#ifdef POSIX
+	if (_mapping)
+		munmap(_mapping, _mappingSize);
+#endif
+	_mapping = NULL;
+	_mappingSize = 0;
+
 	if (_file)
 		fclose(_file);
 	_file = NULL;
+	_readPos = _readEnd = 0;
 }
 
 void File::setXorMode(uint8 xormode) {
 	_xormode = xormode;
 }
 
+bool File::fillReadBuffer() {
+	if (!_file || (_mode & FILEMODE_READ) == 0)
+		return false;
+
+	if (!_readBuffer)
+		_readBuffer = new byte[READ_BUFFER_SIZE];
+
+	_readBufferStart = ftell(_file);
+	_readPos = 0;
+	_readEnd = fread(_readBuffer, 1, READ_BUFFER_SIZE, _file);
+	if (_readEnd == 0)
+		return false;
+
+	// Running into the end of the file while reading ahead does not mean
+	// the user did, so only an unsuccessful read leaves the EOF flag set
+	if (feof(_file) && !ferror(_file))
+		clearerr(_file);
+	return true;
+}
+
+void File::syncReadBuffer() {
+	if (_readPos != _readEnd)
+		fseek(_file, (long)_readPos - (long)_readEnd, SEEK_CUR);
+	_readPos = _readEnd = 0;
+}
+
+inline const byte *File::getBuffered(uint32 size) {
+	if (_readEnd - _readPos < size) {
+		// Values crossing the end of the buffer are read byte by byte
+		if (_readPos != _readEnd || !fillReadBuffer() || _readEnd < size)
+			return NULL;
+	}
+
+	const byte *ptr = _readBuffer + _readPos;
+	_readPos += size;
+	return ptr;
+}
+
 int File::readChar() {
 	if (!_file)
 		throw FileException("File is not open");
 	if ((_mode & FILEMODE_READ) == 0)
 		throw FileException("Tried to read from file opened in write mode (" + _name.getFullPath() + ")");
 
-	int u8 = fgetc(_file);
-	if (u8 == EOF)
+	if (_readPos == _readEnd && !fillReadBuffer())
 		throw FileException("Read beyond the end of file (" + _name.getFullPath() + ")");
-	u8 ^= _xormode;
-	return u8;
+	return _readBuffer[_readPos++] ^ _xormode;
 }
 
 uint8 File::readByte() {
+	if (_readPos != _readEnd)
+		return _readBuffer[_readPos++] ^ _xormode;
+
 	int u8 = readChar();
 	return (uint8)u8;
 }
 
+// The xor value of every byte of a word at once
+#define XOR16(x) ((uint16)((x) * 0x0101U))
+#define XOR32(x) ((uint32)((x) * 0x01010101U))
+
 uint16 File::readUint16BE() {
+	const byte *ptr = getBuffered(2);
+	if (ptr)
+		return READ_BE_UINT16(ptr) ^ XOR16(_xormode);
+
 	uint16 ret = 0;
 	ret |= uint16(readByte() << 8ul);
 	ret |= uint16(readByte());
@@ -302,6 +372,10 @@ uint16 File::readUint16BE() {
 }
 
 uint16 File::readUint16LE() {
+	const byte *ptr = getBuffered(2);
+	if (ptr)
+		return READ_LE_UINT16(ptr) ^ XOR16(_xormode);
+
 	uint16 ret = 0;
 	ret |= uint16(readByte());
 	ret |= uint16(readByte() << 8ul);
@@ -309,6 +383,10 @@ uint16 File::readUint16LE() {
 }
 
 uint32 File::readUint32BE() {
+	const byte *ptr = getBuffered(4);
+	if (ptr)
+		return READ_BE_UINT32(ptr) ^ XOR32(_xormode);
+
 	uint32 ret = 0;
 	ret |= uint32(readByte() << 24);
 	ret |= uint32(readByte() << 16);
@@ -318,6 +396,10 @@ uint32 File::readUint32BE() {
 }
 
 uint32 File::readUint32LE() {
+	const byte *ptr = getBuffered(4);
+	if (ptr)
+		return READ_LE_UINT32(ptr) ^ XOR32(_xormode);
+
 	uint32 ret = 0;
 	ret |= uint32(readByte());
 	ret |= uint32(readByte() << 8);
@@ -326,36 +408,23 @@ uint32 File::readUint32LE() {
 	return ret;
 }
 
+#undef XOR16
+#undef XOR32
+
 int16 File::readSint16BE() {
-	int16 ret = 0;
-	ret |= int16(readByte() << 8ul);
-	ret |= int16(readByte());
-	return ret;
+	return (int16)readUint16BE();
 }
 
 int16 File::readSint16LE() {
-	int16 ret = 0;
-	ret |= int16(readByte());
-	ret |= int16(readByte() << 8ul);
-	return ret;
+	return (int16)readUint16LE();
 }
 
 int32 File::readSint32BE() {
-	int32 ret = 0;
-	ret |= int32(readByte() << 24);
-	ret |= int32(readByte() << 16);
-	ret |= int32(readByte() << 8);
-	ret |= int32(readByte());
-	return ret;
+	return (int32)readUint32BE();
 }
 
 int32 File::readSint32LE() {
-	int32 ret = 0;
-	ret |= int32(readByte());
-	ret |= int32(readByte() << 8);
-	ret |= int32(readByte() << 16);
-	ret |= int32(readByte() << 24);
-	return ret;
+	return (int32)readUint32LE();
 }
 
 void File::read_throwsOnError(void *dataPtr, size_t dataSize) {
@@ -370,7 +439,58 @@ size_t File::read_noThrow(void *dataPtr, size_t dataSize) {
 	if ((_mode & FILEMODE_READ) == 0)
 		throw FileException("Tried to read from file opened in write mode (" + _name.getFullPath() + ")");
 
-	return fread(dataPtr, 1, dataSize, _file);
+	// Hand out what was read ahead first, the rest comes straight from the file
+	size_t buffered = MIN<size_t>(_readEnd - _readPos, dataSize);
+	if (buffered) {
+		memcpy(dataPtr, _readBuffer + _readPos, buffered);
+		_readPos += buffered;
+		if (buffered == dataSize)
+			return buffered;
+	}
+
+	return buffered + fread((byte *)dataPtr + buffered, 1, dataSize - buffered, _file);
+}
+
+const byte *File::view(uint32 offset, uint32 dataSize) {
+	if (!_file)
+		throw FileException("File is not open");
+	if (_mode & FILEMODE_WRITE)
+		throw FileException("Tried to map a file opened in write mode (" + _name.getFullPath() + ")");
+
+#ifdef POSIX
+	if (!_mapping && _mappingSize == 0) {
+		_mappingSize = size();
+		if (_mappingSize > 0) {
+			void *mapping = mmap(NULL, _mappingSize, PROT_READ, MAP_PRIVATE, fileno(_file), 0);
+			if (mapping != MAP_FAILED)
+				_mapping = (byte *)mapping;
+		}
+	}
+
+	if (_mapping) {
+		if (offset > _mappingSize || dataSize > _mappingSize - offset)
+			throw FileException("Read beyond the end of file (" + _name.getFullPath() + ")");
+		return _mapping + offset;
+	}
+#endif
+
+	// Not mapped, read the data in without moving the cursor
+	if (dataSize > _viewBufferSize) {
+		delete[] _viewBuffer;
+		_viewBuffer = new byte[dataSize];
+		_viewBufferSize = dataSize;
+	}
+
+	syncReadBuffer();
+	long oldPos = ftell(_file);
+	if (fseek(_file, offset, SEEK_SET) != 0)
+		throw FileException("Could not seek in file (" + _name.getFullPath() + ")");
+	size_t dataRead = fread(_viewBuffer, 1, dataSize, _file);
+	fseek(_file, oldPos, SEEK_SET);
+	if (dataRead != dataSize)
+		throw FileException("Read beyond the end of file (" + _name.getFullPath() + ")");
+
+	return _viewBuffer;
 }
 
 std::string File::readString() {
@@ -415,6 +535,7 @@ void File::scanString(char *result) {
 	if ((_mode & FILEMODE_READ) == 0)
 		throw FileException("Tried to write to file opened in read mode (" + _name.getFullPath() + ")");
 
+	syncReadBuffer();
 	fscanf(_file, "%s", result);
 }
 
@@ -426,6 +547,7 @@ void File::writeChar(char i) {
 
 	i ^= _xormode;
 
+	syncReadBuffer();
 	if (fwrite(&i, 1, 1, _file) != 1)
 		throw FileException("Could not write to file (" + _name.getFullPath() + ")");
 }
@@ -466,6 +588,7 @@ size_t File::write(const void *dataPtr, size_t dataSize) {
 
 	assert(_xormode == 0);	// FIXME: This method does not work in XOR mode (and probably shouldn't)
 
+	syncReadBuffer();
 	size_t data_read = fwrite(dataPtr, 1, dataSize, _file);
 	if (data_read != dataSize)
 		throw FileException("Could not write to file (" + _name.getFullPath() + ")");
@@ -480,6 +603,8 @@ void File::print(const char *format, ...) {
 		throw FileException("Tried to write to file opened in read mode (" + _name.getFullPath() + ")");
 
 
+	syncReadBuffer();
+
 	va_list va;
 
 	va_start(va, format);
@@ -487,20 +612,36 @@ void File::print(const char *format, ...) {
 	va_end(va);
 }
 
-void File::seek(long offset, int origin) {
+void File::seek(int32 offset, int origin) {
 	if (!_file)
 		throw FileException("File is not open");
 
+	if (_readPos != _readEnd) {
+		// Seeks that stay inside the read buffer do not have to touch the file
+		long target = (origin == SEEK_CUR) ? (long)(_readBufferStart + _readPos) + offset : offset;
+		if (origin != SEEK_END && target >= (long)_readBufferStart && target <= (long)(_readBufferStart + _readEnd)) {
+			_readPos = target - _readBufferStart;
+			return;
+		}
+
+		if (origin == SEEK_CUR)
+			offset -= _readEnd - _readPos;
+	}
+
+	// Only drop the buffered bytes once the seek succeeded, so a failed
+	// seek leaves pos() where it was
 	if (fseek(_file, offset, origin) != 0)
 		throw FileException("Could not seek in file (" + _name.getFullPath() + ")");
+	_readPos = _readEnd = 0;
 }
 
 void File::rewind() {
+	_readPos = _readEnd = 0;
 	return ::rewind(_file);
 }
 
-int File::pos() const {
-	return ftell(_file);
+uint32 File::pos() const {
+	return ftell(_file) - (_readEnd - _readPos);
 }
 
 int File::err() const {
@@ -512,6 +653,8 @@ void File::clearErr() {
 }
 
 bool File::eos() const {
+	if (_readPos != _readEnd)
+		return false;
 	return feof(_file) != 0;
 }
 
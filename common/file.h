@@ -25,6 +25,7 @@
 
 #include "common/scummsys.h"
 #include "common/noncopyable.h"
+#include "common/stream.h"
 
 #include "tool_exception.h"
 
@@ -159,9 +160,10 @@ enum FileMode {
 /**
  * A basic wrapper around the FILE class.
  * Offers functionality to write words easily, and deallocates the FILE
- * automatically on destruction.
+ * automatically on destruction. For reading it can be used wherever a
+ * SeekableReadStream is expected.
  */
-class File : public NonCopyable {
+class File : public SeekableReadStream, public NonCopyable {
 public:
 	/**
 	 * Opens the given file path as an in/out stream, depending on the
@@ -277,6 +279,25 @@ public:
 	 */
 	size_t read_noThrow(void *dataPtr, size_t dataSize);
 
+	/**
+	 * The same as read_noThrow, for the SeekableReadStream interface.
+	 */
+	uint32 read(void *dataPtr, uint32 dataSize) { return read_noThrow(dataPtr, dataSize); }
+
+	/**
+	 * Returns the data at the given offset without copying it if possible.
+	 * Files opened read-only are mapped into memory the first time this is
+	 * called, where the platform supports it; otherwise the data is read
+	 * into a buffer owned by the file. Like read, this ignores the xor mode
+	 * and it does not move the file cursor.
+	 * @throws FileException if the file is not open for reading only / if the range is beyond the end of file.
+	 *
+	 * @param offset	where the data starts in the file
+	 * @param dataSize	number of bytes that are needed
+	 * @return the data, valid until the next call or until the file is closed.
+	 */
+	const byte *view(uint32 offset, uint32 dataSize);
+
 	/**
 	 * Reads a full string, until NULL or EOF.
 	 * @throws FileException if file is not open / if read failed.
@@ -349,7 +370,7 @@ public:
 	 * @param offset how many bytes to jump
 	 * @param origin SEEK_SET, SEEK_CUR or SEEK_END
 	 */
-	void seek(long offset, int origin);
+	void seek(int32 offset, int origin = SEEK_SET);
 
 	/**
 	 * Resets the file pointer to the start of the file, in essence the same as re-opening it.
@@ -359,7 +380,7 @@ public:
 	/**
 	 * Returns current position of the file cursor.
 	 */
-	int pos() const;
+	uint32 pos() const;
 
 	/**
 	 * Check whether an error occurred.
@@ -379,9 +400,13 @@ public:
 	uint32 size() const;
 
 	// FIXME: Remove this method eventually
-	FILE *getFileHandle() { return _file; }
+	FILE *getFileHandle() { syncReadBuffer(); return _file; }
 
 protected:
+	enum {
+		READ_BUFFER_SIZE = 4096
+	};
+
 	/** The mode the file was opened in. */
 	FileMode _mode;
 	/** Internal reference to the file. */
@@ -390,6 +415,34 @@ protected:
 	Filename _name;
 	/** xor with this value while reading/writing (default 0), does not work for "read"/"write", only for byte operations. */
 	uint8 _xormode;
+
+	/**
+	 * Bytes read ahead from the file, so that the integer read* methods
+	 * do not have to go through stdio for every byte. The stdio position is
+	 * _readEnd - _readPos bytes ahead of the position the user sees.
+	 */
+	byte *_readBuffer;
+	/** File offset of the first byte in _readBuffer. */
+	uint32 _readBufferStart;
+	uint32 _readPos;
+	uint32 _readEnd;
+
+	/** The whole file as mapped by view(), or NULL. */
+	byte *_mapping;
+	uint32 _mappingSize;
+	/** Holds the data returned by view() if the file could not be mapped. */
+	byte *_viewBuffer;
+	uint32 _viewBufferSize;
+
+	/**
+	 * Refills the read buffer from the current file position.
+	 * @return false if nothing could be read.
+	 */
+	bool fillReadBuffer();
+	/** Moves the stdio position back to what the user sees and empties the read buffer. */
+	void syncReadBuffer();
+	/** Returns a pointer to the next size bytes and skips them, or NULL if they are not buffered. */
+	const byte *getBuffered(uint32 size);
 };
 
 
@@ -0,0 +1,130 @@
+/* ScummVM Tools
+ * Copyright (C) 2002-2009 The ScummVM project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#include "common/memstream.h"
+#include "common/endian.h"
+#include "tool_exception.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace Common {
+
+MemoryWriteStreamDynamic::MemoryWriteStreamDynamic() : _data(NULL), _capacity(0), _size(0), _pos(0) {
+}
+
+MemoryWriteStreamDynamic::~MemoryWriteStreamDynamic() {
+	free(_data);
+}
+
+void MemoryWriteStreamDynamic::ensureCapacity(uint32 capacity) {
+	if (capacity <= _capacity)
+		return;
+
+	// Grow geometrically, so that appending many small chunks stays cheap
+	uint32 newCapacity = (_capacity < 4096 ? 4096 : _capacity);
+	while (newCapacity < capacity)
+		newCapacity *= 2;
+
+	byte *newData = (byte *)realloc(_data, newCapacity);
+	if (!newData)
+		throw ToolException("Out of memory");
+	_data = newData;
+	_capacity = newCapacity;
+}
+
+void MemoryWriteStreamDynamic::writeByte(uint8 b) {
+	write(&b, 1);
+}
+
+void MemoryWriteStreamDynamic::writeUint16BE(uint16 value) {
+	byte buf[2];
+	WRITE_BE_UINT16(buf, value);
+	write(buf, 2);
+}
+
+void MemoryWriteStreamDynamic::writeUint16LE(uint16 value) {
+	byte buf[2];
+	WRITE_LE_UINT16(buf, value);
+	write(buf, 2);
+}
+
+void MemoryWriteStreamDynamic::writeUint32BE(uint32 value) {
+	byte buf[4];
+	WRITE_BE_UINT32(buf, value);
+	write(buf, 4);
+}
+
+void MemoryWriteStreamDynamic::writeUint32LE(uint32 value) {
+	byte buf[4];
+	WRITE_LE_UINT32(buf, value);
+	write(buf, 4);
+}
+
+size_t MemoryWriteStreamDynamic::write(const void *dataPtr, size_t dataSize) {
+	if (dataSize == 0)
+		return 0;
+
+	ensureCapacity(_pos + dataSize);
+	memcpy(_data + _pos, dataPtr, dataSize);
+	_pos += dataSize;
+	if (_pos > _size)
+		_size = _pos;
+	return dataSize;
+}
+
+void MemoryWriteStreamDynamic::seek(long offset, int origin) {
+	long newPos;
+
+	switch (origin) {
+	case SEEK_CUR:
+		newPos = _pos + offset;
+		break;
+	case SEEK_END:
+		newPos = _size + offset;
+		break;
+	case SEEK_SET:
+	default:
+		newPos = offset;
+		break;
+	}
+
+	if (newPos < 0 || newPos > (long)_size)
+		throw ToolException("Seek outside of memory stream");
+	_pos = (uint32)newPos;
+}
+
+byte *MemoryWriteStreamDynamic::releaseData() {
+	byte *data = _data;
+	_data = NULL;
+	_capacity = _size = _pos = 0;
+	return data;
+}
+
+void MemoryWriteStreamDynamic::clear() {
+	free(_data);
+	_data = NULL;
+	_capacity = _size = _pos = 0;
+}
+
+} // End of namespace Common
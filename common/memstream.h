@@ -0,0 +1,121 @@
+/* ScummVM Tools
+ * Copyright (C) 2002-2009 The ScummVM project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#ifndef COMMON_MEMSTREAM_H
+#define COMMON_MEMSTREAM_H
+
+#include "common/scummsys.h"
+#include "common/noncopyable.h"
+
+namespace Common {
+
+/**
+ * A write stream into a memory buffer, which grows as needed.
+ * Offers the same write methods as Common::File, so that data can be
+ * prepared in memory before it is stored, without going through a
+ * temporary file.
+ */
+class MemoryWriteStreamDynamic : public NonCopyable {
+public:
+	MemoryWriteStreamDynamic();
+	~MemoryWriteStreamDynamic();
+
+	/**
+	 * Writes a single byte to the stream.
+	 */
+	void writeByte(uint8 b);
+	/**
+	 * Writes a single 16-bit word to the stream, big endian.
+	 */
+	void writeUint16BE(uint16 value);
+	/**
+	 * Writes a single 16-bit word to the stream, little endian.
+	 */
+	void writeUint16LE(uint16 value);
+	/**
+	 * Writes a single 32-bit word to the stream, big endian.
+	 */
+	void writeUint32BE(uint32 value);
+	/**
+	 * Writes a single 32-bit word to the stream, little endian.
+	 */
+	void writeUint32LE(uint32 value);
+
+	/**
+	 * Writes the data at the current position, overwriting what is
+	 * there already and growing the buffer if needed.
+	 *
+	 * @param dataPtr	pointer to the data to be written
+	 * @param dataSize	number of bytes to be written
+	 * @return the number of bytes written, which is always dataSize.
+	 */
+	size_t write(const void *dataPtr, size_t dataSize);
+
+	/**
+	 * Seek to the specified position in the stream.
+	 *
+	 * @param offset how many bytes to jump
+	 * @param origin SEEK_SET, SEEK_CUR or SEEK_END
+	 * @throws ToolException if the position is outside of the data.
+	 */
+	void seek(long offset, int origin);
+
+	/**
+	 * Returns the current position in the stream.
+	 */
+	int pos() const { return _pos; }
+
+	/**
+	 * Returns the number of bytes written to the stream so far.
+	 */
+	uint32 size() const { return _size; }
+
+	/**
+	 * Returns the data written so far. The pointer is only valid until
+	 * the next write.
+	 */
+	byte *getData() { return _data; }
+	const byte *getData() const { return _data; }
+
+	/**
+	 * Hands the data over to the caller, who must free() it, and leaves
+	 * the stream empty.
+	 */
+	byte *releaseData();
+
+	/**
+	 * Throws away all data, and leaves the stream empty.
+	 */
+	void clear();
+
+private:
+	void ensureCapacity(uint32 capacity);
+
+	byte *_data;
+	uint32 _capacity;
+	uint32 _size;
+	uint32 _pos;
+};
+
+} // End of namespace Common
+
+#endif
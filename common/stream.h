@@ -15,8 +15,8 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  *
- * $URL: https://scummvm.svn.sourceforge.net/svnroot/scummvm/tools/branches/gsoc2009-gui/utils/stream.h $
- * $Id: stream.h 40868 2009-05-24 15:19:28Z lordhoto $
+ * $URL$
+ * $Id$
  *
  */
 
@@ -24,6 +24,7 @@
 #define COMMON_STREAM_H
 
 #include "common/scummsys.h"
+#include "common/endian.h"
 
 namespace Common {
 
@@ -72,43 +73,43 @@ public:
 	virtual uint32 read(void *dataPtr, uint32 dataSize) = 0;
 
 
-	// The remaining methods all have default implementations; subclasses
-	// need not (and should not) overload them.
+	// The remaining methods all have default implementations built on
+	// read(); the bytes missing at the end of the stream read as zero.
+	// Subclasses which can do better, or which report reading beyond the
+	// end differently (like Common::File does), overload them.
 
-	byte readByte() {
+	virtual byte readByte() {
 		byte b = 0;
 		read(&b, 1);
 		return b;
 	}
 
 	int8 readSByte() {
-		int8 b = 0;
-		read(&b, 1);
-		return b;
+		return (int8)readByte();
 	}
 
-	uint16 readUint16LE() {
-		uint16 a = readByte();
-		uint16 b = readByte();
-		return a | (b << 8);
+	virtual uint16 readUint16LE() {
+		byte b[2] = { 0, 0 };
+		read(b, 2);
+		return READ_LE_UINT16(b);
 	}
 
-	uint32 readUint32LE() {
-		uint32 a = readUint16LE();
-		uint32 b = readUint16LE();
-		return (b << 16) | a;
+	virtual uint32 readUint32LE() {
+		byte b[4] = { 0, 0, 0, 0 };
+		read(b, 4);
+		return READ_LE_UINT32(b);
 	}
 
-	uint16 readUint16BE() {
-		uint16 b = readByte();
-		uint16 a = readByte();
-		return a | (b << 8);
+	virtual uint16 readUint16BE() {
+		byte b[2] = { 0, 0 };
+		read(b, 2);
+		return READ_BE_UINT16(b);
 	}
 
-	uint32 readUint32BE() {
-		uint32 b = readUint16BE();
-		uint32 a = readUint16BE();
-		return (b << 16) | a;
+	virtual uint32 readUint32BE() {
+		byte b[4] = { 0, 0, 0, 0 };
+		read(b, 4);
+		return READ_BE_UINT32(b);
 	}
 
 	int16 readSint16LE() {
@@ -190,34 +191,59 @@ public:
 	}
 };
 
-/*
+/**
  * SeekableSubReadStream provides access to a SeekableReadStream restricted to
- * the range [begin, end).
- * The same caveats apply to SeekableSubReadStream as do to SeekableReadStream.
+ * the range [begin, end), as a stream of its own. The parent is positioned
+ * before every read, so several substreams of one parent, or other users of
+ * the parent, do not step on each others toes.
  */
-class SeekableSubReadStream : public SubReadStream, public SeekableReadStream {
+class SeekableSubReadStream : public SeekableReadStream {
 protected:
 	SeekableReadStream *_parentStream;
+	bool _disposeParentStream;
 	uint32 _begin;
+	uint32 _end;
+	uint32 _pos;
+	bool _eos;
 public:
 	SeekableSubReadStream(SeekableReadStream *parentStream, uint32 begin, uint32 end, bool disposeParentStream = false)
-		: SubReadStream(parentStream, end, disposeParentStream),
-		_parentStream(parentStream),
-		_begin(begin) {
+		: _parentStream(parentStream),
+		  _disposeParentStream(disposeParentStream),
+		  _begin(begin),
+		  _end(end),
+		  _pos(begin),
+		  _eos(false) {
+		assert(parentStream);
 		assert(_begin <= _end);
-		_pos = _begin;
+	}
+
+	~SeekableSubReadStream() {
+		if (_disposeParentStream) delete _parentStream;
+	}
+
+	virtual bool eos() const { return _eos; }
+
+	virtual uint32 read(void *dataPtr, uint32 dataSize) {
+		if (dataSize > _end - _pos) {
+			dataSize = _end - _pos;
+			_eos = true;
+		}
+		if (dataSize == 0)
+			return 0;
+
 		_parentStream->seek(_pos);
-		_eos = false;
+		uint32 dataRead = _parentStream->read(dataPtr, dataSize);
+		if (dataRead != dataSize)
+			_eos = true;
+		_pos += dataRead;
+
+		return dataRead;
 	}
 
 	virtual uint32 pos() const { return _pos - _begin; }
 	virtual uint32 size() const { return _end - _begin; }
-	virtual bool eos() const { return _parentStream->eos(); }
 
 	virtual void seek(int32 offset, int whence = SEEK_SET) {
-		assert(_pos >= _begin);
-		assert(_pos <= _end);
-
 		switch(whence) {
 		case SEEK_END:
 			offset = size() + offset;
@@ -231,15 +257,58 @@ public:
 
 		assert(_pos >= _begin);
 		assert(_pos <= _end);
-
-		_parentStream->seek(_pos);
+		_eos = false;
 	}
+};
+
+/**
+ * Simple memory based 'stream', which implements the SeekableReadStream interface for
+ * a plain memory block. The memory block is not copied, nor freed.
+ */
+class MemoryReadStream : public SeekableReadStream {
+private:
+	const byte *_ptr;
+	uint32 _size;
+	uint32 _pos;
+	bool _eos;
+
+public:
+	MemoryReadStream(const byte *dataPtr, uint32 dataSize)
+		: _ptr(dataPtr), _size(dataSize), _pos(0), _eos(false) {}
+
+	virtual bool eos() const { return _eos; }
 
 	virtual uint32 read(void *dataPtr, uint32 dataSize) {
-		return SubReadStream::read(dataPtr, dataSize);
+		if (dataSize > _size - _pos) {
+			dataSize = _size - _pos;
+			_eos = true;
+		}
+		memcpy(dataPtr, _ptr + _pos, dataSize);
+		_pos += dataSize;
+		return dataSize;
 	}
-};
 
+	virtual uint32 pos() const { return _pos; }
+	virtual uint32 size() const { return _size; }
+
+	virtual void seek(int32 offset, int whence = SEEK_SET) {
+		switch(whence) {
+		case SEEK_END:
+			offset = size() + offset;
+			// fallthrough
+		case SEEK_SET:
+			_pos = offset;
+			break;
+		case SEEK_CUR:
+			_pos += offset;
+		}
+
+		// Reading beyond the end gives nothing, like it does for files
+		if (_pos > _size)
+			_pos = _size;
+		_eos = false;
+	}
+};
 
 }	// End of namespace Common
 
@@ -0,0 +1,303 @@
+/* ScummVM Tools
+ * Copyright (C) 2002-2009 The ScummVM project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#include "common/thread.h"
+#include "tool_exception.h"
+
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
+
+namespace Common {
+
+#ifdef USE_PTHREADS
+
+bool hasThreadSupport() {
+	return true;
+}
+
+Mutex::Mutex() {
+	pthread_mutex_t *mutex = new pthread_mutex_t;
+	pthread_mutex_init(mutex, NULL);
+	_mutex = (MutexRef)mutex;
+}
+
+Mutex::~Mutex() {
+	pthread_mutex_t *mutex = (pthread_mutex_t *)_mutex;
+	pthread_mutex_destroy(mutex);
+	delete mutex;
+}
+
+void Mutex::lock() {
+	pthread_mutex_lock((pthread_mutex_t *)_mutex);
+}
+
+void Mutex::unlock() {
+	pthread_mutex_unlock((pthread_mutex_t *)_mutex);
+}
+
+Condition::Condition() {
+	pthread_cond_t *cond = new pthread_cond_t;
+	pthread_cond_init(cond, NULL);
+	_cond = (ConditionRef)cond;
+}
+
+Condition::~Condition() {
+	pthread_cond_t *cond = (pthread_cond_t *)_cond;
+	pthread_cond_destroy(cond);
+	delete cond;
+}
+
+void Condition::wait(Mutex &mutex) {
+	pthread_cond_wait((pthread_cond_t *)_cond, (pthread_mutex_t *)mutex._mutex);
+}
+
+void Condition::signal() {
+	pthread_cond_signal((pthread_cond_t *)_cond);
+}
+
+void Condition::broadcast() {
+	pthread_cond_broadcast((pthread_cond_t *)_cond);
+}
+
+#else
+
+// Without thread support there is only ever one thread, so there is
+// nothing to lock, and nobody to wait for.
+
+bool hasThreadSupport() {
+	return false;
+}
+
+Mutex::Mutex() : _mutex(NULL) {
+}
+
+Mutex::~Mutex() {
+}
+
+void Mutex::lock() {
+}
+
+void Mutex::unlock() {
+}
+
+Condition::Condition() : _cond(NULL) {
+}
+
+Condition::~Condition() {
+}
+
+void Condition::wait(Mutex &mutex) {
+}
+
+void Condition::signal() {
+}
+
+void Condition::broadcast() {
+}
+
+#endif
+
+JobQueue::JobQueue(int numThreads) : _numThreads(numThreads), _stop(false) {
+	if (!hasThreadSupport() || _numThreads < 1)
+		_numThreads = 1;
+
+#ifdef USE_PTHREADS
+	if (_numThreads == 1)
+		return;
+
+	for (int i = 0; i < _numThreads; i++) {
+		pthread_t *thread = new pthread_t;
+		if (pthread_create(thread, NULL, workerMain, this) != 0) {
+			delete thread;
+			break;
+		}
+		_threads.push_back((ThreadRef)thread);
+	}
+
+	// Fall back to running jobs in push() if no thread could be created
+	if (_threads.empty())
+		_numThreads = 1;
+#endif
+}
+
+JobQueue::~JobQueue() {
+	_mutex.lock();
+	_stop = true;
+	_workAvailable.broadcast();
+	_mutex.unlock();
+
+#ifdef USE_PTHREADS
+	for (uint i = 0; i < _threads.size(); i++) {
+		pthread_t *thread = (pthread_t *)_threads[i];
+		pthread_join(*thread, NULL);
+		delete thread;
+	}
+#endif
+
+	for (uint i = 0; i < _entries.size(); i++)
+		delete _entries[i].job;
+}
+
+void JobQueue::runJob(Job *job) {
+	try {
+		job->run();
+	} catch (ToolException &err) {
+		job->_failed = true;
+		job->_error = err.what();
+		job->_retcode = err._retcode;
+	} catch (std::exception &err) {
+		job->_failed = true;
+		job->_error = err.what();
+		job->_retcode = -1;
+	}
+}
+
+void JobQueue::push(Job *job) {
+	Entry entry;
+	entry.job = job;
+	entry.started = false;
+	entry.done = false;
+
+	if (_threads.empty()) {
+		runJob(job);
+		entry.started = entry.done = true;
+		_entries.push_back(entry);
+		return;
+	}
+
+	StackLock lock(_mutex);
+	_entries.push_back(entry);
+	_workAvailable.signal();
+}
+
+Job *JobQueue::pop() {
+	Job *job;
+
+	{
+		StackLock lock(_mutex);
+		if (_entries.empty())
+			return NULL;
+		while (!_entries.front().done)
+			_jobDone.wait(_mutex);
+		job = _entries.front().job;
+		_entries.pop_front();
+	}
+
+	if (job->_failed) {
+		ToolException err(job->_error, job->_retcode);
+		delete job;
+		throw err;
+	}
+	return job;
+}
+
+uint JobQueue::size() {
+	StackLock lock(_mutex);
+	return _entries.size();
+}
+
+OrderedJobWindow::OrderedJobWindow(int numThreads) : _queue(numThreads), _numPushed(0) {
+	_capacity = 2 * _queue.getNumThreads();
+}
+
+void OrderedJobWindow::push(Job *job) {
+	// Completing a job may queue a follow-up job, so check again after each
+	try {
+		while (_queue.size() >= _capacity)
+			completeOldest();
+	} catch (...) {
+		delete job;
+		throw;
+	}
+
+	_queue.push(job);
+	_numPushed++;
+
+	// Without threads the job has run already, so complete it right away
+	if (_queue.getNumThreads() == 1)
+		completeOldest();
+}
+
+bool OrderedJobWindow::completeOldest() {
+	Job *job = _queue.pop();
+	if (!job)
+		return false;
+
+	try {
+		job->complete();
+	} catch (...) {
+		delete job;
+		throw;
+	}
+	delete job;
+	return true;
+}
+
+void OrderedJobWindow::completeAll() {
+	while (completeOldest())
+		;
+}
+
+void *JobQueue::workerMain(void *queue) {
+	((JobQueue *)queue)->work();
+	return NULL;
+}
+
+void JobQueue::work() {
+	_mutex.lock();
+	while (!_stop) {
+		// Jobs are picked up in order; entries before the first unstarted
+		// one are either running on another thread or waiting to be popped.
+		Entry *entry = NULL;
+		for (uint i = 0; i < _entries.size(); i++) {
+			if (!_entries[i].started) {
+				entry = &_entries[i];
+				break;
+			}
+		}
+
+		if (!entry) {
+			_workAvailable.wait(_mutex);
+			continue;
+		}
+
+		Job *job = entry->job;
+		entry->started = true;
+		_mutex.unlock();
+
+		runJob(job);
+
+		_mutex.lock();
+		// The entry may have moved in the deque meanwhile, so look it up again
+		for (uint i = 0; i < _entries.size(); i++) {
+			if (_entries[i].job == job) {
+				_entries[i].done = true;
+				break;
+			}
+		}
+		_jobDone.broadcast();
+	}
+	_mutex.unlock();
+}
+
+} // End of namespace Common
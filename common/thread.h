@@ -0,0 +1,232 @@
+/* ScummVM Tools
+ * Copyright (C) 2002-2009 The ScummVM project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#ifndef COMMON_THREAD_H
+#define COMMON_THREAD_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "common/scummsys.h"
+#include "common/noncopyable.h"
+
+namespace Common {
+
+typedef struct OpaqueMutex *MutexRef;
+typedef struct OpaqueCondition *ConditionRef;
+typedef struct OpaqueThread *ThreadRef;
+
+/**
+ * Returns true if the tools were built with thread support. Without it,
+ * everything below still works, but all jobs run on the calling thread.
+ */
+bool hasThreadSupport();
+
+/**
+ * A simple (non-recursive) mutex.
+ */
+class Mutex : public NonCopyable {
+public:
+	Mutex();
+	~Mutex();
+
+	void lock();
+	void unlock();
+
+private:
+	friend class Condition;
+	MutexRef _mutex;
+};
+
+/**
+ * Locks a mutex for as long as the object exists.
+ */
+class StackLock : public NonCopyable {
+public:
+	StackLock(Mutex &mutex) : _mutex(mutex) { _mutex.lock(); }
+	~StackLock() { _mutex.unlock(); }
+
+private:
+	Mutex &_mutex;
+};
+
+/**
+ * A condition variable, to be used together with a locked Mutex.
+ */
+class Condition : public NonCopyable {
+public:
+	Condition();
+	~Condition();
+
+	/** Atomically unlocks the mutex, waits for a signal and locks it again. */
+	void wait(Mutex &mutex);
+	void signal();
+	void broadcast();
+
+private:
+	ConditionRef _cond;
+};
+
+/**
+ * A unit of work for a JobQueue.
+ *
+ * run() is called on a worker thread, so it must only touch data owned by
+ * the job itself. Anything that has to happen in order, like writing the
+ * result to an output file, belongs to whoever pops the job off the queue,
+ * or to complete() when the job runs in an OrderedJobWindow.
+ */
+class Job {
+public:
+	Job() : _failed(false), _retcode(0) {}
+	virtual ~Job() {}
+
+	virtual void run() = 0;
+
+	/**
+	 * Called by OrderedJobWindow on the thread that owns the window, once
+	 * run() is done, in the order the jobs were pushed.
+	 */
+	virtual void complete() {}
+
+private:
+	friend class JobQueue;
+
+	bool _failed;
+	std::string _error;
+	int _retcode;
+};
+
+/**
+ * Runs jobs on a number of worker threads, and hands them back in the
+ * order they were pushed, regardless of the order they finished in.
+ *
+ * With a single thread (or if the tools were built without thread support)
+ * jobs are run right away by push(), which makes the queue behave exactly
+ * like calling run() directly.
+ */
+class JobQueue : public NonCopyable {
+public:
+	JobQueue(int numThreads);
+
+	/**
+	 * Stops the worker threads. Jobs that were not popped yet are deleted
+	 * without being handed back.
+	 */
+	~JobQueue();
+
+	/** Queues a job. The queue takes ownership of it until it is popped. */
+	void push(Job *job);
+
+	/**
+	 * Waits for the oldest job to finish and returns it; the caller
+	 * takes ownership. Returns NULL if the queue is empty.
+	 *
+	 * @throws ToolException if run() threw, after deleting the job.
+	 */
+	Job *pop();
+
+	/** Number of jobs pushed but not popped yet. */
+	uint size();
+
+	bool empty() { return size() == 0; }
+
+	int getNumThreads() const { return _numThreads; }
+
+private:
+	struct Entry {
+		Job *job;
+		bool started;
+		bool done;
+	};
+
+	static void *workerMain(void *queue);
+	void work();
+	static void runJob(Job *job);
+
+	int _numThreads;
+	bool _stop;
+
+	std::deque<Entry> _entries;
+	std::vector<ThreadRef> _threads;
+
+	Mutex _mutex;
+	Condition _workAvailable;
+	Condition _jobDone;
+};
+
+/**
+ * Runs jobs on a JobQueue for tools which create their jobs in order and
+ * need the results in that same order, and completes them as they come.
+ *
+ * At most twice as many jobs as there are threads are in flight: that keeps
+ * all threads busy while the owner completes the oldest job, but does not
+ * read ahead too far, as every job in flight usually holds its input or its
+ * output in memory. With a single thread, every job is completed right when
+ * it is pushed, exactly as if it was run directly.
+ */
+class OrderedJobWindow : public NonCopyable {
+public:
+	OrderedJobWindow(int numThreads);
+
+	/**
+	 * Queues a job; the window takes ownership of it. If the window is
+	 * full, the oldest job is completed first. May be called from
+	 * complete() to queue a follow-up job.
+	 *
+	 * @throws ToolException if run() or complete() of a job threw.
+	 */
+	void push(Job *job);
+
+	/**
+	 * Waits for the oldest job, completes and deletes it (also if
+	 * complete() throws). Returns false if the window was empty.
+	 */
+	bool completeOldest();
+
+	/** Completes all jobs in the window. */
+	void completeAll();
+
+	/** Maximum number of jobs in flight. */
+	uint getCapacity() const { return _capacity; }
+
+	/**
+	 * Returns a number below getCapacity() which no other job in the window
+	 * has, valid for the next job pushed. Jobs needing resources of their
+	 * own, like temporary files, can use it to pick one.
+	 */
+	uint getNextSlot() const { return _numPushed % _capacity; }
+
+	int getNumThreads() const { return _queue.getNumThreads(); }
+
+	uint size() { return _queue.size(); }
+	bool empty() { return _queue.empty(); }
+
+private:
+	JobQueue _queue;
+	uint _capacity;
+	uint _numPushed;
+};
+
+} // End of namespace Common
+
+#endif
@@ -22,10 +22,17 @@
 
 #include "common/util.h"
 
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef WIN32
+#include <time.h>
+#else
+#include <sys/time.h>
+#endif
+
 #ifdef _MSC_VER
 	#define	vsnprintf _vsnprintf
 #endif
@@ -54,10 +61,19 @@ void warning(const char *s, ...) {
 	fprintf(stderr, "WARNING: %s!\n", buf);
 }
 
-void debug(int /*level*/, const char *s, ...) {
+static int debugLevel = INT_MAX;
+
+void setDebugLevel(int level) {
+	debugLevel = level;
+}
+
+void debug(int level, const char *s, ...) {
 	char buf[1024];
 	va_list va;
 
+	if (level > debugLevel)
+		return;
+
 	va_start(va, s);
 	vsnprintf(buf, 1024, s, va);
 	va_end(va);
@@ -75,3 +91,18 @@ void notice(const char *s, ...) {
 
 	fprintf(stdout, "%s\n", buf);
 }
+
+namespace Common {
+
+uint32 getMillis() {
+#ifdef WIN32
+	// clock() measures wall time in the Windows C runtime
+	return (uint32)(clock() * 1000.0 / CLOCKS_PER_SEC);
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint32)(tv.tv_sec * 1000 + tv.tv_usec / 1000);
+#endif
+}
+
+} // End of namespace Common
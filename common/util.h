@@ -104,12 +104,20 @@ enum Platform {
 	kPlatformUnknown = -1
 };
 
+/**
+ * Returns the time in milliseconds since some unspecified point, which is
+ * only good for measuring how long something took.
+ */
+uint32 getMillis();
+
 } // End of Common namespace
 
 /* Misc stuff */
 void NORETURN_PRE error(const char *s, ...) NORETURN_POST;
 void warning(const char *s, ...);
 void debug(int level, const char *s, ...);
+/** Only shows debug messages up to the given level; all are shown by default */
+void setDebugLevel(int level);
 void notice(const char *s, ...);
 
 #endif
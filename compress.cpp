@@ -32,6 +32,8 @@
 
 #include "compress.h"
 #include "common/endian.h"
+#include "sound/audiostream.h"
+#include "sound/pcm.h"
 
 #ifdef USE_VORBIS
 #include <vorbis/vorbisenc.h>
@@ -40,6 +42,9 @@
 #define FLAC__NO_DLL 1
 #include <FLAC/stream_encoder.h>
 #endif
+#ifdef USE_LAME
+#include <lame/lame.h>
+#endif
 
 struct lameparams {
 	int32 minBitr;
@@ -67,15 +72,10 @@ struct flaccparams {
 	bool silent;
 };
 
-struct rawtype {
-	bool isLittleEndian, isStereo;
-	uint8 bitsPerSample;
-};
-
 lameparams lameparms = { -1, -1, 32, VBR, algqualDef, vbrqualDef, 0, "lame" };
 oggencparams oggparms = { -1, -1, -1, (float)oggqualDef, 0 };
 flaccparams flacparms = { flacCompressDef, flacBlocksizeDef, false, false };
-rawtype	rawAudioType = { false, false, 8 };
+RawAudioType rawAudioType = { false, false, 8 };
 
 const char *tempEncoded = TEMP_MP3;
 
@@ -120,6 +120,55 @@ static int map2MP3Frequency(int freq) {
 }
 
 void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamplerate, const char *outname, AudioFormat compmode) {
+	if (!hasInternalEncoder(compmode)) {
+		encodeExternal(inname, rawInput, rawSamplerate, rawAudioType, outname, compmode, true);
+		return;
+	}
+
+	if (rawInput) {
+		long length;
+		char *rawData;
+
+		Common::File inputRaw(inname, "rb");
+		length = inputRaw.size();
+		rawData = (char *)malloc(length);
+		inputRaw.read_throwsOnError(rawData, length);
+
+		encodeRaw(rawData, length, rawSamplerate, outname, compmode);
+
+		free(rawData);
+	} else {
+		int fmtHeaderSize, length, numChannels, sampleRate, bitsPerSample;
+		char *wavData;
+
+		Common::File inputWav(inname, "rb");
+
+		/* Standard PCM fmt header is 16 bits, but at least Simon 1 and 2 use 18 bits */
+		inputWav.seek(16, SEEK_SET);
+		fmtHeaderSize = inputWav.readUint32LE();
+
+		inputWav.seek(22, SEEK_SET);
+		numChannels = inputWav.readUint16LE();
+		sampleRate = inputWav.readUint32LE();
+
+		inputWav.seek(34, SEEK_SET);
+		bitsPerSample = inputWav.readUint16LE();
+
+		/* The size of the raw audio is after the RIFF chunk (12 bytes), fmt chunk (8 + fmtHeaderSize bytes), and data chunk id (4 bytes) */
+		inputWav.seek(24 + fmtHeaderSize, SEEK_SET);
+		length = inputWav.readUint32LE();
+
+		wavData = (char *)malloc(length);
+		inputWav.read_throwsOnError(wavData, length);
+
+		setRawAudioType(true, numChannels == 2, (uint8)bitsPerSample);
+		encodeRaw(wavData, length, sampleRate, outname, compmode);
+
+		free(wavData);
+	}
+}
+
+void CompressionTool::encodeExternal(const char *inname, bool rawInput, int rawSamplerate, const RawAudioType &type, const char *outname, AudioFormat compmode, bool verbose) {
 	bool err = false;
 	char fbuf[2048];
 	char *tmp = fbuf;
@@ -128,15 +177,15 @@ void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamp
 		tmp += sprintf(tmp, "%s -t ", lameparms.lamePath.c_str());
 		if (rawInput) {
 			tmp += sprintf(tmp, "-r ");
-			tmp += sprintf(tmp, "--bitwidth %d ", rawAudioType.bitsPerSample);
+			tmp += sprintf(tmp, "--bitwidth %d ", type.bitsPerSample);
 
-			if (rawAudioType.isLittleEndian) {
+			if (type.isLittleEndian) {
 				tmp += sprintf(tmp, "--little-endian ");
 			} else {
 				tmp += sprintf(tmp, "--big-endian ");
 			}
 
-			tmp += sprintf(tmp, (rawAudioType.isStereo ? "-m j " : "-m m "));
+			tmp += sprintf(tmp, (type.isStereo ? "-m j " : "-m m "));
 			tmp += sprintf(tmp, "-s %d ", rawSamplerate);
 		}
 
@@ -165,7 +214,7 @@ void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamp
 			tmp += sprintf(tmp, "--resample %d ", map2MP3Frequency(97 * rawSamplerate / 100));
 		}
 
-		if (lameparms.silent) {
+		if (lameparms.silent || !verbose) {
 			tmp += sprintf(tmp, " --silent ");
 		}
 
@@ -184,15 +233,14 @@ void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamp
 		}
 	}
 
-#ifndef USE_VORBIS
 	if (compmode == AUDIO_VORBIS) {
 		tmp += sprintf(tmp, "oggenc ");
 		if (rawInput) {
 			tmp += sprintf(tmp, "--raw ");
-			tmp += sprintf(tmp, "--raw-chan=%d ", (rawAudioType.isStereo ? 2 : 1));
-			tmp += sprintf(tmp, "--raw-bits=%d ", rawAudioType.bitsPerSample);
+			tmp += sprintf(tmp, "--raw-chan=%d ", (type.isStereo ? 2 : 1));
+			tmp += sprintf(tmp, "--raw-bits=%d ", type.bitsPerSample);
 			tmp += sprintf(tmp, "--raw-rate=%d ", rawSamplerate);
-			tmp += sprintf(tmp, "--raw-endianness=%d ", (rawAudioType.isLittleEndian ? 0 : 1));
+			tmp += sprintf(tmp, "--raw-endianness=%d ", (type.isLittleEndian ? 0 : 1));
 		}
 
 		if (oggparms.nominalBitr != -1) {
@@ -209,7 +257,7 @@ void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamp
 			tmp += sprintf(tmp, "--max-bitrate=%d ", oggparms.maxBitr);
 		}
 
-		if (oggparms.silent) {
+		if (oggparms.silent || !verbose) {
 			tmp += sprintf(tmp, "--quiet ");
 		}
 
@@ -226,9 +274,7 @@ void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamp
 			return;
 		}
 	}
-#endif
 
-#ifndef USE_FLAC
 	if (compmode == AUDIO_FLAC) {
 		/* --lax is needed to allow 11kHz, we dont need place for meta-tags, and no seektable */
 		/* -f is reqired to force override of unremoved temp file. See bug #1294648 */
@@ -236,14 +282,14 @@ void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamp
 
 		if (rawInput) {
 			tmp += sprintf(tmp, "--force-raw-format ");
-			tmp += sprintf(tmp, "--sign=%s ", ((rawAudioType.bitsPerSample == 8) ? "unsigned" : "signed"));
-			tmp += sprintf(tmp, "--channels=%d ", (rawAudioType.isStereo ? 2 : 1));
-			tmp += sprintf(tmp, "--bps=%d ", rawAudioType.bitsPerSample);
+			tmp += sprintf(tmp, "--sign=%s ", ((type.bitsPerSample == 8) ? "unsigned" : "signed"));
+			tmp += sprintf(tmp, "--channels=%d ", (type.isStereo ? 2 : 1));
+			tmp += sprintf(tmp, "--bps=%d ", type.bitsPerSample);
 			tmp += sprintf(tmp, "--sample-rate=%d ", rawSamplerate);
-			tmp += sprintf(tmp, "--endian=%s ", (rawAudioType.isLittleEndian ? "little" : "big"));
+			tmp += sprintf(tmp, "--endian=%s ", (type.isLittleEndian ? "little" : "big"));
 		}
 
-		if (flacparms.silent) {
+		if (flacparms.silent || !verbose) {
 			tmp += sprintf(tmp, "--silent ");
 		}
 
@@ -266,323 +312,533 @@ void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamp
 			return;
 		}
 	}
+}
+
+void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate, const char *outname, AudioFormat compmode) {
+	Common::MemoryWriteStreamDynamic encoded;
+	encodeRawData(rawData, length, samplerate, rawAudioType, compmode, encoded, "tempfile", true);
+
+	Common::File outputFile(outname, "wb");
+	outputFile.write(encoded.getData(), encoded.size());
+}
+
+void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate, Common::MemoryWriteStreamDynamic &output, AudioFormat compmode) {
+	encodeRawData(rawData, length, samplerate, rawAudioType, compmode, output, "tempfile", true);
+}
+
+void CompressionTool::encodeRawData(const char *rawData, int length, int samplerate, const RawAudioType &type, AudioFormat compmode, Common::MemoryWriteStreamDynamic &output, const char *tempName, bool verbose) {
+	std::string rawName = std::string(tempName) + ".raw";
+	std::string encodedName = std::string(tempName) + audio_extensions(compmode);
+
+	if (!hasInternalEncoder(compmode)) {
+		/* There is no encoder library for this format, so go through the external encoder */
+		Common::File tmpFile(rawName.c_str(), "wb");
+		tmpFile.write(rawData, length);
+		tmpFile.close();
+
+		try {
+			encodeExternal(rawName.c_str(), true, samplerate, type, encodedName.c_str(), compmode, verbose);
+
+			Common::File encodedFile(encodedName.c_str(), "rb");
+			uint32 size = encodedFile.size();
+			byte *buf = (byte *)malloc(size);
+			try {
+				encodedFile.read_throwsOnError(buf, size);
+			} catch (...) {
+				free(buf);
+				throw;
+			}
+			output.write(buf, size);
+			free(buf);
+		} catch (...) {
+			if (!_keepTempFiles) {
+				Common::removeFile(rawName.c_str());
+				Common::removeFile(encodedName.c_str());
+			}
+			throw;
+		}
+
+		if (!_keepTempFiles) {
+			Common::removeFile(rawName.c_str());
+			Common::removeFile(encodedName.c_str());
+		}
+		return;
+	}
+
+	if (verbose)
+		print(" - len=%ld, ch=%d, rate=%d, %dbits", length, (type.isStereo ? 2 : 1), samplerate, type.bitsPerSample);
+
+	uint32 startPos = output.pos();
+
+	switch (compmode) {
+#ifdef USE_LAME
+	case AUDIO_MP3:
+		encodeRawMP3(rawData, length, samplerate, type, output, verbose);
+		break;
 #endif
-	if (rawInput) {
-		long length;
-		char *rawData;
+#ifdef USE_VORBIS
+	case AUDIO_VORBIS:
+		encodeRawVorbis(rawData, length, samplerate, type, output, verbose);
+		break;
+#endif
+#ifdef USE_FLAC
+	case AUDIO_FLAC:
+		encodeRawFlac(rawData, length, samplerate, type, output, verbose);
+		break;
+#endif
+	default:
+		break;
+	}
 
-		Common::File inputRaw(inname, "rb");
-		length = inputRaw.size();
-		rawData = (char *)malloc(length);
-		inputRaw.read_throwsOnError(rawData, length);
+	/* The data never needs to touch the disk, but it can be dumped for debugging */
+	if (_keepTempFiles) {
+		Common::File rawFile(rawName.c_str(), "wb");
+		rawFile.write(rawData, length);
+		Common::File encodedFile(encodedName.c_str(), "wb");
+		encodedFile.write(output.getData() + startPos, output.size() - startPos);
+	}
+}
 
-		encodeRaw(rawData, length, rawSamplerate, outname, compmode);
+/* The raw data as Mixer flags for the PCM conversion; 8-bit samples are always unsigned */
+static inline byte rawAudioFlags(const RawAudioType &type) {
+	if (type.bitsPerSample == 8)
+		return Audio::Mixer::FLAG_UNSIGNED;
+	return Audio::Mixer::FLAG_16BITS | (type.isLittleEndian ? Audio::Mixer::FLAG_LITTLE_ENDIAN : 0);
+}
 
-		free(rawData);
+#ifdef USE_LAME
+void CompressionTool::encodeRawMP3(const char *rawData, int length, int samplerate, const RawAudioType &type, Common::MemoryWriteStreamDynamic &output, bool verbose) {
+	int numChannels = (type.isStereo ? 2 : 1);
+	int bytesPerSample = type.bitsPerSample / 8;
+	int totalSamples = length / (bytesPerSample * numChannels);
+	int samplesLeft = totalSamples;
+	int totalBytes = 0;
+
+	/* LAME wants native 16-bit samples, so the input is converted in chunks */
+	int16 pcmBuffer[2 * 2048];
+	/* Worst case output size for a chunk, as documented in lame.h */
+	unsigned char mp3Buffer[5 * 2048 / 4 + 7200];
+
+	lame_global_flags *lame = lame_init();
+	if (!lame)
+		error("Could not initialize the MP3 encoder");
+
+	lame_set_num_channels(lame, numChannels);
+	lame_set_in_samplerate(lame, samplerate);
+	/* Same resampling workaround as for the lame executable, see encodeExternal() */
+	lame_set_out_samplerate(lame, map2MP3Frequency(97 * samplerate / 100));
+	lame_set_mode(lame, (type.isStereo ? JOINT_STEREO : MONO));
+	lame_set_quality(lame, lameparms.algqual);
+
+	if (lameparms.type == CBR) {
+		lame_set_VBR(lame, vbr_off);
+		lame_set_brate(lame, lameparms.targetBitr);
 	} else {
-		int fmtHeaderSize, length, numChannels, sampleRate, bitsPerSample;
-		char *wavData;
+		if (lameparms.type == ABR) {
+			lame_set_VBR(lame, vbr_abr);
+			lame_set_VBR_mean_bitrate_kbps(lame, lameparms.targetBitr);
+		} else {
+			/* Equivalent of --vbr-new */
+			lame_set_VBR(lame, vbr_mtrh);
+			lame_set_VBR_q(lame, lameparms.vbrqual);
+		}
 
-		Common::File inputWav(inname, "rb");
+		if (lameparms.minBitr != -1)
+			lame_set_VBR_min_bitrate_kbps(lame, lameparms.minBitr);
+		if (lameparms.maxBitr != -1)
+			lame_set_VBR_max_bitrate_kbps(lame, lameparms.maxBitr);
+	}
 
-		/* Standard PCM fmt header is 16 bits, but at least Simon 1 and 2 use 18 bits */
-		inputWav.seek(16, SEEK_SET);
-		fmtHeaderSize = inputWav.readUint32LE();
+	if (lame_init_params(lame) < 0) {
+		lame_close(lame);
+		error("Invalid MP3 encoder parameters");
+	}
 
-		inputWav.seek(22, SEEK_SET);
-		numChannels = inputWav.readUint16LE();
-		sampleRate = inputWav.readUint32LE();
+	if (verbose && !lameparms.silent) {
+		if (lameparms.type == VBR)
+			print("Encoding at VBR quality %d, algorithm quality %d\n", lameparms.vbrqual, lameparms.algqual);
+		else
+			print("Encoding at %s bitrate %d kbps, algorithm quality %d\n", (lameparms.type == CBR ? "constant" : "average"), lameparms.targetBitr, lameparms.algqual);
+	}
 
-		inputWav.seek(34, SEEK_SET);
-		bitsPerSample = inputWav.readUint16LE();
+	/* The Xing/LAME tag is written over the first frame at the end */
+	uint32 startPos = output.pos();
 
-		/* The size of the raw audio is after the RIFF chunk (12 bytes), fmt chunk (8 + fmtHeaderSize bytes), and data chunk id (4 bytes) */
-		inputWav.seek(24 + fmtHeaderSize, SEEK_SET);
-		length = inputWav.readUint32LE();
+	while (samplesLeft > 0) {
+		int numSamples = ((samplesLeft < 2048) ? samplesLeft : 2048);
+		int encoded;
 
-		wavData = (char *)malloc(length);
-		inputWav.read_throwsOnError(wavData, length);
+		Audio::convertPCMToInt16(pcmBuffer, (const byte *)rawData, numSamples * numChannels, rawAudioFlags(type));
 
-		setRawAudioType(true, numChannels == 2, (uint8)bitsPerSample);
-		encodeRaw(wavData, length, sampleRate, outname, compmode);
+		if (numChannels == 2)
+			encoded = lame_encode_buffer_interleaved(lame, pcmBuffer, numSamples, mp3Buffer, sizeof(mp3Buffer));
+		else
+			encoded = lame_encode_buffer(lame, pcmBuffer, pcmBuffer, numSamples, mp3Buffer, sizeof(mp3Buffer));
 
-		free(wavData);
+		if (encoded < 0) {
+			lame_close(lame);
+			error("Error in MP3 encoder (%d)", encoded);
+		}
+		totalBytes += output.write(mp3Buffer, encoded);
+
+		rawData += numSamples * bytesPerSample * numChannels;
+		samplesLeft -= numSamples;
 	}
-}
 
-void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate, const char *outname, AudioFormat compmode) {
+	int flushed = lame_encode_flush(lame, mp3Buffer, sizeof(mp3Buffer));
+	if (flushed > 0)
+		totalBytes += output.write(mp3Buffer, flushed);
 
-	print(" - len=%ld, ch=%d, rate=%d, %dbits", length, (rawAudioType.isStereo ? 2 : 1), samplerate, rawAudioType.bitsPerSample);
+	/* LAME reserves the first frame for the Xing/LAME tag, fill it in now */
+	size_t tagSize = lame_get_lametag_frame(lame, mp3Buffer, sizeof(mp3Buffer));
+	if (tagSize > 0 && tagSize <= sizeof(mp3Buffer)) {
+		output.seek(startPos, SEEK_SET);
+		output.write(mp3Buffer, tagSize);
+		output.seek(0, SEEK_END);
+	}
+
+	lame_close(lame);
+
+	if (verbose && !lameparms.silent) {
+		print("\nDone encoding");
+		print("\n\tFile length:  %dm %ds", (int)(totalSamples / samplerate / 60), (totalSamples / samplerate % 60));
+		print("\tAverage bitrate: %.1f kb/s\n", (8.0 * (double)totalBytes / 1000.0) / ((double)totalSamples / (double)samplerate));
+	}
+}
+#endif
 
 #ifdef USE_VORBIS
-	if (compmode == AUDIO_VORBIS) {
-		char outputString[256] = "";
-		int numChannels = (rawAudioType.isStereo ? 2 : 1);
-		int totalSamples = length / ((rawAudioType.bitsPerSample / 8) * numChannels);
-		int samplesLeft = totalSamples;
-		int eos = 0;
-		int totalBytes = 0;
-
-		vorbis_info vi;
-		vorbis_comment vc;
-		vorbis_dsp_state vd;
-		vorbis_block vb;
-
-		ogg_stream_state os;
-		ogg_page og;
-		ogg_packet op;
-
-		ogg_packet header;
-		ogg_packet header_comm;
-		ogg_packet header_code;
-
-		Common::File outputOgg(outname, "wb");
-
-		vorbis_info_init(&vi);
-
-		if (oggparms.nominalBitr > 0) {
-			int result = 0;
-
-			/* Input is in kbps, function takes bps */
-			result = vorbis_encode_setup_managed(&vi, numChannels, samplerate, (oggparms.maxBitr > 0 ? 1000 * oggparms.maxBitr : -1), (1000 * oggparms.nominalBitr), (oggparms.minBitr > 0 ? 1000 * oggparms.minBitr : -1));
-
-			if (result == OV_EFAULT) {
-				vorbis_info_clear(&vi);
-				error("Error: Internal Logic Fault");
-			} else if ((result == OV_EINVAL) || (result == OV_EIMPL)) {
-				vorbis_info_clear(&vi);
-				error("Error: Invalid bitrate parameters");
+void CompressionTool::encodeRawVorbis(const char *rawData, int length, int samplerate, const RawAudioType &type, Common::MemoryWriteStreamDynamic &output, bool verbose) {
+	char outputString[256] = "";
+	int numChannels = (type.isStereo ? 2 : 1);
+	int totalSamples = length / ((type.bitsPerSample / 8) * numChannels);
+	int samplesLeft = totalSamples;
+	int eos = 0;
+	int totalBytes = 0;
+
+	vorbis_info vi;
+	vorbis_comment vc;
+	vorbis_dsp_state vd;
+	vorbis_block vb;
+
+	ogg_stream_state os;
+	ogg_page og;
+	ogg_packet op;
+
+	ogg_packet header;
+	ogg_packet header_comm;
+	ogg_packet header_code;
+
+	vorbis_info_init(&vi);
+
+	if (oggparms.nominalBitr > 0) {
+		int result = 0;
+
+		/* Input is in kbps, function takes bps */
+		result = vorbis_encode_setup_managed(&vi, numChannels, samplerate, (oggparms.maxBitr > 0 ? 1000 * oggparms.maxBitr : -1), (1000 * oggparms.nominalBitr), (oggparms.minBitr > 0 ? 1000 * oggparms.minBitr : -1));
+
+		if (result == OV_EFAULT) {
+			vorbis_info_clear(&vi);
+			error("Error: Internal Logic Fault");
+		} else if ((result == OV_EINVAL) || (result == OV_EIMPL)) {
+			vorbis_info_clear(&vi);
+			error("Error: Invalid bitrate parameters");
+		}
+
+		if (verbose && !oggparms.silent) {
+			sprintf(outputString, "Encoding at average bitrate %i kbps (", oggparms.nominalBitr);
+
+			if (oggparms.minBitr > 0) {
+				sprintf(outputString + strlen(outputString), "min %i kbps, ", oggparms.minBitr);
+			} else {
+				sprintf(outputString + strlen(outputString), "no min, ");
 			}
 
-			if (!oggparms.silent) {
-				sprintf(outputString, "Encoding to\n         \"%s\"\nat average bitrate %i kbps (", outname, oggparms.nominalBitr);
+			if (oggparms.maxBitr > 0) {
+				sprintf(outputString + strlen(outputString), "max %i kbps),\nusing full bitrate management engine\nSet optional hard quality restrictions\n", oggparms.maxBitr);
+			} else {
+				sprintf(outputString + strlen(outputString), "no max),\nusing full bitrate management engine\nSet optional hard quality restrictions\n");
+			}
+		}
+	} else {
+		int result = 0;
+
+		/* Quality input is -1 - 10, function takes -0.1 through 1.0 */
+		result = vorbis_encode_setup_vbr(&vi, numChannels, samplerate, oggparms.quality * 0.1f);
+
+		if (result == OV_EFAULT) {
+			vorbis_info_clear(&vi);
+			error("Internal Logic Fault");
+		} else if ((result == OV_EINVAL) || (result == OV_EIMPL)) {
+			vorbis_info_clear(&vi);
+			error("Invalid bitrate parameters");
+		}
+
+		if (verbose && !oggparms.silent) {
+			sprintf(outputString, "Encoding at quality %2.2f", oggparms.quality);
+		}
+
+		if ((oggparms.minBitr > 0) || (oggparms.maxBitr > 0)) {
+			struct ovectl_ratemanage_arg extraParam;
+			vorbis_encode_ctl(&vi, OV_ECTL_RATEMANAGE_GET, &extraParam);
 
-				if (oggparms.minBitr > 0) {
+			extraParam.bitrate_hard_min = (oggparms.minBitr > 0 ? (1000 * oggparms.minBitr) : -1);
+			extraParam.bitrate_hard_max = (oggparms.maxBitr > 0 ? (1000 * oggparms.maxBitr) : -1);
+			extraParam.management_active = 1;
+
+			vorbis_encode_ctl(&vi, OV_ECTL_RATEMANAGE_SET, &extraParam);
+
+			if (verbose && !oggparms.silent) {
+				sprintf(outputString + strlen(outputString), " using constrained VBR (");
+
+				if (oggparms.minBitr != -1) {
 					sprintf(outputString + strlen(outputString), "min %i kbps, ", oggparms.minBitr);
 				} else {
 					sprintf(outputString + strlen(outputString), "no min, ");
 				}
 
-				if (oggparms.maxBitr > 0) {
-					sprintf(outputString + strlen(outputString), "max %i kbps),\nusing full bitrate management engine\nSet optional hard quality restrictions\n", oggparms.maxBitr);
+				if (oggparms.maxBitr != -1) {
+					sprintf(outputString + strlen(outputString), "max %i kbps)\nSet optional hard quality restrictions\n", oggparms.maxBitr);
 				} else {
-					sprintf(outputString + strlen(outputString), "no max),\nusing full bitrate management engine\nSet optional hard quality restrictions\n");
+					sprintf(outputString + strlen(outputString), "no max)\nSet optional hard quality restrictions\n");
 				}
 			}
 		} else {
-			int result = 0;
+			sprintf(outputString + strlen(outputString), "\n");
+		}
+	}
 
-			/* Quality input is -1 - 10, function takes -0.1 through 1.0 */
-			result = vorbis_encode_setup_vbr(&vi, numChannels, samplerate, oggparms.quality * 0.1f);
+	if (verbose)
+		puts(outputString);
 
-			if (result == OV_EFAULT) {
-				vorbis_info_clear(&vi);
-				error("Internal Logic Fault");
-			} else if ((result == OV_EINVAL) || (result == OV_EIMPL)) {
-				vorbis_info_clear(&vi);
-				error("Invalid bitrate parameters");
-			}
+	vorbis_encode_setup_init(&vi);
+	vorbis_comment_init(&vc);
+	vorbis_analysis_init(&vd, &vi);
+	vorbis_block_init(&vd, &vb);
+	ogg_stream_init(&os, 0);
+	vorbis_analysis_headerout(&vd, &vc, &header, &header_comm, &header_code);
 
-			if (!oggparms.silent) {
-				sprintf(outputString, "Encoding to\n         \"%s\"\nat quality %2.2f", outname, oggparms.quality);
-			}
+	ogg_stream_packetin(&os, &header);
+	ogg_stream_packetin(&os, &header_comm);
+	ogg_stream_packetin(&os, &header_code);
+
+	while (!eos) {
+		int result = ogg_stream_flush(&os,&og);
 
-			if ((oggparms.minBitr > 0) || (oggparms.maxBitr > 0)) {
-				struct ovectl_ratemanage_arg extraParam;
-				vorbis_encode_ctl(&vi, OV_ECTL_RATEMANAGE_GET, &extraParam);
+		if (result == 0) {
+			break;
+		}
+
+		output.write(og.header, og.header_len);
+		output.write(og.body, og.body_len);
+	}
+
+	while (!eos) {
+		int numSamples = ((samplesLeft < 2048) ? samplesLeft : 2048);
+		float **buffer = vorbis_analysis_buffer(&vd, numSamples);
+
+		/* We must tell the encoder that we have reached the end of the stream */
+		if (numSamples == 0) {
+			vorbis_analysis_wrote(&vd, 0);
+		} else {
+			Audio::convertPCMToFloat(buffer, (const byte *)rawData, numSamples, numChannels, rawAudioFlags(type));
+
+			vorbis_analysis_wrote(&vd, numSamples);
+		}
 
-				extraParam.bitrate_hard_min = (oggparms.minBitr > 0 ? (1000 * oggparms.minBitr) : -1);
-				extraParam.bitrate_hard_max = (oggparms.maxBitr > 0 ? (1000 * oggparms.maxBitr) : -1);
-				extraParam.management_active = 1;
+		while (vorbis_analysis_blockout(&vd, &vb) == 1) {
+			vorbis_analysis(&vb, NULL);
+			vorbis_bitrate_addblock(&vb);
 
-				vorbis_encode_ctl(&vi, OV_ECTL_RATEMANAGE_SET, &extraParam);
+			while (vorbis_bitrate_flushpacket(&vd, &op)) {
+				ogg_stream_packetin(&os, &op);
 
-				if (!oggparms.silent) {
-					sprintf(outputString + strlen(outputString), " using constrained VBR (");
+				while (!eos) {
+					int result = ogg_stream_pageout(&os, &og);
 
-					if (oggparms.minBitr != -1) {
-						sprintf(outputString + strlen(outputString), "min %i kbps, ", oggparms.minBitr);
-					} else {
-						sprintf(outputString + strlen(outputString), "no min, ");
+					if (result == 0) {
+						break;
 					}
 
-					if (oggparms.maxBitr != -1) {
-						sprintf(outputString + strlen(outputString), "max %i kbps)\nSet optional hard quality restrictions\n", oggparms.maxBitr);
-					} else {
-						sprintf(outputString + strlen(outputString), "no max)\nSet optional hard quality restrictions\n");
+					totalBytes += output.write(og.header, og.header_len);
+					totalBytes += output.write(og.body, og.body_len);
+
+					if (ogg_page_eos(&og)) {
+						eos = 1;
 					}
 				}
-			} else {
-				sprintf(outputString + strlen(outputString), "\n");
 			}
 		}
 
-		puts(outputString);
+		rawData += numSamples * (type.bitsPerSample / 8) * numChannels;
+		samplesLeft -= numSamples;
+	}
 
-		vorbis_encode_setup_init(&vi);
-		vorbis_comment_init(&vc);
-		vorbis_analysis_init(&vd, &vi);
-		vorbis_block_init(&vd, &vb);
-		ogg_stream_init(&os, 0);
-		vorbis_analysis_headerout(&vd, &vc, &header, &header_comm, &header_code);
+	ogg_stream_clear(&os);
+	vorbis_block_clear(&vb);
+	vorbis_dsp_clear(&vd);
+	vorbis_info_clear(&vi);
 
-		ogg_stream_packetin(&os, &header);
-		ogg_stream_packetin(&os, &header_comm);
-		ogg_stream_packetin(&os, &header_code);
+	if (verbose && !oggparms.silent) {
+		print("\nDone encoding");
+		print("\n\tFile length:  %dm %ds", (int)(totalSamples / samplerate / 60), (totalSamples / samplerate % 60));
+		print("\tAverage bitrate: %.1f kb/s\n", (8.0 * (double)totalBytes / 1000.0) / ((double)totalSamples / (double)samplerate));
+	}
+}
+#endif
 
-		while (!eos) {
-			int result = ogg_stream_flush(&os,&og);
+#ifdef USE_FLAC
+/* Stream callbacks for the FLAC encoder, which writes to a memory stream.
+ * FLAC offsets are relative to the start of the encoded data, which need not
+ * be the start of the stream. */
+struct FlacOutput {
+	Common::MemoryWriteStreamDynamic *stream;
+	uint32 startPos;
+};
 
-			if (result == 0) {
-				break;
-			}
+static FLAC__StreamEncoderWriteStatus flacWrite(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned currentFrame, void *clientData) {
+	try {
+		((FlacOutput *)clientData)->stream->write(buffer, bytes);
+	} catch (...) {
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+	}
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
 
-			outputOgg.write(og.header, og.header_len);
-			outputOgg.write(og.body, og.body_len);
-		}
+static FLAC__StreamEncoderSeekStatus flacSeek(const FLAC__StreamEncoder *encoder, FLAC__uint64 absoluteByteOffset, void *clientData) {
+	FlacOutput *output = (FlacOutput *)clientData;
+	try {
+		output->stream->seek((long)(output->startPos + absoluteByteOffset), SEEK_SET);
+	} catch (...) {
+		return FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+	}
+	return FLAC__STREAM_ENCODER_SEEK_STATUS_OK;
+}
 
-		while (!eos) {
-			int numSamples = ((samplesLeft < 2048) ? samplesLeft : 2048);
-			float **buffer = vorbis_analysis_buffer(&vd, numSamples);
+static FLAC__StreamEncoderTellStatus flacTell(const FLAC__StreamEncoder *encoder, FLAC__uint64 *absoluteByteOffset, void *clientData) {
+	FlacOutput *output = (FlacOutput *)clientData;
+	*absoluteByteOffset = output->stream->pos() - output->startPos;
+	return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+}
 
-			/* We must tell the encoder that we have reached the end of the stream */
-			if (numSamples == 0) {
-				vorbis_analysis_wrote(&vd, 0);
-			} else {
-				/* Adapted from oggenc 1.1.1 */
-				if (rawAudioType.bitsPerSample == 8) {
-					const byte *rawDataUnsigned = (const byte *)rawData;
-					for (int i = 0; i < numSamples; i++) {
-						for (int j = 0; j < numChannels; j++) {
-							buffer[j][i] = ((int)(rawDataUnsigned[i * numChannels + j]) - 128) / 128.0f;
-						}
-					}
-				} else if (rawAudioType.bitsPerSample == 16) {
-					if (rawAudioType.isLittleEndian) {
-						for (int i = 0; i < numSamples; i++) {
-							for (int j = 0; j < numChannels; j++) {
-								buffer[j][i] = ((rawData[(i * 2 * numChannels) + (2 * j) + 1] << 8) | (rawData[(i * 2 * numChannels) + (2 * j)] & 0xff)) / 32768.0f;
-							}
-						}
-					} else {
-						for (int i = 0; i < numSamples; i++) {
-							for (int j = 0; j < numChannels; j++) {
-								buffer[j][i] = ((rawData[(i * 2 * numChannels) + (2 * j)] << 8) | (rawData[(i * 2 * numChannels) + (2 * j) + 1] & 0xff)) / 32768.0f;
-							}
-						}
-					}
-				}
+void CompressionTool::encodeRawFlac(const char *rawData, int length, int samplerate, const RawAudioType &type, Common::MemoryWriteStreamDynamic &output, bool verbose) {
+	int numChannels = (type.isStereo ? 2 : 1);
+	int samplesPerChannel = length / ((type.bitsPerSample / 8) * numChannels);
+	FLAC__StreamEncoder *encoder;
+	FLAC__StreamEncoderInitStatus initStatus;
+	FLAC__int32 *flacData;
+	FlacOutput flacOutput;
 
-				vorbis_analysis_wrote(&vd, numSamples);
-			}
+	flacData = (FLAC__int32 *)malloc(samplesPerChannel * numChannels * sizeof(FLAC__int32));
 
-			while (vorbis_analysis_blockout(&vd, &vb) == 1) {
-				vorbis_analysis(&vb, NULL);
-				vorbis_bitrate_addblock(&vb);
+	Audio::convertPCMToInt32((int32 *)flacData, (const byte *)rawData, samplesPerChannel * numChannels, rawAudioFlags(type));
 
-				while (vorbis_bitrate_flushpacket(&vd, &op)) {
-					ogg_stream_packetin(&os, &op);
+	if (verbose && !flacparms.silent) {
+		print("Encoding at compression level %d using blocksize %d\n", flacparms.compressionLevel, flacparms.blocksize);
+	}
 
-					while (!eos) {
-						int result = ogg_stream_pageout(&os, &og);
+	encoder = FLAC__stream_encoder_new();
 
-						if (result == 0) {
-							break;
-						}
+	FLAC__stream_encoder_set_bits_per_sample(encoder, type.bitsPerSample);
+	FLAC__stream_encoder_set_blocksize(encoder, flacparms.blocksize);
+	FLAC__stream_encoder_set_channels(encoder, numChannels);
+	FLAC__stream_encoder_set_compression_level(encoder, flacparms.compressionLevel);
+	FLAC__stream_encoder_set_sample_rate(encoder, samplerate);
+	FLAC__stream_encoder_set_streamable_subset(encoder, false);
+	FLAC__stream_encoder_set_total_samples_estimate(encoder, samplesPerChannel);
+	FLAC__stream_encoder_set_verify(encoder, flacparms.verify);
 
-						totalBytes += outputOgg.write(og.header, og.header_len);
-						totalBytes += outputOgg.write(og.body, og.body_len);
+	flacOutput.stream = &output;
+	flacOutput.startPos = output.pos();
+	initStatus = FLAC__stream_encoder_init_stream(encoder, flacWrite, flacSeek, flacTell, NULL, &flacOutput);
 
-						if (ogg_page_eos(&og)) {
-							eos = 1;
-						}
-					}
-				}
-			}
+	if (initStatus != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+		char buf[2048];
+		sprintf(buf, "Error in FLAC encoder. (check the parameters)\nExact error was:%s", FLAC__StreamEncoderInitStatusString[initStatus]);
+		free(flacData);
+		throw ToolException(buf);
+	} else {
+		FLAC__stream_encoder_process_interleaved(encoder, flacData, samplesPerChannel);
+	}
 
-			rawData += 2048 * (rawAudioType.bitsPerSample / 8) * numChannels;
-			samplesLeft -= 2048;
-		}
+	FLAC__stream_encoder_finish(encoder);
+	FLAC__stream_encoder_delete(encoder);
+	/* The stream info was filled in at the start, continue after the data */
+	output.seek(0, SEEK_END);
 
-		ogg_stream_clear(&os);
-		vorbis_block_clear(&vb);
-		vorbis_dsp_clear(&vd);
-		vorbis_info_clear(&vi);
+	free(flacData);
 
-		if (!oggparms.silent) {
-			print("\nDone encoding file \"%s\"", outname);
-			print("\n\tFile length:  %dm %ds", (int)(totalSamples / samplerate / 60), (totalSamples / samplerate % 60));
-			print("\tAverage bitrate: %.1f kb/s\n", (8.0 * (double)totalBytes / 1000.0) / ((double)totalSamples / (double)samplerate));
-		}
+	if (verbose && !flacparms.silent) {
+		print("\nDone encoding");
+		print("\n\tFile length:  %dm %ds\n", (int)(samplesPerChannel / samplerate / 60), (samplesPerChannel / samplerate % 60));
 	}
+}
 #endif
 
-#ifdef USE_FLAC
-	if (compmode == AUDIO_FLAC) {
-		int i;
-		int numChannels = (rawAudioType.isStereo ? 2 : 1);
-		int samplesPerChannel = length / ((rawAudioType.bitsPerSample / 8) * numChannels);
-		FLAC__StreamEncoder *encoder;
-		FLAC__StreamEncoderInitStatus initStatus;
-		FLAC__int32 *flacData;
-
-		flacData = (FLAC__int32 *)malloc(samplesPerChannel * numChannels * sizeof(FLAC__int32));
-
-		if (rawAudioType.bitsPerSample == 8) {
-			for (i = 0; i < samplesPerChannel * numChannels; i++) {
-				FLAC__uint8 *rawDataUnsigned;
-				rawDataUnsigned = (FLAC__uint8 *)rawData;
-				flacData[i] = (FLAC__int32)rawDataUnsigned[i] - 0x80;
-			}
-		} else if (rawAudioType.bitsPerSample == 16) {
-			/* The rawData pointer is an 8-bit char so we must create a new pointer to access 16-bit samples */
-			FLAC__int16 *rawData16;
-			rawData16 = (FLAC__int16 *)rawData;
-			for (i = 0; i < samplesPerChannel * numChannels; i++) {
-				flacData[i] = (FLAC__int32)rawData16[i];
-			}
-		}
+EncodeJob::EncodeJob() {
+	_tool = NULL;
+	_format = AUDIO_NONE;
+	_slot = 0;
+	_verbose = true;
+	_rawData = NULL;
+	_length = 0;
+	_samplerate = 0;
+	_encoded = NULL;
+	_encodedSize = 0;
+}
 
-		if (!flacparms.silent) {
-			print("Encoding to\n         \"%s\"\nat compression level %d using blocksize %d\n", outname, flacparms.compressionLevel, flacparms.blocksize);
-		}
+EncodeJob::~EncodeJob() {
+	free(_rawData);
+	free(_encoded);
+}
 
-		encoder = FLAC__stream_encoder_new();
+void EncodeJob::setRawData(char *rawData, int length, int samplerate) {
+	free(_rawData);
+	_rawData = rawData;
+	_length = length;
+	_samplerate = samplerate;
+}
 
-		FLAC__stream_encoder_set_bits_per_sample(encoder, rawAudioType.bitsPerSample);
-		FLAC__stream_encoder_set_blocksize(encoder, flacparms.blocksize);
-		FLAC__stream_encoder_set_channels(encoder, numChannels);
-		FLAC__stream_encoder_set_compression_level(encoder, flacparms.compressionLevel);
-		FLAC__stream_encoder_set_sample_rate(encoder, samplerate);
-		FLAC__stream_encoder_set_streamable_subset(encoder, false);
-		FLAC__stream_encoder_set_total_samples_estimate(encoder, samplesPerChannel);
-		FLAC__stream_encoder_set_verify(encoder, flacparms.verify);
+void EncodeJob::run() {
+	if (!_rawData)
+		return;
 
-		initStatus = FLAC__stream_encoder_init_file(encoder, outname, NULL, NULL);
+	char tempName[32];
+	sprintf(tempName, "tempfile%d", _slot);
 
-		if (initStatus != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
-			char buf[2048];
-			sprintf(buf, "Error in FLAC encoder. (check the parameters)\nExact error was:%s", FLAC__StreamEncoderInitStatusString[initStatus]);
-			free(flacData);
-			throw ToolException(buf);
-		} else {
-			FLAC__stream_encoder_process_interleaved(encoder, flacData, samplesPerChannel);
-		}
+	Common::MemoryWriteStreamDynamic encoded;
+	_tool->encodeRawData(_rawData, _length, _samplerate, _type, _format, encoded, tempName, _verbose);
+	free(_rawData);
+	_rawData = NULL;
 
-		FLAC__stream_encoder_finish(encoder);
-		FLAC__stream_encoder_delete(encoder);
+	_encodedSize = encoded.size();
+	_encoded = encoded.releaseData();
+}
 
-		free(flacData);
+void EncodeJob::complete() {
+	finish(_encoded, _encodedSize);
+}
 
-		if (!flacparms.silent) {
-			print("\nDone encoding file \"%s\"", outname);
-			print("\n\tFile length:  %dm %ds\n", (int)(samplesPerChannel / samplerate / 60), (samplesPerChannel / samplerate % 60));
-		}
-	}
-#endif
+void CompressionTool::queueEncode(EncodeJob *job) {
+	if (!_encodeQueue)
+		_encodeQueue = new Common::OrderedJobWindow(_numJobs);
+
+	job->_tool = this;
+	job->_format = _format;
+	job->_type = rawAudioType;
+	job->_slot = _encodeQueue->getNextSlot();
+	/* Messages from several clips at once would only be confusing */
+	job->_verbose = (_encodeQueue->getNumThreads() == 1);
+
+	_encodeQueue->push(job);
+}
+
+void CompressionTool::flushEncodeQueue() {
+	if (_encodeQueue)
+		_encodeQueue->completeAll();
 }
 
-void CompressionTool::extractAndEncodeWAV(const char *outName, Common::File &input, AudioFormat compMode) {
+void CompressionTool::extractAndEncodeWAV(const char *outName, Common::SeekableReadStream &input, AudioFormat compMode) {
 	unsigned int length;
 	char fbuf[2048];
 	size_t size;
@@ -595,7 +851,7 @@ void CompressionTool::extractAndEncodeWAV(const char *outName, Common::File &inp
 	/* Copy the WAV data to a temporary file */
 	Common::File f(outName, "wb");
 	while (length > 0) {
-		size = input.read_noThrow(fbuf, length > sizeof(fbuf) ? sizeof(fbuf) : length);
+		size = input.read(fbuf, length > sizeof(fbuf) ? sizeof(fbuf) : length);
 		if (size <= 0)
 			break;
 		length -= (int)size;
@@ -607,6 +863,43 @@ void CompressionTool::extractAndEncodeWAV(const char *outName, Common::File &inp
 	encodeAudio(outName, false, -1, tempEncoded, compMode);
 }
 
+char *CompressionTool::extractWAV(Common::SeekableReadStream &input, int &length, int &samplerate) {
+	uint32 fmtHeaderSize, riffLength;
+	int numChannels, bitsPerSample;
+	char *wavData;
+
+	input.seek(-4, SEEK_CUR);
+	riffLength = input.readUint32LE();
+	riffLength += 8;
+	input.seek(-8, SEEK_CUR);
+
+	wavData = (char *)malloc(riffLength);
+	riffLength = input.read(wavData, riffLength);
+
+	/* Same layout as expected by encodeAudio() */
+	fmtHeaderSize = (riffLength >= 20) ? READ_LE_UINT32(wavData + 16) : 0;
+	if (riffLength < 44 || 28 + fmtHeaderSize > riffLength) {
+		free(wavData);
+		error("Truncated WAV header");
+	}
+
+	numChannels = READ_LE_UINT16(wavData + 22);
+	samplerate = READ_LE_UINT32(wavData + 24);
+	bitsPerSample = READ_LE_UINT16(wavData + 34);
+	length = READ_LE_UINT32(wavData + 24 + fmtHeaderSize);
+
+	if ((uint32)length > riffLength - 28 - fmtHeaderSize) {
+		free(wavData);
+		error("Truncated WAV data");
+	}
+
+	/* Only keep the sample data */
+	memmove(wavData, wavData + 28 + fmtHeaderSize, length);
+
+	setRawAudioType(true, numChannels == 2, (uint8)bitsPerSample);
+	return wavData;
+}
+
 void CompressionTool::extractAndEncodeAIFF(const char *inName, const char *outName, AudioFormat compmode) {
 	// Get sound definition (length, frequency, stereo, ...)
 	char buf[4];
@@ -697,18 +990,31 @@ void CompressionTool::extractAndEncodeAIFF(const char *inName, const char *outNa
 	Common::removeFile(TEMP_RAW);
 }
 
-void CompressionTool::extractAndEncodeVOC(const char *outName, Common::File &input, AudioFormat compMode) {
+void CompressionTool::extractAndEncodeVOC(const char *outName, Common::SeekableReadStream &input, AudioFormat compMode) {
+	int length, samplerate;
+	char *vocData = extractVOC(input, length, samplerate);
+
+	/* Copy the raw data to a temporary file */
+	Common::File f(outName, "wb");
+	f.write(vocData, length);
+	f.close();
+	free(vocData);
+
+	/* Convert the raw temp file to OGG/MP3 */
+	encodeAudio(outName, true, samplerate, tempEncoded, compMode);
+}
+
+char *CompressionTool::extractVOC(Common::SeekableReadStream &input, int &length, int &samplerate) {
 	int bits;
 	int blocktype;
 	int channels;
-	unsigned int length;
+	unsigned int blockLength;
 	int sample_rate;
 	int comp;
-	char fbuf[2048];
-	size_t size;
+	char *vocData = NULL;
 	int real_samplerate = -1;
 
-	Common::File f(outName, "wb");
+	length = 0;
 
 	while ((blocktype = input.readByte())) {
 		if (blocktype != 1 && blocktype != 9) {
@@ -725,28 +1031,29 @@ void CompressionTool::extractAndEncodeVOC(const char *outName, Common::File &inp
 
 		/* Sound Data */
 		print(" Sound Data");
-		length = input.readChar();
-		length |= input.readChar() << 8;
-		length |= input.readChar() << 16;
+		blockLength = input.readByte();
+		blockLength |= input.readByte() << 8;
+		blockLength |= input.readByte() << 16;
 
 		if (blocktype == 1) {
-			length -= 2;
+			blockLength -= 2;
 			sample_rate = input.readByte();
 			comp = input.readByte();
 			real_samplerate = getSampleRateFromVOCRate(sample_rate);
 		} else { /* (blocktype == 9) */
-			length -= 12;
+			blockLength -= 12;
 			real_samplerate = sample_rate = input.readUint32LE();
-			bits = input.readChar();;
-			channels = input.readChar();;
+			bits = input.readByte();;
+			channels = input.readByte();;
 			if (bits != 8 || channels != 1) {
+				free(vocData);
 				error("Unsupported VOC file format (%d bits per sample, %d channels)", bits, channels);
 			}
 			comp = input.readUint16LE();
 			input.readUint32LE();
 		}
 
-		print(" - length = %d", length);
+		print(" - length = %d", blockLength);
 		print(" - sample rate = %d (%02x)", real_samplerate, sample_rate);
 		print(" - compression = %s (%02x)",
 			   (comp ==	   0 ? "8bits"   :
@@ -756,30 +1063,21 @@ void CompressionTool::extractAndEncodeVOC(const char *outName, Common::File &inp
 								"Multi")))), comp);
 
 		if (comp != 0) {
+			free(vocData);
 			error("Cannot handle compressed VOC data");
 		}
 
-		/* Copy the raw data to a temporary file */
-		while (length > 0) {
-			size = input.read_noThrow(fbuf, length > sizeof(fbuf) ? sizeof(fbuf) : (uint32)length);
-
-			if (size <= 0) {
-				break;
-			}
-
-			length -= (int)size;
-			f.write(fbuf, size);
-		}
+		/* Append the raw data of this block */
+		vocData = (char *)realloc(vocData, length + blockLength);
+		length += input.read(vocData + length, blockLength);
 	}
 
-	f.close();
-
 	assert(real_samplerate != -1);
 
 	setRawAudioType(false, false, 8);
 
-	/* Convert the raw temp file to OGG/MP3 */
-	encodeAudio(outName, true, real_samplerate, tempEncoded, compMode);
+	samplerate = real_samplerate;
+	return vocData;
 }
 
 // mp3 settings
@@ -935,6 +1233,18 @@ void CompressionTool::unsetOggMaxBitrate() {
 	oggparms.maxBitr = -1;
 }
 
+void CompressionTool::setNumJobs(const std::string& arg) {
+	_numJobs = atoi(arg.c_str());
+
+	if (_numJobs < 1)
+		throw ToolException("Number of jobs (--jobs) must be a number greater than 0.");
+
+	if (_numJobs > 1 && !Common::hasThreadSupport()) {
+		warning("Built without thread support, running one job at a time");
+		_numJobs = 1;
+	}
+}
+
 bool CompressionTool::processMp3Parms() {
 	while (!_arguments.empty()) {
 		std::string arg = _arguments.front();
@@ -1088,6 +1398,14 @@ bool CompressionTool::processFlacParms(){
 CompressionTool::CompressionTool(const std::string &name, ToolType type) : Tool(name, type) {
 	_supportedFormats = AUDIO_ALL;
 	_format = AUDIO_MP3;
+	_numJobs = 1;
+	_supportsParallelEncoding = false;
+	_keepTempFiles = false;
+	_encodeQueue = NULL;
+}
+
+CompressionTool::~CompressionTool() {
+	delete _encodeQueue;
 }
 
 void CompressionTool::parseAudioArguments() {
@@ -1102,9 +1420,11 @@ void CompressionTool::parseAudioArguments() {
 		_format = AUDIO_VORBIS;
 	else if (_arguments.front() == "--flac")
 		_format = AUDIO_FLAC;
-	else
+	else {
 		// No audio arguments then
+		parseEncodeArguments();
 		return;
+	}
 
 	_arguments.pop_front();
 
@@ -1125,6 +1445,26 @@ void CompressionTool::parseAudioArguments() {
 	default: // cannot occur but we check anyway to avoid compiler warnings
 		throw ToolException("Unknown audio format, should be impossible!");
 	}
+
+	parseEncodeArguments();
+}
+
+void CompressionTool::parseEncodeArguments() {
+	while (!_arguments.empty()) {
+		if (_arguments.front() == "--temp-files") {
+			_keepTempFiles = true;
+			_arguments.pop_front();
+		} else if (_supportsParallelEncoding && _arguments.front() == "--jobs") {
+			_arguments.pop_front();
+			if (_arguments.empty())
+				throw ToolException("Could not parse command line options, expected value after --jobs");
+
+			setNumJobs(_arguments.front());
+			_arguments.pop_front();
+		} else {
+			break;
+		}
+	}
 }
 
 void CompressionTool::setTempFileName() {
@@ -1162,9 +1502,15 @@ std::string CompressionTool::getHelp() const {
 		os << " --flac       encode to Flac format\n";
 	os << "(If one of these is specified, it must be the first parameter.)\n";
 
+	if (_supportsParallelEncoding)
+		os << " --jobs <n>   encode <n> files at the same time (default:1)\n";
+	os << " --temp-files keep the raw and encoded audio of the latest files in tempfile*\n";
+	os << "              for debugging (audio is otherwise encoded in memory)\n";
+	os << "(If specified, these must follow the mode params.)\n";
+
 	if (_supportedFormats & AUDIO_MP3) {
 		os << "\nMP3 mode params:\n";
-		os << " --lame-path <path> Path to the lame excutable to use (default:lame)\n";
+		os << " --lame-path <path> Path to the lame excutable to use (default:lame, unused when built with libmp3lame)\n";
 		os << " -b <rate>    <rate> is the minimal bitrate (default:unset)\n";
 		os << " -B <rate>    <rate> is the maximum bitrate (default:unset)\n";
 		os << " --vbr        LAME uses the VBR mode (default)\n";
@@ -1216,6 +1562,32 @@ const char *audio_extensions(AudioFormat format) {
 	}
 }
 
+bool hasInternalEncoder(AudioFormat format) {
+	switch(format) {
+	case AUDIO_MP3:
+#ifdef USE_LAME
+		return true;
+#else
+		return false;
+#endif
+	case AUDIO_VORBIS:
+#ifdef USE_VORBIS
+		return true;
+#else
+		return false;
+#endif
+	case AUDIO_FLAC:
+#ifdef USE_FLAC
+		return true;
+#else
+		return false;
+#endif
+	case AUDIO_NONE:
+	default:
+		return false;
+	}
+}
+
 int compression_format(AudioFormat format) {
 	switch(format) {
 	case AUDIO_MP3:
@@ -24,6 +24,8 @@
 #define COMPRESS_H
 
 #include "tool.h"
+#include "common/memstream.h"
+#include "common/thread.h"
 
 
 enum {
@@ -66,9 +68,75 @@ enum CompressionType {
 	VBR
 };
 
+/**
+ * Layout of raw (headerless) PCM audio data.
+ */
+struct RawAudioType {
+	bool isLittleEndian, isStereo;
+	uint8 bitsPerSample;
+};
+
 const char *audio_extensions(AudioFormat format);
 int compression_format(AudioFormat format);
 
+/**
+ * Returns true if the given format is encoded by a library linked into the
+ * tools, and false if an external encoder (lame, oggenc or flac) is spawned.
+ */
+bool hasInternalEncoder(AudioFormat format);
+
+class CompressionTool;
+
+/**
+ * A clip queued for encoding with CompressionTool::queueEncode().
+ *
+ * The encoding itself may happen on another thread. Subclasses carry
+ * whatever is needed to store the result, and do so in finish(), which is
+ * always called on the main thread, in the order the jobs were queued.
+ */
+class EncodeJob : public Common::Job {
+public:
+	EncodeJob();
+	virtual ~EncodeJob();
+
+	/**
+	 * Sets the PCM data to encode, laid out as set by setRawAudioType()
+	 * at the time the job is queued. The job takes ownership of the data,
+	 * which must have been allocated with malloc().
+	 *
+	 * Jobs without data are not encoded, but are still finished in order,
+	 * which is handy for index entries between two clips.
+	 */
+	void setRawData(char *rawData, int length, int samplerate);
+
+	/**
+	 * Stores the encoded clip.
+	 *
+	 * @param encoded the encoded data, or NULL if the job had no data
+	 * @param size size of the encoded data
+	 */
+	virtual void finish(const byte *encoded, uint32 size) = 0;
+
+	virtual void run();
+	virtual void complete();
+
+private:
+	friend class CompressionTool;
+
+	CompressionTool *_tool;
+	AudioFormat _format;
+	RawAudioType _type;
+	int _slot;
+	bool _verbose;
+
+	char *_rawData;
+	int _length;
+	int _samplerate;
+
+	byte *_encoded;
+	uint32 _encodedSize;
+};
+
 
 /**
  * A tool, which can compress to either MP3, Vorbis or FLAC formats.
@@ -76,6 +144,7 @@ int compression_format(AudioFormat format);
 class CompressionTool : public Tool {
 public:
 	CompressionTool(const std::string &name, ToolType type);
+	~CompressionTool();
 
 	virtual std::string getHelp() const;
 
@@ -90,6 +159,9 @@ public:
 
 	AudioFormat _format;
 
+	/** Number of clips encoded at the same time, see queueEncode(). */
+	int _numJobs;
+
 	// Settings
 	// These functions are used by the GUI Tools and by CLI argument parsing functions
 	// mp3 settings
@@ -116,6 +188,9 @@ public:
 	void unsetOggMinBitrate();
 	void unsetOggMaxBitrate();
 
+	// misc
+	void setNumJobs(const std::string&);
+
 
 public:
 	bool processMp3Parms();
@@ -124,17 +199,73 @@ public:
 
 	void setTempFileName();
 
-	void extractAndEncodeVOC(const char *outName, Common::File &input, AudioFormat compMode);
-	void extractAndEncodeWAV(const char *outName, Common::File &input, AudioFormat compMode);
+	void extractAndEncodeVOC(const char *outName, Common::SeekableReadStream &input, AudioFormat compMode);
+	void extractAndEncodeWAV(const char *outName, Common::SeekableReadStream &input, AudioFormat compMode);
 
 	void extractAndEncodeAIFF(const char *inName, const char *outName, AudioFormat compMode);
 
+	/**
+	 * Reads the sound data of a VOC or WAV file at the current position of
+	 * the input into memory, and sets the raw audio type to match it.
+	 * The returned buffer must be freed with free().
+	 */
+	char *extractVOC(Common::SeekableReadStream &input, int &length, int &samplerate);
+	char *extractWAV(Common::SeekableReadStream &input, int &length, int &samplerate);
+
 	void encodeAudio(const char *inname, bool rawInput, int rawSamplerate, const char *outname, AudioFormat compmode);
 	void setRawAudioType(bool isLittleEndian, bool isStereo, uint8 bitsPerSample);
 
 protected:
 
+	/**
+	 * Encodes a buffer of raw PCM data, laid out as set by setRawAudioType().
+	 * The data is handed directly to the encoder library if there is one for
+	 * the format; otherwise it goes through temporary files to the external
+	 * encoder.
+	 */
 	void encodeRaw(const char *rawData, int length, int samplerate, const char *outname, AudioFormat compmode);
+
+	/**
+	 * Same as above, but appends the encoded data to the given stream, so
+	 * that it can be stored in an archive without a temporary file.
+	 */
+	void encodeRaw(const char *rawData, int length, int samplerate, Common::MemoryWriteStreamDynamic &output, AudioFormat compmode);
+
+	/**
+	 * Same as above, but with an explicit raw audio type instead of the one
+	 * set by setRawAudioType(). Safe to call from several jobs at once, as
+	 * long as each of them uses its own tempName for the external encoders.
+	 */
+	void encodeRawData(const char *rawData, int length, int samplerate, const RawAudioType &type, AudioFormat compmode, Common::MemoryWriteStreamDynamic &output, const char *tempName, bool verbose);
+
+	/**
+	 * Queues a clip for encoding to _format. With --jobs, up to _numJobs
+	 * clips are encoded at the same time; otherwise the job is encoded and
+	 * finished right away. The tool takes ownership of the job.
+	 */
+	void queueEncode(EncodeJob *job);
+
+	/** Waits for all queued clips, and finishes them in order. */
+	void flushEncodeQueue();
+
+	/** If set, the tool takes the --jobs option, and encodes through queueEncode() or a job queue of its own. */
+	bool _supportsParallelEncoding;
+
+	/** If set (--temp-files), the audio passing through the encoders is also written to tempfile.* */
+	bool _keepTempFiles;
+
+private:
+	friend class EncodeJob;
+
+	void parseEncodeArguments();
+
+	void encodeExternal(const char *inname, bool rawInput, int rawSamplerate, const RawAudioType &type, const char *outname, AudioFormat compmode, bool verbose);
+
+	void encodeRawMP3(const char *rawData, int length, int samplerate, const RawAudioType &type, Common::MemoryWriteStreamDynamic &output, bool verbose);
+	void encodeRawVorbis(const char *rawData, int length, int samplerate, const RawAudioType &type, Common::MemoryWriteStreamDynamic &output, bool verbose);
+	void encodeRawFlac(const char *rawData, int length, int samplerate, const RawAudioType &type, Common::MemoryWriteStreamDynamic &output, bool verbose);
+
+	Common::OrderedJobWindow *_encodeQueue;
 };
 
 /*
@@ -319,7 +319,7 @@ void Kyra::Kyra2Disassembler::doDisassemble() throw(std::exception) {
 		}
 		if (temp._size % 2 != 0) // Skip padding byte
 			_f.readByte();
-	} while (_f.pos() != (int)_f.size());
+	} while (_f.pos() != _f.size());
 
 	if (_ordrChunk._data == NULL)
 		throw std::runtime_error("Missing ORDR chunk");
@@ -64,7 +64,7 @@ public:
 
 #define START_OPCODES \
 	_address = _addressBase; \
-	while (_f.pos() != (int)_f.size()) { \
+	while (_f.pos() != _f.size()) { \
 		uint32 full_opcode = 0; \
 		uint8 opcode = _f.readByte(); \
 		std::string opcodePrefix; \
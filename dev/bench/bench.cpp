@@ -0,0 +1,81 @@
+/* Scumm Tools
+ * Copyright (C) 2004-2006  The ScummVM Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+/*
+ * scummvm-tools-bench times the decoders and file access of the tools, for
+ * development. It is built by 'make bench', and is not installed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dev/bench/bench.h"
+#include "common/util.h"
+#include "tool_exception.h"
+
+BenchTimer::BenchTimer(uint32 minMillis) : _minMillis(minMillis), _start(Common::getMillis()), _runs(0), _elapsed(1) {
+}
+
+bool BenchTimer::next() {
+	_runs++;
+	_elapsed = MAX<uint32>(Common::getMillis() - _start, 1);
+	return _elapsed < _minMillis;
+}
+
+static const struct {
+	const char *name;
+	const char *args;
+	const char *help;
+	int minArgs;
+	void (*run)(int argc, char *argv[]);
+} benchmarks[] = {
+	{ "adpcm", "<file>", "Decodes a file as each ADPCM format, from the file and from memory", 1, benchADPCM },
+	{ "bun", "<file.bun>", "Decodes all blocks of a bundle, one codec at a time", 1, benchBundleCodecs },
+	{ "file", "<file>", "Reads a file as 32-bit words, byte by byte and through the read buffer", 1, benchFileReads },
+	{ "mohawk-open", "<archive>...", "Opens Mohawk archives over and over, and shows how long each open takes", 1, benchMohawkOpen },
+	{ "pcm", "", "Converts generated PCM samples for the encoders, one by one and with the shared routines", 0, benchPCM },
+	{ "tinsel", "<file.smp> <file.idx>", "Decodes all 6-bit ADPCM samples with the old and the new decoder", 2, benchTinselADPCM }
+};
+
+static void printHelp(const char *exeName) {
+	printf("Usage: %s <benchmark> <arguments>\n\nBenchmarks:\n", exeName);
+	for (int i = 0; i < ARRAYSIZE(benchmarks); i++)
+		printf("  %s %s\n\t%s\n", benchmarks[i].name, benchmarks[i].args, benchmarks[i].help);
+}
+
+int main(int argc, char *argv[]) {
+	for (int i = 0; argc > 1 && i < ARRAYSIZE(benchmarks); i++) {
+		if (strcmp(argv[1], benchmarks[i].name) != 0 || argc - 2 < benchmarks[i].minArgs)
+			continue;
+
+		try {
+			benchmarks[i].run(argc - 2, argv + 2);
+		} catch (ToolException &err) {
+			printf("Fatal Error : %s\n", err.what());
+			return err._retcode;
+		}
+		return 0;
+	}
+
+	printHelp(argv[0]);
+	return 2;
+}
@@ -0,0 +1,70 @@
+/* Scumm Tools
+ * Copyright (C) 2004-2006  The ScummVM Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#ifndef DEV_BENCH_H
+#define DEV_BENCH_H
+
+#include "common/scummsys.h"
+
+/**
+ * Times a piece of code. The code is run once, or, with minMillis, over and
+ * over until that much time has passed, so that short runs can be measured:
+ *
+ *   BenchTimer timer(1000);
+ *   do {
+ *       ...
+ *   } while (timer.next());
+ */
+class BenchTimer {
+public:
+	BenchTimer(uint32 minMillis = 0);
+
+	/** Counts a run, and returns true if the code is to be run again. */
+	bool next();
+
+	uint32 getRuns() const { return _runs; }
+
+	/** Milliseconds taken by all runs, at least 1. */
+	uint32 getElapsed() const { return _elapsed; }
+
+	/** Converts an amount handled per run, like bytes or samples, to an amount per second. */
+	double perSecond(double amountPerRun) const { return amountPerRun * _runs * 1000.0 / _elapsed; }
+
+private:
+	uint32 _minMillis;
+	uint32 _start;
+	uint32 _runs;
+	uint32 _elapsed;
+};
+
+/**
+ * The benchmarks, see the table in bench.cpp. They are given the arguments
+ * after the benchmark name, and throw a ToolException on errors.
+ */
+void benchADPCM(int argc, char *argv[]);
+void benchBundleCodecs(int argc, char *argv[]);
+void benchFileReads(int argc, char *argv[]);
+void benchMohawkOpen(int argc, char *argv[]);
+void benchPCM(int argc, char *argv[]);
+void benchTinselADPCM(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,99 @@
+/* Scumm Tools
+ * Copyright (C) 2004-2006  The ScummVM Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "dev/bench/bench.h"
+#include "common/file.h"
+#include "common/util.h"
+#include "sound/adpcm.h"
+
+/**
+ * Decodes everything left in an ADPCM stream into samples and deletes the
+ * stream.
+ *
+ * @return the number of samples decoded
+ */
+static uint32 decodeADPCM(Audio::AudioStream *stream, std::vector<int16> &samples) {
+	const int chunkSamples = 4096;
+	uint32 total = 0;
+
+	while (!stream->endOfData()) {
+		if (samples.size() < total + chunkSamples)
+			samples.resize(total + chunkSamples);
+		int decoded = stream->readBuffer(&samples[total], chunkSamples);
+		if (decoded <= 0)
+			break;
+		total += decoded;
+	}
+
+	delete stream;
+	return total;
+}
+
+/* Decodes the file as each ADPCM format, once from the file and once from
+ * memory, checks that both give the same samples, and shows how long each took. */
+void benchADPCM(int argc, char *argv[]) {
+	Common::File file(argv[0], "rb");
+	uint32 size = file.size();
+	std::vector<byte> data(size + 1);
+	file.read_throwsOnError(&data[0], size);
+	double mbytes = size / 1000000.0;
+
+	printf("Decoding %u bytes from %s\n", size, argv[0]);
+
+	static const struct {
+		const char *name;
+		Audio::typesADPCM type;
+		int channels;
+		uint32 blockAlign;
+	} formats[] = {
+		{ "OKI", Audio::kADPCMOki, 1, 0 },
+		{ "MS IMA mono", Audio::kADPCMMSIma, 1, 1024 },
+		{ "MS IMA stereo", Audio::kADPCMMSIma, 2, 2048 },
+		{ "MS mono", Audio::kADPCMMS, 1, 1024 },
+		{ "MS stereo", Audio::kADPCMMS, 2, 2048 }
+	};
+
+	std::vector<int16> fromFile, fromMemory;
+	for (int i = 0; i < ARRAYSIZE(formats); ++i) {
+		file.seek(0, SEEK_SET);
+		BenchTimer fileTimer;
+		uint32 fileSamples = decodeADPCM(Audio::makeADPCMStream(&file, size, formats[i].type, 22050, formats[i].channels, formats[i].blockAlign), fromFile);
+		fileTimer.next();
+
+		BenchTimer memoryTimer;
+		uint32 memorySamples = decodeADPCM(Audio::makeADPCMStream(&data[0], size, formats[i].type, 22050, formats[i].channels, formats[i].blockAlign), fromMemory);
+		memoryTimer.next();
+
+		if (fileSamples != memorySamples || !std::equal(fromFile.begin(), fromFile.begin() + fileSamples, fromMemory.begin()))
+			error("Decoding %s from memory does not match decoding it from the file", formats[i].name);
+
+		printf("%s: %u samples, file %u ms (%.1f MB/s), memory %u ms (%.1f MB/s)\n",
+			formats[i].name, fileSamples, fileTimer.getElapsed(), fileTimer.perSecond(mbytes),
+			memoryTimer.getElapsed(), memoryTimer.perSecond(mbytes));
+	}
+}
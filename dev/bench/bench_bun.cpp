@@ -0,0 +1,116 @@
+/* Scumm Tools
+ * Copyright (C) 2004-2006  The ScummVM Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#include <vector>
+
+#include "dev/bench/bench.h"
+#include "engines/scumm/compress_scumm_bun.h"
+
+/* Reads and decodes bundles with the code of compress_scumm_bun */
+class BundleCodecBench : public CompressScummBun {
+public:
+	void run(const char *path);
+
+private:
+	struct Entry {
+		CompTable *compTable;
+		int numCompItems;
+		byte *compInput;
+	};
+
+	void decodeCodec(const std::vector<Entry> &entries, int codec, byte *output);
+};
+
+/* Decodes all blocks of the bundle over and over for a while, one codec at a
+ * time, and shows the decoded megabytes per second of each codec. */
+void BundleCodecBench::run(const char *path) {
+	Common::File input(path, "rb");
+	initializeImcTables();
+	int numFiles = readBundleTable(input);
+
+	std::vector<Entry> entries;
+	byte *output = (byte *)malloc(0x2000);
+
+	try {
+		for (int i = 0; i < numFiles; i++) {
+			if (strcmp(_bundleTable[i].filename, "PRELOAD.") == 0)
+				continue;
+
+			Entry entry = { NULL, 0, NULL };
+			entries.push_back(entry);
+			readCompBlocks(i, input, entries.back().compTable, entries.back().numCompItems, entries.back().compInput);
+		}
+
+		for (int codec = 0; codec < 16; codec++)
+			decodeCodec(entries, codec, output);
+	} catch (...) {
+		for (uint i = 0; i < entries.size(); i++) {
+			free(entries[i].compTable);
+			free(entries[i].compInput);
+		}
+		free(output);
+		free(_bundleTable);
+		throw;
+	}
+
+	for (uint i = 0; i < entries.size(); i++) {
+		free(entries[i].compTable);
+		free(entries[i].compInput);
+	}
+	free(output);
+	free(_bundleTable);
+}
+
+void BundleCodecBench::decodeCodec(const std::vector<Entry> &entries, int codec, byte *output) {
+	uint32 numBlocks = 0, inputSize = 0, outputSize = 0;
+	BenchTimer timer(1000);
+
+	do {
+		for (uint i = 0; i < entries.size(); i++) {
+			byte *compInput = entries[i].compInput;
+			CompTable *compTable = entries[i].compTable;
+
+			for (int j = 0; j < entries[i].numCompItems; j++) {
+				if (compTable[j].codec == codec) {
+					int size = decompressCodec(codec, compInput, output, compTable[j].size);
+					assert(size <= 0x2000);
+					if (timer.getRuns() == 0) {
+						numBlocks++;
+						inputSize += compTable[j].size;
+						outputSize += size;
+					}
+				}
+				compInput += compTable[j].size + 1;
+			}
+		}
+	} while (numBlocks && timer.next());
+
+	if (numBlocks) {
+		printf("Codec %2d: %6u blocks, %9u -> %9u bytes, %8.1f MB/s\n", codec, numBlocks, inputSize, outputSize,
+			timer.perSecond(outputSize) / 1000000.0);
+	}
+}
+
+void benchBundleCodecs(int argc, char *argv[]) {
+	BundleCodecBench bench;
+	bench.run(argv[0]);
+}
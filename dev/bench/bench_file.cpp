@@ -0,0 +1,96 @@
+/* Scumm Tools
+ * Copyright (C) 2004-2006  The ScummVM Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+
+#include <stdio.h>
+#include <string>
+
+#include "dev/bench/bench.h"
+#include "common/file.h"
+#include "common/util.h"
+
+/**
+ * Reads a file the way Common::File did before it had a read buffer,
+ * with one fgetc call per byte, for comparison.
+ */
+static uint32 readWordsPerByte(const std::string &filename, uint8 xormode, uint32 count) {
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file)
+		throw Common::FileException("Could not open file " + filename);
+
+	uint32 sum = 0;
+	for (uint32 i = 0; i < count; ++i) {
+		uint32 word = 0;
+		for (int shift = 0; shift < 32; shift += 8) {
+			int b = fgetc(file);
+			if (b == EOF) {
+				fclose(file);
+				throw Common::FileException("Read beyond the end of file (" + filename + ")");
+			}
+			word |= (uint32)((b ^ xormode) & 0xFF) << shift;
+		}
+		sum = sum * 31 + word;
+	}
+
+	fclose(file);
+	return sum;
+}
+
+static uint32 readWordsBuffered(const std::string &filename, uint8 xormode, uint32 count) {
+	Common::File file(filename, "rb");
+	file.setXorMode(xormode);
+
+	uint32 sum = 0;
+	for (uint32 i = 0; i < count; ++i)
+		sum = sum * 31 + file.readUint32LE();
+	return sum;
+}
+
+/* Reads the file as 32-bit words byte by byte and through the read buffer of
+ * Common::File, with and without xor, checks that both give the same words,
+ * and shows how long each took. */
+void benchFileReads(int argc, char *argv[]) {
+	std::string filename = argv[0];
+	uint32 count = Common::File(filename, "rb").size() / 4;
+	double mbytes = count * 4 / 1000000.0;
+
+	printf("Reading %u 32-bit words from %s\n", count, filename.c_str());
+
+	static const uint8 xorModes[] = { 0x00, 0xFF };
+	for (int i = 0; i < ARRAYSIZE(xorModes); ++i) {
+		BenchTimer perByteTimer;
+		uint32 expected = readWordsPerByte(filename, xorModes[i], count);
+		perByteTimer.next();
+
+		BenchTimer bufferedTimer;
+		uint32 sum = readWordsBuffered(filename, xorModes[i], count);
+		bufferedTimer.next();
+
+		if (sum != expected)
+			error("Buffered reads do not match fgetc reads");
+
+		printf("xor 0x%02X: fgetc %u ms (%.1f MB/s), buffered %u ms (%.1f MB/s), %.1fx\n",
+			xorModes[i], perByteTimer.getElapsed(), perByteTimer.perSecond(mbytes),
+			bufferedTimer.getElapsed(), bufferedTimer.perSecond(mbytes),
+			(double)perByteTimer.getElapsed() / bufferedTimer.getElapsed());
+	}
+}
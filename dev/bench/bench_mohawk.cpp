@@ -0,0 +1,62 @@
+/* Scumm Tools
+ * Copyright (C) 2004-2006  The ScummVM Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+
+#include <stdio.h>
+
+#include "dev/bench/bench.h"
+#include "engines/mohawk/archive.h"
+#include "common/file.h"
+#include "common/util.h"
+
+/* Opens each archive over and over for a while, and shows the average time
+ * per open. The archive takes over the file and closes it, so opening the
+ * file is timed too. */
+void benchMohawkOpen(int argc, char *argv[]) {
+	// The resource directory is dumped by debug(), which would be timed too
+	setDebugLevel(-1);
+
+	for (int i = 0; i < argc; i++) {
+		BenchTimer timer(1000);
+
+		do {
+			Common::File *file = new Common::File(argv[i], "rb");
+			MohawkArchive *mohawkArchive;
+
+			try {
+				mohawkArchive = MohawkArchive::createMohawkArchive(file);
+			} catch (...) {
+				delete file;
+				throw;
+			}
+
+			if (!mohawkArchive) {
+				delete file;
+				error("'%s' is not a valid Mohawk archive", argv[i]);
+			}
+
+			delete mohawkArchive;
+		} while (timer.next());
+
+		printf("%s: %.3f ms per open\n", argv[i], (double)timer.getElapsed() / timer.getRuns());
+	}
+}
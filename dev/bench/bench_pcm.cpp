@@ -0,0 +1,142 @@
+/* Scumm Tools
+ * Copyright (C) 2004-2006  The ScummVM Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "dev/bench/bench.h"
+#include "common/endian.h"
+#include "common/util.h"
+#include "sound/audiostream.h"
+#include "sound/pcm.h"
+
+/**
+ * Converts samples the way the encoders did before there were shared PCM
+ * conversion routines, one sample at a time, for comparison.
+ */
+static void convertPCMPerSample(int16 *dst16, int32 *dst32, float *const *dstFloat, const byte *src, uint32 frames, int channels, byte flags) {
+	const bool is16Bit = (flags & Audio::Mixer::FLAG_16BITS) != 0;
+	const bool isLE = (flags & Audio::Mixer::FLAG_LITTLE_ENDIAN) != 0;
+	const uint32 count = frames * channels;
+
+	for (uint32 i = 0; i < count; i++) {
+		int value;
+		if (!is16Bit)
+			value = ((int)src[i] - 128) << 8;
+		else if (isLE)
+			value = (int16)READ_LE_UINT16(src + 2 * i);
+		else
+			value = (int16)READ_BE_UINT16(src + 2 * i);
+
+		if (dst16)
+			dst16[i] = value;
+		if (dst32)
+			dst32[i] = is16Bit ? value : value / 256;
+		if (dstFloat)
+			dstFloat[i % channels][i / channels] = value / 32768.0f;
+	}
+}
+
+/* Converts generated samples of each layout to int16, int32 and float, one
+ * by one and with the shared routines, checks that both give the same
+ * samples, and shows the million samples per second of each. */
+void benchPCM(int argc, char *argv[]) {
+	const uint32 frames = 1 << 21;
+	const int rounds = 8;
+
+	std::vector<byte> src(frames * 2 * 2);
+	uint32 seed = 1;
+	for (size_t i = 0; i < src.size(); ++i) {
+		seed = seed * 1103515245 + 12345;
+		src[i] = (byte)(seed >> 16);
+	}
+
+	std::vector<int16> int16Ref(frames * 2), int16Out(frames * 2);
+	std::vector<int32> int32Ref(frames * 2), int32Out(frames * 2);
+	std::vector<float> floatRef(frames * 2), floatOut(frames * 2);
+	float *floatRefPlanes[2] = { &floatRef[0], &floatRef[frames] };
+	float *floatOutPlanes[2] = { &floatOut[0], &floatOut[frames] };
+
+	static const struct {
+		const char *name;
+		byte flags;
+	} layouts[] = {
+		{ "8-bit unsigned", Audio::Mixer::FLAG_UNSIGNED },
+		{ "16-bit LE", Audio::Mixer::FLAG_16BITS | Audio::Mixer::FLAG_LITTLE_ENDIAN },
+		{ "16-bit BE", Audio::Mixer::FLAG_16BITS }
+	};
+
+	printf("Converting %u frames %d times per layout\n", frames, rounds);
+	printf("Million samples per second, one by one -> shared routines\n");
+
+	for (int i = 0; i < ARRAYSIZE(layouts); ++i) {
+		for (int channels = 1; channels <= 2; ++channels) {
+			const byte flags = layouts[i].flags;
+			const uint32 count = frames * channels;
+			const double msamples = (double)count * rounds / 1000000.0;
+
+			BenchTimer int16RefTimer;
+			for (int round = 0; round < rounds; ++round)
+				convertPCMPerSample(&int16Ref[0], NULL, NULL, &src[0], frames, channels, flags);
+			int16RefTimer.next();
+
+			BenchTimer int16Timer;
+			for (int round = 0; round < rounds; ++round)
+				Audio::convertPCMToInt16(&int16Out[0], &src[0], count, flags);
+			int16Timer.next();
+
+			BenchTimer int32RefTimer;
+			for (int round = 0; round < rounds; ++round)
+				convertPCMPerSample(NULL, &int32Ref[0], NULL, &src[0], frames, channels, flags);
+			int32RefTimer.next();
+
+			BenchTimer int32Timer;
+			for (int round = 0; round < rounds; ++round)
+				Audio::convertPCMToInt32(&int32Out[0], &src[0], count, flags);
+			int32Timer.next();
+
+			BenchTimer floatRefTimer;
+			for (int round = 0; round < rounds; ++round)
+				convertPCMPerSample(NULL, NULL, floatRefPlanes, &src[0], frames, channels, flags);
+			floatRefTimer.next();
+
+			BenchTimer floatTimer;
+			for (int round = 0; round < rounds; ++round)
+				Audio::convertPCMToFloat(floatOutPlanes, &src[0], frames, channels, flags);
+			floatTimer.next();
+
+			if (!std::equal(int16Ref.begin(), int16Ref.begin() + count, int16Out.begin()) ||
+				!std::equal(int32Ref.begin(), int32Ref.begin() + count, int32Out.begin()) ||
+				!std::equal(floatRef.begin(), floatRef.begin() + frames, floatOut.begin()) ||
+				(channels == 2 && !std::equal(floatRef.begin() + frames, floatRef.begin() + 2 * frames, floatOut.begin() + frames)))
+				error("Converting %s samples does not match converting them one by one", layouts[i].name);
+
+			printf("%s %s: int16 %.1f -> %.1f, int32 %.1f -> %.1f, float %.1f -> %.1f\n",
+				layouts[i].name, (channels == 2) ? "stereo" : "mono",
+				int16RefTimer.perSecond(msamples), int16Timer.perSecond(msamples),
+				int32RefTimer.perSecond(msamples), int32Timer.perSecond(msamples),
+				floatRefTimer.perSecond(msamples), floatTimer.perSecond(msamples));
+		}
+	}
+}
@@ -0,0 +1,186 @@
+/* Scumm Tools
+ * Copyright (C) 2004-2006  The ScummVM Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+
+#include <stdio.h>
+#include <vector>
+
+#include "dev/bench/bench.h"
+#include "common/endian.h"
+#include "common/file.h"
+#include "common/util.h"
+#include "sound/adpcm.h"
+
+/* The double precision decoder compress_tinsel used before Audio::decodeTinsel6(),
+ * kept to check and time the new decoder against */
+static uint32 decodeTinselADPCMReference(int16 *outBuffer, const byte *inBuffer, uint32 sampleSize) {
+	const byte *inPos;
+	int16 *outPos;
+	double predictor = 0;
+	double k0 = 0, k1 = 0;
+	double d0 = 0, d1 = 0;
+	uint32 blockAlign, blockPos;
+	uint16 chunkData = 0;
+	int16 chunkWord = 0;
+	uint8 headerByte, filterVal, chunkPos = 0;
+	const double eVal = 1.032226562;
+	uint32 decodeLeft = 0, decodedCount = 0;
+	double sample;
+
+	// 1 channel, 22050 rate, block align 24,
+	blockAlign = 24; // Fixed for Tinsel 6-bit
+	blockPos = blockAlign; // To make sure first header is read
+
+	inPos = inBuffer; outPos = outBuffer;
+	decodeLeft = sampleSize;
+	while (decodeLeft > 0) {
+		if (blockPos == blockAlign) {
+			// read Tinsel header
+			headerByte = *inPos; inPos++; decodeLeft--;
+			filterVal = (headerByte & 0xC0) >> 6;
+
+			if ((headerByte & 0x20) != 0) {
+				//Lower 6 bit are negative
+				// Negate
+				headerByte = ~(headerByte | 0xC0) + 1;
+				predictor = 1 << headerByte;
+			} else {
+				// Lower 6 bit are positive
+				// Truncate
+				headerByte &= 0x1F;
+				predictor = ((double) 1.0) / (1 << headerByte);
+			}
+			k0 = Audio::TinselFilterTable[filterVal][0];
+			k1 = Audio::TinselFilterTable[filterVal][1];
+			blockPos = 0;
+			chunkPos = 0;
+		}
+
+		switch (chunkPos) {
+		case 0:
+			chunkData = *inPos; inPos++; decodeLeft--;
+			chunkWord = (chunkData << 8) & 0xFC00;
+			break;
+		case 1:
+			chunkData = (chunkData << 8) | *inPos; inPos++; decodeLeft--;
+			blockPos++;
+			chunkWord = (chunkData << 6) & 0xFC00;
+			break;
+		case 2:
+			chunkData = (chunkData << 8) | *inPos; inPos++; decodeLeft--;
+			blockPos++;
+			chunkWord = (chunkData << 4) & 0xFC00;
+			break;
+		case 3:
+			chunkData = chunkData << 8;
+			blockPos++;
+			chunkWord = (chunkData << 2) & 0xFC00;
+			break;
+		}
+		sample = chunkWord;
+		sample *= eVal * predictor;
+		sample += (d0 * k0) + (d1 * k1);
+		d1 = d0;
+		d0 = sample;
+		*outPos = (int16) CLIP<double>(sample, -32768.0, 32767.0); outPos++;
+		decodedCount++;
+		chunkPos = (chunkPos + 1) % 4;
+	}
+
+	return decodedCount;
+}
+
+/* Decodes all ADPCM samples of the sample file over and over for a while, with
+ * the old and the new decoder, checks that both give the same samples, and shows
+ * the decoded megabytes per second of each. */
+void benchTinselADPCM(int argc, char *argv[]) {
+	Common::File input_smp(argv[0], "rb");
+	Common::File input_idx(argv[1], "rb");
+	std::vector<byte> input;
+	std::vector<uint32> sizes;
+	uint32 maxSize = 0;
+
+	uint32 indexCount = input_idx.size() / sizeof(uint32);
+
+	for (uint32 indexNo = 0; indexNo < indexCount; indexNo++) {
+		uint32 indexOffset = input_idx.readUint32LE();
+		if (!indexOffset)
+			continue;
+		if (indexNo == 0)
+			error("The sourcefiles are already compressed");
+
+		input_smp.seek(indexOffset, SEEK_SET);
+		uint32 sampleSize = input_smp.readUint32LE();
+		if (!(sampleSize & 0x80000000))
+			continue;
+
+		for (uint32 sampleCount = sampleSize & ~0x80000000; sampleCount > 0; sampleCount--) {
+			sampleSize = input_smp.readUint32LE();
+			if (!sampleSize)
+				continue;
+			input.resize(input.size() + sampleSize);
+			input_smp.read_throwsOnError(&input[input.size() - sampleSize], sampleSize);
+			sizes.push_back(sampleSize);
+			maxSize = MAX(maxSize, sampleSize);
+		}
+	}
+
+	if (sizes.empty())
+		error("The sample file holds no ADPCM samples");
+
+	std::vector<int16> oldOutput(4 * (maxSize / 3 + 1));
+	std::vector<byte> newOutput(8 * (maxSize / 3 + 1));
+	uint32 outputSize = 0;
+	const byte *in = &input[0];
+
+	for (uint i = 0; i < sizes.size(); i++) {
+		uint32 oldCount = decodeTinselADPCMReference(&oldOutput[0], in, sizes[i]);
+		uint32 newCount = Audio::decodeTinsel6(&newOutput[0], in, sizes[i]);
+		if (oldCount != newCount)
+			error("Sample %d: the decoders give %u and %u samples", i, oldCount, newCount);
+		for (uint32 j = 0; j < newCount; j++) {
+			if (oldOutput[j] != (int16)READ_LE_UINT16(&newOutput[2 * j]))
+				error("Sample %d: the decoders differ at sample %u", i, j);
+		}
+		outputSize += newCount * 2;
+		in += sizes[i];
+	}
+
+	printf("%u ADPCM samples, %u -> %u bytes\n", (uint)sizes.size(), (uint)input.size(), outputSize);
+
+	for (int decoder = 0; decoder < 2; decoder++) {
+		BenchTimer timer(1000);
+
+		do {
+			in = &input[0];
+			for (uint i = 0; i < sizes.size(); i++) {
+				if (decoder == 0)
+					decodeTinselADPCMReference(&oldOutput[0], in, sizes[i]);
+				else
+					Audio::decodeTinsel6(&newOutput[0], in, sizes[i]);
+				in += sizes[i];
+			}
+		} while (timer.next());
+
+		printf("%s decoder: %8.1f MB/s\n", decoder == 0 ? "Old" : "New", timer.perSecond(outputSize) / 1000000.0);
+	}
+}
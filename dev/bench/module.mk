@@ -0,0 +1,31 @@
+######################################################################
+# Benchmarks of the decoders and file access of the tools, for
+# development. Use the 'bench' target to build them; they are not part
+# of 'all', and are not installed.
+# Add a benchmark to the table in bench.cpp, and its object to
+# bench_OBJS.
+#
+######################################################################
+
+bench_OBJS := \
+	dev/bench/bench.o \
+	dev/bench/bench_adpcm.o \
+	dev/bench/bench_bun.o \
+	dev/bench/bench_file.o \
+	dev/bench/bench_mohawk.o \
+	dev/bench/bench_pcm.o \
+	dev/bench/bench_tinsel.o \
+	engines/mohawk/archive.o \
+	$(tools_OBJS)
+
+MODULE_DIRS += dev/bench/
+
+bench: dev/bench/scummvm-tools-bench$(EXEEXT)
+dev/bench/scummvm-tools-bench$(EXEEXT): $(bench_OBJS)
+	$(QUIET_LINK)$(LD) -o $@ $(bench_OBJS) $(LDFLAGS) $(LIBS)
+
+clean: clean-bench
+clean-bench:
+	-$(RM) dev/bench/scummvm-tools-bench$(EXEEXT)
+
+.PHONY: bench clean-bench
@@ -25,9 +25,15 @@
 #include <sys/stat.h>
 #include <png.h>
 #include <zlib.h>
+#include <vector>
 
 #include "encode_dxa.h"
 #include "common/endian.h"
+#include "common/util.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 const uint32 typeDEXA = 0x41584544;
 const uint32 typeFRAM = 0x4d415246;
@@ -41,20 +47,36 @@ const uint32 typeNULL = 0x4C4C554E;
 #define  BLOCKW	4
 #define  BLOCKH	4
 
+// the previous frame is followed by this many zero bytes, so that the motion
+// search can read whole rows of candidates past the last pixel
+#define  FRAME_PADDING	32
+
 struct DiffStruct {
 	uint16 map;
 	int count;
 	byte pixels[BLOCKW*BLOCKH];
 };
 
-class DxaEncoder {
+/* Encodes a frame as the difference to the previous one. As the encoding only
+ * depends on these two frames, several frames can be encoded at the same time,
+ * each one with its own DxaFrameEncoder. */
+class DxaFrameEncoder {
 private:
-	Common::File _dxa;
-	int _width, _height, _framerate, _framecount, _workheight;
-	uint8 *_prevframe, *_prevpalette;
-	ScaleMode _scaleMode;
+	int _width, _height, _workheight;
+	const uint8 *_prevframe;
 
 	byte *_codeBuf, *_dataBuf, *_motBuf, *_maskBuf;
+	int _colTab[256];
+
+	/* scratch buffers of encodeFrame, kept from one frame to the next */
+	byte *_xorBuf, *_xorBufZ, *_rawBufZ, *_m13Buf, *_m13BufZ;
+
+	/* compression level 9, and level 1 for the trials at higher speeds */
+	int _speed;
+	z_stream _zstream, _fastZstream;
+	int deflateBuffer(z_stream &stream, byte *dest, uLong *destLen, const byte *source, uLong sourceLen);
+	byte *compressCandidates(z_stream &stream, uint8 *frame, uLong m13size, byte &compType, uLong &frameoutsize);
+
 	void grabBlock(byte *frame, int x, int y, int blockw, int blockh, byte *block);
 	bool m13blocksAreEqual(byte *frame, int x, int y, int x2, int y2, int w, int h);
 	bool m13blockIsSolidColor(byte *frame, int x, int y, int w, int h, byte &color);
@@ -64,28 +86,39 @@ private:
 	uLong m13encode(byte *frame, byte *outbuf);
 
 public:
-	DxaEncoder(Tool &tool, Common::Filename filename, int width, int height, int framerate, ScaleMode scaleMode);
+	DxaFrameEncoder(int width, int height, ScaleMode scaleMode, int speed);
+	~DxaFrameEncoder();
+	void encodeFrame(const uint8 *prevframe, const uint8 *prevpalette, uint8 *frame, uint8 *palette, Common::MemoryWriteStreamDynamic &output);
+};
+
+class DxaEncoder {
+private:
+	Common::File _dxa;
+	int _width, _height, _framerate, _framecount;
+	ScaleMode _scaleMode;
+	int _speed;
+
+	std::vector<DxaFrameEncoder *> _frameEncoders;
+
+public:
+	DxaEncoder(Tool &tool, Common::Filename filename, int width, int height, int framerate, ScaleMode scaleMode, int speed);
 	~DxaEncoder();
 	void writeHeader();
 	void writeNULL();
-	void writeFrame(uint8 *frame, uint8 *palette);
+	void writeFrame(const byte *data, uint32 size);
+
+	/** Returns the frame encoder of the given slot, creating it on first use. */
+	DxaFrameEncoder *getFrameEncoder(uint slot);
 };
 
-DxaEncoder::DxaEncoder(Tool &tool, Common::Filename filename, int width, int height, int framerate, ScaleMode scaleMode) {
+DxaEncoder::DxaEncoder(Tool &tool, Common::Filename filename, int width, int height, int framerate, ScaleMode scaleMode, int speed) {
 	_dxa.open(filename, "wb");
 	_width = width;
 	_height = height;
 	_framerate = framerate;
 	_framecount = 0;
-	_prevframe = new uint8[_width * _height];
-	_prevpalette = new uint8[768];
 	_scaleMode = scaleMode;
-	_workheight = _scaleMode == S_NONE ? _height : _height / 2;
-
-	_codeBuf = new byte[_width * _height / 16];
-	_dataBuf = new byte[_width * _height];
-	_motBuf = new byte[_width * _height];
-	_maskBuf = new byte[_width * _height];
+	_speed = speed;
 
 	writeHeader();
 }
@@ -95,13 +128,14 @@ DxaEncoder::~DxaEncoder() {
 
 	writeHeader();
 
-	delete[] _codeBuf;
-	delete[] _dataBuf;
-	delete[] _motBuf;
-	delete[] _maskBuf;
+	for (uint i = 0; i < _frameEncoders.size(); i++)
+		delete _frameEncoders[i];
+}
 
-	delete[] _prevframe;
-	delete[] _prevpalette;
+DxaFrameEncoder *DxaEncoder::getFrameEncoder(uint slot) {
+	while (_frameEncoders.size() <= slot)
+		_frameEncoders.push_back(new DxaFrameEncoder(_width, _height, _scaleMode, _speed));
+	return _frameEncoders[slot];
 }
 
 void DxaEncoder::writeHeader() {
@@ -128,123 +162,228 @@ void DxaEncoder::writeNULL() {
 	_dxa.writeUint32LE(typeNULL);
 }
 
-void DxaEncoder::writeFrame(byte *frame, byte *palette) {
+/* write a frame as encoded by DxaFrameEncoder::encodeFrame */
+void DxaEncoder::writeFrame(const byte *data, uint32 size) {
+	_dxa.write(data, size);
+	_framecount++;
+}
+
+DxaFrameEncoder::DxaFrameEncoder(int width, int height, ScaleMode scaleMode, int speed) {
+	_width = width;
+	_height = height;
+	_workheight = scaleMode == S_NONE ? _height : _height / 2;
+	_prevframe = NULL;
+
+	_codeBuf = new byte[_width * _height / 16];
+	_dataBuf = new byte[_width * _height];
+	_motBuf = new byte[_width * _height];
+	_maskBuf = new byte[_width * _height];
 
-	if (_framecount == 0 || memcmp(_prevpalette, palette, 768)) {
-		_dxa.writeUint32LE(typeCMAP);
-		_dxa.write(palette, 768);
-		memcpy(_prevpalette, palette, 768);
+	for (int i = 0; i < 256; i++)
+		_colTab[i] = -1;
+
+	_xorBuf = new byte[_width * _workheight];
+	_xorBufZ = new byte[_width * _workheight];
+	_rawBufZ = new byte[_width * _workheight];
+	_m13Buf = new byte[_width * _workheight * 2];
+	_m13BufZ = new byte[_width * _workheight];
+
+	_speed = speed;
+	memset(&_zstream, 0, sizeof(_zstream));
+	memset(&_fastZstream, 0, sizeof(_fastZstream));
+	if (deflateInit(&_zstream, 9) != Z_OK || deflateInit(&_fastZstream, 1) != Z_OK)
+		throw ToolException("Could not initialize zlib");
+}
+
+DxaFrameEncoder::~DxaFrameEncoder() {
+	deflateEnd(&_zstream);
+	deflateEnd(&_fastZstream);
+
+	delete[] _codeBuf;
+	delete[] _dataBuf;
+	delete[] _motBuf;
+	delete[] _maskBuf;
+
+	delete[] _xorBuf;
+	delete[] _xorBufZ;
+	delete[] _rawBufZ;
+	delete[] _m13Buf;
+	delete[] _m13BufZ;
+}
+
+/* same as compress2(dest, destLen, source, sourceLen, level) with the level of the stream,
+   but the zlib state is reset instead of being allocated anew */
+int DxaFrameEncoder::deflateBuffer(z_stream &stream, byte *dest, uLong *destLen, const byte *source, uLong sourceLen) {
+	int r = deflateReset(&stream);
+	if (r != Z_OK)
+		return r;
+
+	stream.next_in = const_cast<Bytef *>(source);
+	stream.avail_in = (uInt)sourceLen;
+	stream.next_out = dest;
+	stream.avail_out = (uInt)*destLen;
+
+	r = deflate(&stream, Z_FINISH);
+	*destLen = stream.total_out;
+	if (r == Z_STREAM_END)
+		return Z_OK;
+	return r == Z_OK ? Z_BUF_ERROR : r;
+}
+
+/* encode the palette and frame chunks of a frame, prevframe and prevpalette are NULL for the first one;
+   prevframe must be followed by FRAME_PADDING zero bytes */
+void DxaFrameEncoder::encodeFrame(const uint8 *prevframe, const uint8 *prevpalette, uint8 *frame, uint8 *palette, Common::MemoryWriteStreamDynamic &output) {
+
+	if (!prevpalette || memcmp(prevpalette, palette, 768)) {
+		output.writeUint32LE(typeCMAP);
+		output.write(palette, 768);
 	} else {
-		writeNULL();
+		//NULL
+		output.writeUint32LE(typeNULL);
 	}
 
-	if (_framecount == 0 || memcmp(_prevframe, frame, _width * _workheight)) {
+	if (!prevframe || memcmp(prevframe, frame, _width * _workheight)) {
 		//FRAM
 		byte compType;
 
-		_dxa.writeUint32LE(typeFRAM);
+		output.writeUint32LE(typeFRAM);
 
-		if (_framecount == 0)
+		if (!prevframe)
 			compType = 2;
 		else
 			compType = 13;
 
+		_prevframe = prevframe;
+
 		switch (compType) {
 
 		case 2:
 			{
 				uLong outsize = _width * _workheight;
-				byte *outbuf = new byte[outsize];
-				compress2(outbuf, &outsize, frame, _width * _workheight, 9);
-				_dxa.writeByte(compType);
-				_dxa.writeUint32BE(outsize);
-				_dxa.write(outbuf, outsize);
-				delete[] outbuf;
+				deflateBuffer(_speed == 2 ? _fastZstream : _zstream, _rawBufZ, &outsize, frame, _width * _workheight);
+				output.writeByte(compType);
+				output.writeUint32BE(outsize);
+				output.write(_rawBufZ, outsize);
 				break;
 			}
 
 		case 13:
 			{
-				int r;
 				uLong frameoutsize;
 				byte *frameoutbuf;
-
-				byte *xorbuf = new byte[_width * _workheight];
-				uLong xorsize_z = _width * _workheight;
-				byte *xorbuf_z = new byte[xorsize_z];
-
-				uLong rawsize_z = _width * _workheight;
-				byte *rawbuf_z = new byte[rawsize_z];
-
-				uLong m13size = _width * _workheight * 2;
-				byte *m13buf = new byte[m13size];
-				uLong m13size_z = _width * _workheight;
-				byte *m13buf_z = new byte[m13size_z];
+				uLong m13size;
 
 				/* encode the delta frame with mode 12 */
-				m13size = m13encode(frame, m13buf);
+				m13size = m13encode(frame, _m13Buf);
 
 				/* create the xor buffer */
-				for (int i = 0; i < _width * _workheight; i++)
-					xorbuf[i] = _prevframe[i] ^ frame[i];
-
-				/* compress the m13 buffer */
-				compress2(m13buf_z, &m13size_z, m13buf, m13size, 9);
-
-				/* compress the xor buffer */
-				xorsize_z = m13size_z;
-				r = compress2(xorbuf_z, &xorsize_z, xorbuf, _width * _workheight, 9);
-				if (r != Z_OK) xorsize_z = 0xFFFFFFF;
-
-				if (m13size_z < xorsize_z) {
-					compType = 13;
-					frameoutsize = m13size_z;
-					frameoutbuf = m13buf_z;
-				} else {
-					compType = 3;
-					frameoutsize = xorsize_z;
-					frameoutbuf = xorbuf_z;
+				int i = 0;
+#ifdef __SSE2__
+				for (; i + 16 <= _width * _workheight; i += 16) {
+					__m128i p = _mm_loadu_si128((const __m128i *)(_prevframe + i));
+					__m128i f = _mm_loadu_si128((const __m128i *)(frame + i));
+					_mm_storeu_si128((__m128i *)(_xorBuf + i), _mm_xor_si128(p, f));
 				}
+#endif
+				for (; i < _width * _workheight; i++)
+					_xorBuf[i] = _prevframe[i] ^ frame[i];
 
-				/* compress the raw frame */
-				rawsize_z = frameoutsize;
-				r = compress2(rawbuf_z, &rawsize_z, frame, _width * _workheight, 9);
-				if (r != Z_OK) rawsize_z = 0xFFFFFFF;
-
-				if (rawsize_z < frameoutsize) {
-					compType = 2;
-					frameoutsize = rawsize_z;
-					frameoutbuf = rawbuf_z;
+				if (_speed == 0) {
+					frameoutbuf = compressCandidates(_zstream, frame, m13size, compType, frameoutsize);
+				} else {
+					/* pick the smallest candidate with quick trials */
+					frameoutbuf = compressCandidates(_fastZstream, frame, m13size, compType, frameoutsize);
+
+					if (_speed == 1) {
+						/* and only compress the winner at the highest level */
+						const byte *src = (compType == 13) ? _m13Buf : (compType == 3) ? _xorBuf : frame;
+						uLong srcsize = (compType == 13) ? m13size : _width * _workheight;
+						uLong outsize = _width * _workheight;
+
+						if (deflateBuffer(_zstream, frameoutbuf, &outsize, src, srcsize) == Z_OK && outsize <= frameoutsize) {
+							frameoutsize = outsize;
+						} else {
+							frameoutsize = _width * _workheight;
+							deflateBuffer(_fastZstream, frameoutbuf, &frameoutsize, src, srcsize);
+						}
+					}
 				}
 
-				_dxa.writeByte(compType);
-				_dxa.writeUint32BE(frameoutsize);
-				_dxa.write(frameoutbuf, frameoutsize);
-
-				delete[] xorbuf_z;
-				delete[] rawbuf_z;
-				delete[] m13buf_z;
-				delete[] m13buf;
-				delete[] xorbuf;
+				output.writeByte(compType);
+				output.writeUint32BE(frameoutsize);
+				output.write(frameoutbuf, frameoutsize);
 
 				break;
 			}
 		}
 
-		memcpy(_prevframe, frame, _width * _workheight);
+		_prevframe = NULL;
 
 	} else {
-		writeNULL();
+		//NULL
+		output.writeUint32LE(typeNULL);
 	}
+}
 
-	_framecount++;
+/* compress the mode 13, xor and raw versions of a frame and return the smallest one,
+   each of them is only compressed as far as it is smaller than the ones before */
+byte *DxaFrameEncoder::compressCandidates(z_stream &stream, uint8 *frame, uLong m13size, byte &compType, uLong &frameoutsize) {
+	int r;
+	byte *frameoutbuf;
+
+	uLong xorsize_z = _width * _workheight;
+	uLong rawsize_z = _width * _workheight;
+	uLong m13size_z = _width * _workheight;
+
+	/* compress the m13 buffer */
+	deflateBuffer(stream, _m13BufZ, &m13size_z, _m13Buf, m13size);
+
+	/* compress the xor buffer */
+	xorsize_z = m13size_z;
+	r = deflateBuffer(stream, _xorBufZ, &xorsize_z, _xorBuf, _width * _workheight);
+	if (r != Z_OK) xorsize_z = 0xFFFFFFF;
+
+	if (m13size_z < xorsize_z) {
+		compType = 13;
+		frameoutsize = m13size_z;
+		frameoutbuf = _m13BufZ;
+	} else {
+		compType = 3;
+		frameoutsize = xorsize_z;
+		frameoutbuf = _xorBufZ;
+	}
+
+	/* compress the raw frame */
+	rawsize_z = frameoutsize;
+	r = deflateBuffer(stream, _rawBufZ, &rawsize_z, frame, _width * _workheight);
+	if (r != Z_OK) rawsize_z = 0xFFFFFFF;
+
+	if (rawsize_z < frameoutsize) {
+		compType = 2;
+		frameoutsize = rawsize_z;
+		frameoutbuf = _rawBufZ;
+	}
+
+	return frameoutbuf;
 }
 
-bool DxaEncoder::m13blocksAreEqual(byte *frame, int x, int y, int x2, int y2, int w, int h) {
-	byte *b1 = _prevframe + x + y * _width;
+/* the rows of the 4x4 blocks and 2x2 subblocks are compared as a whole */
+static inline uint32 readRow(const byte *row, int w) {
+	if (w == 4) {
+		uint32 value;
+		memcpy(&value, row, 4);
+		return value;
+	}
+	uint16 value;
+	memcpy(&value, row, 2);
+	return value;
+}
+
+bool DxaFrameEncoder::m13blocksAreEqual(byte *frame, int x, int y, int x2, int y2, int w, int h) {
+	const byte *b1 = _prevframe + x + y * _width;
 	byte *b2 = frame + x2 + y2 * _width;
 	for (int yc = 0; yc < h; yc++) {
-		if (memcmp(b1, b2, w))
+		if (readRow(b1, w) != readRow(b2, w))
 			return false;
 		b1 += _width;
 		b2 += _width;
@@ -252,31 +391,36 @@ bool DxaEncoder::m13blocksAreEqual(byte *frame, int x, int y, int x2, int y2, in
 	return true;
 }
 
-bool DxaEncoder::m13blockIsSolidColor(byte *frame, int x, int y, int w, int h, byte &color) {
+bool DxaFrameEncoder::m13blockIsSolidColor(byte *frame, int x, int y, int w, int h, byte &color) {
 	byte *b2 = frame + x + y * _width;
 	color = *b2;
-	for (int yc = 0; yc < h; yc++) {
-		for (int xc = 0; xc < w; xc++) {
-			if (b2[xc] != color)
-				return false;
-		}
+	const uint32 solidRow = readRow(b2, w);
+	if (solidRow != (color * (w == 4 ? 0x01010101U : 0x0101U)))
+		return false;
+	for (int yc = 1; yc < h; yc++) {
 		b2 += _width;
+		if (readRow(b2, w) != solidRow)
+			return false;
 	}
 	return true;
 }
 
-void DxaEncoder::m13blockDelta(byte *frame, int x, int y, int x2, int y2, DiffStruct &diff) {
-	byte *b1 = _prevframe + x + y * _width;
+void DxaFrameEncoder::m13blockDelta(byte *frame, int x, int y, int x2, int y2, DiffStruct &diff) {
+	const byte *b1 = _prevframe + x + y * _width;
 	byte *b2 = frame + x2 + y2 * _width;
 	diff.count = 0;
 	diff.map = 0;
 	for (int yc = 0; yc < BLOCKH; yc++) {
-		for (int xc = 0; xc < BLOCKW; xc++) {
-			if (b1[xc] != b2[xc]) {
-				diff.map = (diff.map << 1) | 1;
-				diff.pixels[diff.count++] = b2[xc];
-			} else {
-				diff.map = (diff.map << 1) | 0;
+		if (readRow(b1, BLOCKW) == readRow(b2, BLOCKW)) {
+			diff.map <<= BLOCKW;
+		} else {
+			for (int xc = 0; xc < BLOCKW; xc++) {
+				if (b1[xc] != b2[xc]) {
+					diff.map = (diff.map << 1) | 1;
+					diff.pixels[diff.count++] = b2[xc];
+				} else {
+					diff.map = (diff.map << 1) | 0;
+				}
 			}
 		}
 		b1 += _width;
@@ -284,14 +428,41 @@ void DxaEncoder::m13blockDelta(byte *frame, int x, int y, int x2, int y2, DiffSt
 	}
 }
 
-bool DxaEncoder::m13motionVector(byte *frame, int x, int y, int w, int h, int &mx, int &my) {
+/* Returns a mask of the positions xmin <= xc < xmax where the row of the
+   previous frame starting at xc matches the given row of w pixels.
+   Only up to 16 positions are looked at. */
+static inline uint32 matchRow(const byte *prevRow, int xmin, int xmax, const byte *row, int w) {
+	uint32 mask = 0;
+#ifdef __SSE2__
+	const byte *p = prevRow + xmin;
+	__m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), _mm_set1_epi8((char)row[0]));
+	for (int i = 1; i < w; i++)
+		eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i)), _mm_set1_epi8((char)row[i])));
+	mask = (uint32)_mm_movemask_epi8(eq);
+#else
+	const uint32 value = readRow(row, w);
+	for (int xc = xmin; xc < xmax && xc < xmin + 16; xc++)
+		if (readRow(prevRow + xc, w) == value)
+			mask |= 1 << (xc - xmin);
+#endif
+	return mask & ((1 << (xmax - xmin)) - 1);
+}
+
+bool DxaFrameEncoder::m13motionVector(byte *frame, int x, int y, int w, int h, int &mx, int &my) {
 	int xmin = (0 > x-7) ? 0 : x-7;
 	int ymin = (0 > y-7) ? 0 : y-7;
 	int xmax = (_width < x+8) ? _width : x+8;
-	int ymax = (_workheight < y+8) ? _height : y+8;
+	// the candidate blocks must not go past the bottom of the frame
+	int ymax = (_workheight - h + 1 < y+8) ? _workheight - h + 1 : y+8;
+	const byte *b2 = frame + x + y * _width;
+
+	// try the candidates in the same order as a plain scan over the window,
+	// but only those whose first row already matches
 	for (int yc = ymin; yc < ymax; yc++) {
-		for (int xc = xmin; xc < xmax; xc++) {
-			if (m13blocksAreEqual(frame, xc, yc, x, y, w, h)) {
+		const byte *prevRow = _prevframe + yc * _width;
+		uint32 mask = matchRow(prevRow, xmin, xmax, b2, w);
+		for (int xc = xmin; mask; xc++, mask >>= 1) {
+			if ((mask & 1) && m13blocksAreEqual(frame, xc, yc, x, y, w, h)) {
 				mx = xc - x;
 				my = yc - y;
 				return true;
@@ -301,20 +472,18 @@ bool DxaEncoder::m13motionVector(byte *frame, int x, int y, int w, int h, int &m
 	return false;
 }
 
-int DxaEncoder::m13countColors(byte *block, byte *pixels, unsigned long &code, int &codeSize) {
+int DxaFrameEncoder::m13countColors(byte *block, byte *pixels, unsigned long &code, int &codeSize) {
 
 	code = 0;
 	codeSize = 0;
 
-	/* count the number of colors used in this block */
+	/* count the number of colors used in this block; _colTab is all -1
+	   between calls, so only the entries used here need to be reset */
 	int count = 0;
-	int colTab[256];
-	for (int i = 0; i < 256; i++)
-		colTab[i] = -1;
 
 	for (int i = 0; i < BLOCKW * BLOCKH; i++) {
-		if (colTab[block[i]] == -1) {
-			colTab[block[i]] = count;
+		if (_colTab[block[i]] == -1) {
+			_colTab[block[i]] = count;
 			pixels[count] = block[i];
 			count++;
 		}
@@ -324,22 +493,25 @@ int DxaEncoder::m13countColors(byte *block, byte *pixels, unsigned long &code, i
 		/* set the bitmask */
 		if (count == 2) {
 			for (int i = 15; i >= 0; i--) {
-				code = (code << 1) | colTab[block[i]];
+				code = (code << 1) | _colTab[block[i]];
 			}
 			codeSize = 2;
 		} else if (count == 4 || count == 3) {
 			for (int i = 15; i >= 0; i--) {
-				code = (code << 2) | colTab[block[i]];
+				code = (code << 2) | _colTab[block[i]];
 			}
 			codeSize = 4;
 		}
 	}
 
+	for (int i = 0; i < count; i++)
+		_colTab[pixels[i]] = -1;
+
 	return count;
 }
 
 /* grab the block */
-void DxaEncoder::grabBlock(byte *frame, int x, int y, int blockw, int blockh, byte *block) {
+void DxaFrameEncoder::grabBlock(byte *frame, int x, int y, int blockw, int blockh, byte *block) {
 	byte *b2 = (byte*)frame + x + y * _width;
 	for (int yc = 0; yc < blockh; yc++) {
 		memcpy(&block[yc*blockw], b2, blockw);
@@ -347,7 +519,7 @@ void DxaEncoder::grabBlock(byte *frame, int x, int y, int blockw, int blockh, by
 	}
 }
 
-uLong DxaEncoder::m13encode(byte *frame, byte *outbuf) {
+uLong DxaFrameEncoder::m13encode(byte *frame, byte *outbuf) {
 
 	byte *codeB = _codeBuf;
 	byte *dataB = _dataBuf;
@@ -359,11 +531,6 @@ uLong DxaEncoder::m13encode(byte *frame, byte *outbuf) {
 	int mx, my;
 	DiffStruct diff;
 
-	memset(_codeBuf, 0, _width * _height / 16);
-	memset(_dataBuf, 0, _width * _height);
-	memset(_motBuf, 0, _width * _height);
-	memset(_maskBuf, 0, _width * _height);
-
 	for (int by = 0; by < _workheight; by += BLOCKH) {
 		for (int bx = 0; bx < _width; bx += BLOCKW) {
 			if (m13blocksAreEqual(frame, bx, by, bx, by, BLOCKW, BLOCKH)) {
@@ -538,6 +705,117 @@ uLong DxaEncoder::m13encode(byte *frame, byte *outbuf) {
 	return outb - outbuf;
 }
 
+/* The state shared by the frame jobs of one encodeVideo() call. It is only
+ * touched in FrameJob::complete(), on the main thread. */
+struct FrameSequence {
+	Common::OrderedJobWindow *queue;
+	DxaEncoder *dxe;
+	int width, workheight;
+	int frames, framenum;
+	bool failed;
+
+	// The frame and palette decoded last, encoding the next frame needs them
+	std::vector<uint8> prevFrame, prevPalette;
+};
+
+/* Decodes a frame. Once completed, it queues a job which encodes the frame
+ * against the previous one, and which in turn writes it when completed. */
+class EncodeDXA::FrameJob : public Common::Job {
+public:
+	enum Stage {
+		kDecode,
+		kEncode
+	};
+
+	FrameJob(EncodeDXA *tool, FrameSequence &seq, const std::string &filename, ScaleMode scaleMode) :
+		_tool(tool), _seq(seq), _filename(filename), _scaleMode(scaleMode), _stage(kDecode), _result(0),
+		_frame(NULL), _palette(NULL), _prevFrame(NULL), _prevPalette(NULL), _encoder(NULL) { }
+	~FrameJob() {
+		delete[] _frame;
+		delete[] _palette;
+		delete[] _prevFrame;
+		delete[] _prevPalette;
+	}
+
+	virtual void run();
+	virtual void complete();
+
+	EncodeDXA *_tool;
+	FrameSequence &_seq;
+	std::string _filename;
+	ScaleMode _scaleMode;
+
+	Stage _stage;
+	int _result;
+	uint8 *_frame, *_palette;
+	uint8 *_prevFrame, *_prevPalette;
+	DxaFrameEncoder *_encoder;
+	Common::MemoryWriteStreamDynamic _output;
+};
+
+void EncodeDXA::FrameJob::run() {
+	if (_stage == kEncode) {
+		_encoder->encodeFrame(_prevFrame, _prevPalette, _frame, _palette, _output);
+		return;
+	}
+
+	int width, height;
+	_result = _tool->read_png_file(_filename.c_str(), _frame, _palette, width, height);
+
+	if (!_result && _scaleMode != S_NONE) {
+		byte *unscaledImage = new byte[width * height / 2];
+
+		for (int y = 0; y < height; y += 2)
+			memcpy(&unscaledImage[(width*y)/2], &_frame[width*y], width);
+
+		delete[] _frame;
+		_frame = unscaledImage;
+	}
+}
+
+void EncodeDXA::FrameJob::complete() {
+	if (_stage == kEncode) {
+		_seq.dxe->writeFrame(_output.getData(), _output.size());
+		_seq.framenum++;
+
+		if (_seq.framenum % 20 == 0) {
+			_tool->print("Encoding video...%d%% (%d of %d)", 100 * _seq.framenum / _seq.frames, _seq.framenum, _seq.frames);
+		}
+		return;
+	}
+
+	// The video ends at the first frame which can't be read
+	if (_seq.failed || _result) {
+		if (_result == 2)
+			_tool->error("8-bit 256-color image expected");
+		_seq.failed = true;
+		return;
+	}
+
+	int size = _seq.width * _seq.workheight;
+	FrameJob *job = new FrameJob(_tool, _seq, _filename, _scaleMode);
+	job->_stage = kEncode;
+	job->_frame = _frame;
+	job->_palette = _palette;
+	_frame = NULL;
+	_palette = NULL;
+
+	if (!_seq.prevFrame.empty()) {
+		job->_prevFrame = new uint8[size + FRAME_PADDING];
+		memcpy(job->_prevFrame, &_seq.prevFrame[0], size);
+		memset(job->_prevFrame + size, 0, FRAME_PADDING);
+		job->_prevPalette = new uint8[768];
+		memcpy(job->_prevPalette, &_seq.prevPalette[0], 768);
+	}
+	_seq.prevFrame.assign(job->_frame, job->_frame + size);
+	_seq.prevPalette.assign(job->_palette, job->_palette + 768);
+
+	// This job has left the window, so there is room for the next one right
+	// away, and the slot is not taken by another job before it is pushed
+	job->_encoder = _seq.dxe->getFrameEncoder(_seq.queue->getNextSlot());
+	_seq.queue->push(job);
+}
+
 EncodeDXA::EncodeDXA(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 
 	ToolInput input;
@@ -546,8 +824,37 @@ EncodeDXA::EncodeDXA(const std::string &name) : CompressionTool(name, TOOLTYPE_C
 
 	_shorthelp = "Used to create DXA files from extracted Smacker archives.";
 	_helptext =
-		"Usage: " + getName() + " [mode] [mode-params] [-o outpufile = inputfile.san] <inputfile>\n" +
-		"Output will be two files, one with .dxa extension and the other depending on the used audio codec.";
+		"Usage: " + getName() + " [mode] [mode-params] [-o outpufile = inputfile.san] [--jobs <n>] [--speed <n>] [--report] <inputfile>\n" +
+		"Output will be two files, one with .dxa extension and the other depending on the used audio codec.\n" +
+		"<--jobs <n>> decodes and encodes <n> frames at the same time (default:1)\n" +
+		"<--speed <n>> trades size for speed: 0 is the smallest and slowest (default), 2 the fastest\n" +
+		"<--report> encodes the video at every speed and shows the size and time each one takes";
+
+	_speed = 0;
+	_report = false;
+}
+
+void EncodeDXA::parseExtraArguments() {
+	while (!_arguments.empty()) {
+		if (_arguments.front() == "--jobs") {
+			_arguments.pop_front();
+			if (_arguments.empty())
+				error("Could not parse command line options, expected value after --jobs");
+			setNumJobs(_arguments.front());
+		} else if (_arguments.front() == "--speed") {
+			_arguments.pop_front();
+			if (_arguments.empty())
+				error("Could not parse command line options, expected value after --speed");
+			_speed = atoi(_arguments.front().c_str());
+			if (_speed < 0 || _speed > 2 || (_speed == 0 && _arguments.front() != "0"))
+				error("Speed (--speed) must be 0, 1 or 2");
+		} else if (_arguments.front() == "--report") {
+			_report = true;
+		} else {
+			break;
+		}
+		_arguments.pop_front();
+	}
 }
 
 void EncodeDXA::execute() {
@@ -575,70 +882,77 @@ void EncodeDXA::execute() {
 	print("Width = %d, Height = %d, Framerate = %d, Frames = %d",
 		   width, height, framerate, frames);
 
-	// create the encoder object
 	outpath.setExtension(".dxa");
-	DxaEncoder dxe(*this, outpath, width, height, framerate, scaleMode);
+
+	if (!_report) {
+		encodeVideo(inpath, outpath, width, height, framerate, frames, scaleMode, _speed);
+		return;
+	}
+
+	// Encode at every speed, the one asked for last, so that it is the one left in the output file
+	uint32 sizes[3], times[3];
+	for (int i = 1; i <= 3; i++) {
+		int speed = (_speed + i) % 3;
+		print("Encoding at speed %d", speed);
+
+		uint32 start = Common::getMillis();
+		encodeVideo(inpath, outpath, width, height, framerate, frames, scaleMode, speed);
+		times[speed] = Common::getMillis() - start;
+		sizes[speed] = Common::File(outpath, "rb").size();
+	}
+
+	print("Speed 0: %u bytes, %u ms", sizes[0], times[0]);
+	for (int speed = 1; speed < 3; speed++) {
+		print("Speed %d: %u bytes (%+.1f%%), %u ms (%.0f%% of speed 0)", speed, sizes[speed],
+			100.0 * ((double)sizes[speed] - sizes[0]) / sizes[0], times[speed],
+			times[0] ? 100.0 * times[speed] / times[0] : 100.0);
+	}
+}
+
+/* encode the frames into outpath at the given speed, see DxaFrameEncoder */
+void EncodeDXA::encodeVideo(Common::Filename inpath, const Common::Filename &outpath, int width, int height, int framerate, int frames, ScaleMode scaleMode, int speed) {
+	// create the encoder object, it has a frame encoder for every frame in flight
+	DxaEncoder dxe(*this, outpath, width, height, framerate, scaleMode, speed);
 
 	// No sound block
 	dxe.writeNULL();
 
-	uint8 *image = NULL;
-	uint8 *palette = NULL;
-
 	char fullname[1024];
 	strcpy(fullname, inpath.getFullPath().c_str());
 
 	// Check starting frame (binkconv starts at 0, ffmpeg starts at 1)
 	int framenum = 0;
 	char strbuf[1024];
-	sprintf(strbuf, "%s%04d.png", fullname, framenum);
+	snprintf(strbuf, sizeof(strbuf), "%s%04d.png", fullname, framenum);
 	if (!Common::Filename(strbuf).exists())
 		framenum++;
 
+	// Frames are decoded and encoded on a job queue, but written in order
+	FrameSequence seq;
+	Common::OrderedJobWindow queue(_numJobs);
+	seq.queue = &queue;
+	seq.dxe = &dxe;
+	seq.width = width;
+	seq.workheight = scaleMode == S_NONE ? height : height / 2;
+	seq.frames = frames;
+	seq.framenum = framenum;
+	seq.failed = false;
+
 	print("Encoding video...");
-	for (int f = 0; f < frames; f++) {
+	for (int f = framenum; f < framenum + frames && !seq.failed; f++) {
 		if (frames > 999)
-			sprintf(strbuf, "%s%04d.png", fullname, framenum);
+			snprintf(strbuf, sizeof(strbuf), "%s%04d.png", fullname, f);
 		else if (frames > 99)
-			sprintf(strbuf, "%s%03d.png", fullname, framenum);
+			snprintf(strbuf, sizeof(strbuf), "%s%03d.png", fullname, f);
 		else if (frames > 9)
-			sprintf(strbuf, "%s%02d.png", fullname, framenum);
+			snprintf(strbuf, sizeof(strbuf), "%s%02d.png", fullname, f);
 		else
-			sprintf(strbuf, "%s%d.png", fullname, framenum);
+			snprintf(strbuf, sizeof(strbuf), "%s%d.png", fullname, f);
 		inpath.setFullName(strbuf);
 
-		int r = read_png_file(inpath.getFullPath().c_str(), image, palette, width, height);
-
-		if (!palette) {
-			error("8-bit 256-color image expected");
-		}
-
-		if (!r) {
-			if (scaleMode != S_NONE) {
-				byte *unscaledImage = new byte[width * height / 2];
-
-				for (int y = 0; y < height; y += 2)
-					memcpy(&unscaledImage[(width*y)/2], &image[width*y], width);
-
-				dxe.writeFrame(unscaledImage, palette);
-				delete[] unscaledImage;
-			} else {
-				dxe.writeFrame(image, palette);
-			}
-		}
-
-		delete[] image;
-		delete[] palette;
-
-		if (r)
-			break;
-
-		framenum++;
-
-		if (framenum % 20 == 0) {
-			print("Encoding video...%d%% (%d of %d)", 100 * framenum / frames, framenum, frames);
-		}
+		queue.push(new FrameJob(this, seq, inpath.getFullPath(), scaleMode));
 	}
+	queue.completeAll();
 
 	print("Encoding video...100%% (%d of %d)", frames, frames);
 }
@@ -41,6 +41,14 @@ public:
 
 
 protected:
+	class FrameJob;
+
+	int _speed;
+	bool _report;
+
+	virtual void parseExtraArguments();
+
+	void encodeVideo(Common::Filename inpath, const Common::Filename &outpath, int width, int height, int framerate, int frames, ScaleMode scaleMode, int speed);
 
 	void convertWAV(const Common::Filename *inpath, const Common::Filename* outpath);
 	void readVideoInfo(Common::Filename *filename, int &width, int &height, int &framerate, int &frames, ScaleMode &scaleMode);
@@ -28,6 +28,31 @@
 #define TEMP_DAT	"tempfile.dat"
 #define TEMP_IDX	"tempfile.idx"
 
+/**
+ * A sound, and optionally the index entry following it. Index entries hold
+ * the end offset of the sound data, so both are written once the sound has
+ * been encoded. Jobs without a sound only write the index entry.
+ */
+class AgosSoundJob : public EncodeJob {
+public:
+	AgosSoundJob(Common::File &idx, Common::File &snd, uint32 &size, bool writeIndex) :
+		_idx(idx), _snd(snd), _size(size), _writeIndex(writeIndex) {}
+
+	virtual void finish(const byte *encoded, uint32 size) {
+		/* Append the converted data to the master output file */
+		_snd.write(encoded, size);
+		_size += size;
+
+		if (_writeIndex)
+			_idx.writeUint32LE(_size);
+	}
+
+private:
+	Common::File &_idx, &_snd;
+	uint32 &_size;
+	bool _writeIndex;
+};
+
 CompressAgos::CompressAgos(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	_convertMac = false;
 	_outputToDirectory = false;
@@ -37,14 +62,18 @@ CompressAgos::CompressAgos(const std::string &name) : CompressionTool(name, TOOL
 	input.format = "*.*";
 	_inputPaths.push_back(input);
 
+	_supportsParallelEncoding = true;
+
 	_shorthelp = "Compresses Simon the Sorcerer and Feeble Files data files.";
-	_helptext = "\nUsage: " + getName() + " [mode params] [-o outfile] [--mac] <infile>\n";
+	_helptext = "\nUsage: " + getName() + " [mode params] [--jobs <n>] [-o outfile] [--mac] <infile>\n";
 }
 
 void CompressAgos::end() {
 	int size;
 	char fbuf[2048];
 
+	flushEncodeQueue();
+
 	_output_idx.close();
 	_output_snd.close();
 
@@ -66,9 +95,6 @@ void CompressAgos::end() {
 	/* And some clean-up :-) */
 	Common::removeFile(TEMP_IDX);
 	Common::removeFile(TEMP_DAT);
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(tempEncoded);
-	Common::removeFile(TEMP_WAV);
 }
 
 
@@ -102,12 +128,10 @@ int CompressAgos::get_offsets_mac(size_t maxcount, uint32 filenums[], uint32 off
 }
 
 
-uint32 CompressAgos::get_sound(uint32 offset) {
-	uint32 tot_size;
-	char outname[256];
-	int size;
-	char fbuf[2048];
+void CompressAgos::get_sound(uint32 offset, EncodeJob *job) {
 	char buf[8];
+	char *rawData;
+	int length, samplerate;
 
 	_input.seek(offset, SEEK_SET);
 
@@ -115,29 +139,34 @@ uint32 CompressAgos::get_sound(uint32 offset) {
 	if (!memcmp(buf, "Creative", 8)) {
 		print("VOC found (pos = %d) :", offset);
 		_input.seek(18, SEEK_CUR);
-		extractAndEncodeVOC(TEMP_RAW, _input, _format);
+		rawData = extractVOC(_input, length, samplerate);
 	} else if (!memcmp(buf, "RIFF", 4)) {
 		print("WAV found (pos = %d) :", offset);
-		extractAndEncodeWAV(TEMP_WAV, _input, _format);
+		rawData = extractWAV(_input, length, samplerate);
 	} else {
 		error("Unexpected data at offset: %d", offset);
 	}
 
-	/* Append the converted data to the master output file */
-	sprintf(outname, "%s", tempEncoded);
-	Common::File f(outname, "rb");
-	tot_size = 0;
-	while ((size = f.read_noThrow(fbuf, 2048)) > 0) {
-		tot_size += size;
-		_output_snd.write(fbuf, size);
+	job->setRawData(rawData, length, samplerate);
+}
+
+void CompressAgos::queue_sound(bool hasSound, uint32 offset, bool writeIndex) {
+	AgosSoundJob *job = new AgosSoundJob(_output_idx, _output_snd, _size, writeIndex);
+
+	if (hasSound) {
+		try {
+			get_sound(offset, job);
+		} catch (...) {
+			delete job;
+			throw;
+		}
 	}
 
-	return(tot_size);
+	queueEncode(job);
 }
 
-
 void CompressAgos::convert_pc(Common::Filename* inputPath) {
-	int i, size, num;
+	int i, num;
 	uint32 filenums[32768];
 	uint32 offsets[32768];
 
@@ -151,28 +180,25 @@ void CompressAgos::convert_pc(Common::Filename* inputPath) {
 	if (!num) {
 		error("This does not seem to be a valid file");
 	}
-	size = num * 4;
+	_size = num * 4;
 
 	_output_idx.writeUint32LE(0);
-	_output_idx.writeUint32LE(size);
+	_output_idx.writeUint32LE(_size);
 
 	for (i = 1; i < num; i++) {
 		updateProgress(i, num);
 
 		if (offsets[i] == offsets[i + 1]) {
-			_output_idx.writeUint32LE(size);
+			queue_sound(false, 0, true);
 			continue;
 		}
 
-		if (offsets[i] != 0)
-			size += get_sound(offsets[i]);
-		if (i < num - 1)
-			_output_idx.writeUint32LE(size);
+		queue_sound(offsets[i] != 0, offsets[i], i < num - 1);
 	}
 }
 
 void CompressAgos::convert_mac(Common::Filename *inputPath) {
-	int i, size, num;
+	int i, num;
 	uint32 filenums[32768];
 	uint32 offsets[32768];
 
@@ -187,16 +213,16 @@ void CompressAgos::convert_mac(Common::Filename *inputPath) {
 	if (!num) {
 		error("This does not seem to be a valid file");
 	}
-	size = num * 4;
+	_size = num * 4;
 
 	_output_idx.writeUint32LE(0);
-	_output_idx.writeUint32LE(size);
+	_output_idx.writeUint32LE(_size);
 
 	for (i = 1; i < num; i++) {
 		updateProgress(i, num);
 
 		if (filenums[i] == filenums[i + 1] && offsets[i] == offsets[i + 1]) {
-			_output_idx.writeUint32LE(size);
+			queue_sound(false, 0, true);
 			continue;
 		}
 
@@ -208,11 +234,7 @@ void CompressAgos::convert_mac(Common::Filename *inputPath) {
 			_input.open(*inputPath, "rb");
 		}
 
-		size += get_sound(offsets[i]);
-
-		if (i < num - 1) {
-			_output_idx.writeUint32LE(size);
-		}
+		queue_sound(true, offsets[i], i < num - 1);
 	}
 }
 
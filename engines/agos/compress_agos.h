@@ -37,11 +37,14 @@ protected:
 	void parseExtraArguments();
 
 	Common::File _input, _output_idx, _output_snd;
+	/** End offset of the sound data written so far, relative to the start of the index. */
+	uint32 _size;
 
 	void end();
 	int get_offsets(size_t maxcount, uint32 filenums[], uint32 offsets[]);
 	int get_offsets_mac(size_t maxcount, uint32 filenums[], uint32 offsets[]);
-	uint32 get_sound(uint32 offset);
+	void get_sound(uint32 offset, EncodeJob *job);
+	void queue_sound(bool hasSound, uint32 offset, bool writeIndex);
 	void convert_pc(Common::Filename* inputPath);
 	void convert_mac(Common::Filename *inputPath);
 };
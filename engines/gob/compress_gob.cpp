@@ -20,21 +20,240 @@
  *
  */
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <map>
 
 #include "compress_gob.h"
+#include "common/endian.h"
+#include "common/md5.h"
+#include "common/util.h"
+
+#define indexSignature "STKINDEX2"
+
+// A chunk of an existing archive, as found in its header
+struct ArchiveEntry {
+	uint32 size, offset;
+	uint8 packed;
+};
 
 struct CompressGob::Chunk {
 	char name[64];
 	uint32 size, realSize, offset;
 	uint8 packed;
+	bool pack;           // Compression requested by the conf file
+	uint8 digest[16];    // MD5 of the file
+	byte *reused;        // Unchanged chunk taken from the previous archive, if any
+	uint32 reusedSize;
+	uint8 reusedPacked;
 	Chunk *replChunk;
 	Chunk *next;
 
-	Chunk() : next(0) { }
-	~Chunk() { delete next; }
+	Chunk() : reused(0), next(0) { }
+	~Chunk() { free(reused); delete next; }
 };
 
+/* The 4 KB ring buffer of the STK packer. Every position is chained into a
+ * hash bucket according to the three bytes starting there, so that a match
+ * search only has to look at the positions that can possibly match. */
+struct CompressGob::Dictionary {
+	enum {
+		kSize = 4096,
+		kNone = 0xFFFF
+	};
+
+	byte data[kSize];
+	bool filled[kSize];
+	uint16 hash[kSize];
+	uint16 head[kSize];
+	uint16 next[kSize];
+	uint16 prev[kSize];
+
+	Dictionary();
+
+	void write(uint16 index, const byte *src, uint32 count);
+	uint8 findMatch(const byte *src, int32 counter, uint16 currIndex, uint16 &pos) const;
+
+private:
+	static uint16 hashBytes(byte b0, byte b1, byte b2) {
+		return (uint16)((((b0 << 16) | (b1 << 8) | b2) * 2654435761U) >> 20);
+	}
+
+	void unlink(uint16 index);
+	void link(uint16 index);
+};
+
+CompressGob::Dictionary::Dictionary() {
+	memset(data, 0x20, kSize);
+	memset(head, 0xFF, sizeof(head));
+
+	// The unpacker only initializes the dictionary up to the first write
+	// position, the rest is filled with the beginning of the file.
+	for (int i = 0; i < kSize; i++) {
+		filled[i] = (i < 4078);
+		link(i);
+	}
+}
+
+void CompressGob::Dictionary::unlink(uint16 index) {
+	if (prev[index] == kNone)
+		head[hash[index]] = next[index];
+	else
+		next[prev[index]] = next[index];
+	if (next[index] != kNone)
+		prev[next[index]] = prev[index];
+}
+
+void CompressGob::Dictionary::link(uint16 index) {
+	hash[index] = hashBytes(data[index], data[(index + 1) % kSize], data[(index + 2) % kSize]);
+	prev[index] = kNone;
+	next[index] = head[hash[index]];
+	if (next[index] != kNone)
+		prev[next[index]] = index;
+	head[hash[index]] = index;
+}
+
+/*! \brief Write bytes to the dictionary
+ * \param index Position of the first byte in the dictionary
+ * \param src Bytes to be written
+ * \param count Number of bytes to be written
+ *
+ * The positions whose first three bytes changed are moved to their new hash bucket.
+ */
+void CompressGob::Dictionary::write(uint16 index, const byte *src, uint32 count) {
+	for (uint32 i = 0; i < count; i++) {
+		data[(index + i) % kSize] = src[i];
+		filled[(index + i) % kSize] = true;
+	}
+
+	uint32 rehash = MIN<uint32>(count + 2, kSize);
+	uint16 first = (index + kSize - 2) % kSize;
+	for (uint32 i = 0; i < rehash; i++) {
+		uint16 curIndex = (first + i) % kSize;
+		unlink(curIndex);
+		link(curIndex);
+	}
+}
+
+/*! \brief Search the dictionary for the longest match
+ * \param src Bytes still to be compressed
+ * \param counter Number of bytes still to be compressed
+ * \param currIndex Current 'write' position in the dictionary (used to avoid dictionary collision)
+ * \param pos Position of the longest match found, if any
+ * \return Length of the longest match, or 0 if there is none of at least three bytes
+ *
+ * The matches are the same the unpacker will see: they may start at the write position,
+ * as it is read before being overwritten, but may not run into it, nor read parts of
+ * the dictionary which have not been initialized yet.
+ */
+uint8 CompressGob::Dictionary::findMatch(const byte *src, int32 counter, uint16 currIndex, uint16 &pos) const {
+	if (counter < 3)
+		return 0;
+
+	int32 maxLength = MIN<int32>(counter, 18);
+	int32 bestLength = 2;
+
+	for (uint16 tmpPos = head[hashBytes(src[0], src[1], src[2])]; tmpPos != kNone; tmpPos = next[tmpPos]) {
+		int32 tmpLength = 0;
+		while (tmpLength < maxLength) {
+			uint16 curIndex = (tmpPos + tmpLength) % kSize;
+			if (!filled[curIndex] || (data[curIndex] != src[tmpLength]) || ((curIndex == currIndex) && (tmpLength != 0)))
+				break;
+			tmpLength++;
+		}
+
+		if (tmpLength > bestLength) {
+			pos = tmpPos;
+			if ((bestLength = tmpLength) == maxLength)
+				break;
+		}
+	}
+
+	return (bestLength > 2) ? bestLength : 0;
+}
+
+
+static void md5File(Common::File &src, uint8 digest[16]) {
+	Common::md5_context ctx;
+	byte buffer[4096];
+	uint32 count;
+
+	Common::md5_starts(&ctx);
+	src.rewind();
+	while ((count = src.read_noThrow(buffer, sizeof(buffer))) > 0)
+		Common::md5_update(&ctx, buffer, count);
+	Common::md5_finish(&ctx, digest);
+}
+
+/* Formats an MD5 as the index stores it */
+static std::string hexDigest(const uint8 digest[16]) {
+	char buffer[33];
+	for (int i = 0; i < 16; i++)
+		sprintf(buffer + 2 * i, "%02x", digest[i]);
+	return std::string(buffer, 32);
+}
+
+/* Reads the entries of an STK archive header, by name, and the MD5 of the header */
+static void readArchiveHeader(Common::File &stk, std::map<std::string, ArchiveEntry> &entries, uint8 digest[16]) {
+	Common::md5_context ctx;
+	byte buffer[22];
+
+	Common::md5_starts(&ctx);
+	stk.seek(0, SEEK_SET);
+	stk.read_throwsOnError(buffer, 2);
+	Common::md5_update(&ctx, buffer, 2);
+
+	uint16 count = READ_LE_UINT16(buffer);
+	for (uint16 i = 0; i < count; i++) {
+		ArchiveEntry entry;
+
+		stk.read_throwsOnError(buffer, 22);
+		Common::md5_update(&ctx, buffer, 22);
+		entry.size = READ_LE_UINT32(buffer + 13);
+		entry.offset = READ_LE_UINT32(buffer + 17);
+		entry.packed = buffer[21];
+
+		const byte *nameEnd = (const byte *)memchr(buffer, 0, 13);
+		entries[std::string((const char *)buffer, nameEnd ? nameEnd - buffer : 13)] = entry;
+	}
+	Common::md5_finish(&ctx, digest);
+}
+
+/* Reads a chunk and, if it is to be compressed, packs it into memory. The
+ * jobs run concurrently, the chunks are then written to the archive in order. */
+class CompressGob::PackJob : public Common::Job {
+public:
+	PackJob(CompressGob *tool, Common::File &stk, Chunk *chunk, const Common::Filename &path) :
+		_tool(tool), _stk(stk), _chunk(chunk), _path(path), _data(NULL), _size(0) { }
+	~PackJob() { free(_data); }
+
+	virtual void run();
+	virtual void complete() { _tool->writeBodyChunk(_stk, this); }
+
+	CompressGob *_tool;
+	Common::File &_stk;
+	Chunk *_chunk;
+	Common::Filename _path;
+
+	byte *_data;
+	uint32 _size;
+	Common::MemoryWriteStreamDynamic _packed;
+};
+
+void CompressGob::PackJob::run() {
+	// Duplicate files are not written at all, unchanged ones are already known
+	if ((_chunk->packed == 2) || _chunk->reused)
+		return;
+
+	Common::File src(_path, "rb");
+	_size = src.size();
+	_data = (byte *)malloc(_size);
+	src.read_throwsOnError(_data, _size);
+
+	if (_chunk->packed == 1)
+		_tool->writeBodyPackFile(_packed, _data, _size);
+}
 
 CompressGob::CompressGob(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	_execMode = MODE_NORMAL;
@@ -47,9 +266,12 @@ CompressGob::CompressGob(const std::string &name) : CompressionTool(name, TOOLTY
 
 	_shorthelp = "Compresses Gobliiins! data files.";
 	_helptext =
-		"\nUsage: " + getName() + " [-o <output path>] [-f] <conf file>\n"
+		"\nUsage: " + getName() + " [-o <output path>] [-f] [--optimal] <conf file>\n"
 		"<conf file> is a .gob file generated extract_gob_stk\n"
-		"<-f> forces compression for all files\n\n"
+		"<-f> forces compression for all files\n"
+		"<--optimal> makes the compressed files as small as possible, which is slower\n"
+		"<--jobs <n>> compresses <n> files at the same time (default:1)\n"
+		"<--incremental> reuses the compressed files of the previous archive which did not change\n\n"
 		"The stick archive (STK/ITK/LTK) will be created in the directory specified by the '-o' parameter.\n";
 }
 
@@ -58,8 +280,20 @@ CompressGob::~CompressGob() {
 }
 
 void CompressGob::parseExtraArguments() {
-	if (!_arguments.empty() && _arguments.front() == "-f") {
-		_execMode |= MODE_FORCE;
+	while (!_arguments.empty()) {
+		if (_arguments.front() == "-f")
+			_execMode |= MODE_FORCE;
+		else if (_arguments.front() == "--optimal")
+			_execMode |= MODE_OPTIMAL;
+		else if (_arguments.front() == "--incremental")
+			_execMode |= MODE_INCREMENTAL;
+		else if (_arguments.front() == "--jobs") {
+			_arguments.pop_front();
+			if (_arguments.empty())
+				error("Could not parse command line options, expected value after --jobs");
+			setNumJobs(_arguments.front());
+		} else
+			break;
 		_arguments.pop_front();
 	}
 }
@@ -84,12 +318,27 @@ void CompressGob::execute() {
 
 	_outputPath.setFullName(inpath.getFullName());
 
+	// The content index of the archive is kept next to it
+	Common::Filename indexPath(_outputPath);
+	indexPath.setFullName(inpath.getFullName() + ".idx");
+
+	if (_execMode & MODE_INCREMENTAL)
+		readPreviousArchive(_outputPath, indexPath, _chunks);
+
+	// The index describes the archive about to be overwritten, whatever the mode
+	if (indexPath.exists())
+		Common::removeFile(indexPath.getFullPath().c_str());
+
 	stk.open(_outputPath, "wb");
 
 	// Output in compressed format
 	writeEmptyHeader (stk, chunkCount);
 	writeBody(&inpath, stk, _chunks);
 	rewriteHeader(stk, chunkCount, _chunks);
+	stk.close();
+
+	if (_execMode & MODE_INCREMENTAL)
+		writeIndex(indexPath, _outputPath, _chunks);
 }
 
 /*! \brief Config file parser
@@ -102,12 +351,12 @@ void CompressGob::execute() {
  * It creates the output archive file and a list of chunks containing the file
  * and compression information.
  * In order to have a slightly better compression ration in some cases (Playtoons), it
- * also detects duplicate files.
+ * also detects duplicate files, using the MD5 of every file.
  */
 CompressGob::Chunk *CompressGob::readChunkConf(Common::File &gobConf, Common::Filename &stkName, uint16 &chunkCount) {
 	Chunk *chunks = new Chunk;
 	Chunk *curChunk = chunks;
-	Chunk *parseChunk;
+	std::map<std::string, Chunk *> digests;
 	Common::File src1;
 	Common::Filename srcName("");
 	char buffer[1024];
@@ -142,27 +391,24 @@ CompressGob::Chunk *CompressGob::readChunkConf(Common::File &gobConf, Common::Fi
 		else
 			curChunk->packed = false;
 		src1.open(srcName, "rb");
-		src1.seek(0, SEEK_END);
 // if file is too small, force 'Store' method
-		if ((curChunk->realSize = src1.pos()) < 8)
+		if ((curChunk->realSize = src1.size()) < 8)
 			curChunk->packed = 0;
+		curChunk->pack = (curChunk->packed != 0);
 
-		parseChunk = chunks;
-		while (parseChunk != curChunk) {
-			if ((parseChunk->realSize == curChunk->realSize) & (parseChunk->packed != 2)) {
-				if (strcmp(parseChunk->name, curChunk->name) == 0)
-					error("Duplicate filename found in conf file: %s", parseChunk->name);
-				srcName.setFullName(parseChunk->name);
-				if (filcmp(src1, srcName)) {
+		md5File(src1, curChunk->digest);
+		std::string digest((const char *)curChunk->digest, 16);
+
+		std::map<std::string, Chunk *>::iterator parseChunk = digests.find(digest);
+		if ((parseChunk != digests.end()) && (parseChunk->second->realSize == curChunk->realSize)) {
+			if (strcmp(parseChunk->second->name, curChunk->name) == 0)
+				error("Duplicate filename found in conf file: %s", curChunk->name);
 // If files are identical, use the same compressed chunk instead of re-compressing the same thing
-					curChunk->packed = 2;
-					curChunk->replChunk = parseChunk;
-					print("Identical files : %s %s (%d bytes)", curChunk->name, parseChunk->name, curChunk->realSize);
-					break;
-				}
-			}
-			parseChunk = parseChunk->next;
-		}
+			curChunk->packed = 2;
+			curChunk->replChunk = parseChunk->second;
+			print("Identical files : %s %s (%d bytes)", curChunk->name, parseChunk->second->name, curChunk->realSize);
+		} else
+			digests[digest] = curChunk;
 		src1.close();
 
 		gobConf.scanString(buffer);
@@ -176,6 +422,137 @@ CompressGob::Chunk *CompressGob::readChunkConf(Common::File &gobConf, Common::Fi
 	return chunks;
 }
 
+/*! \brief Take the unchanged chunks from the previous archive
+ * \param stkName STK/ITK archive file, as written by the previous run
+ * \param indexName Content index written along with it
+ * \param chunks List of chunks
+ *
+ * The index holds the MD5 of every file stored in the archive, whether
+ * compression was requested for it, and where its chunk was written. The files
+ * which are still the same get their chunk from the previous archive instead of
+ * being compressed again. The index is only used if the archive was written with
+ * the same compression method, and still has the size and header it had then.
+ * A chunk is only reused if the header still places it where the index says.
+ */
+void CompressGob::readPreviousArchive(const Common::Filename &stkName, const Common::Filename &indexName, Chunk *chunks) {
+	if (!stkName.exists() || !indexName.exists()) {
+		print("No previous archive index found, compressing all files");
+		return;
+	}
+
+	Common::File index(indexName, "r");
+	Common::File stk(stkName, "rb");
+	uint32 stkSize = stk.size();
+	char buffer[1024];
+
+	// Entries of the previous archive, by name
+	std::map<std::string, ArchiveEntry> entries;
+	uint8 headerDigest[16];
+	readArchiveHeader(stk, entries, headerDigest);
+
+	index.scanString(buffer);
+	if (strcmp(buffer, indexSignature) != 0) {
+		warning("Unknown archive index %s, compressing all files", indexName.getFullPath().c_str());
+		return;
+	}
+	index.scanString(buffer);
+	uint8 optimal = atoi(buffer);
+	index.scanString(buffer);
+	uint32 indexedSize = (uint32)strtoul(buffer, NULL, 10);
+	index.scanString(buffer);
+	if ((optimal != ((_execMode & MODE_OPTIMAL) ? 1 : 0)) || (indexedSize != stkSize) || (strcmp(buffer, hexDigest(headerDigest).c_str()) != 0)) {
+		print("Previous archive was modified or uses another compression method, compressing all files");
+		return;
+	}
+
+	// Entries of the previous archive, by content and requested compression
+	std::map<std::string, ArchiveEntry> contents;
+	index.scanString(buffer);
+	while (!index.eos()) {
+		uint8 digest[16];
+		for (int i = 0; i < 16; i++) {
+			unsigned int value = 0;
+			sscanf(buffer + 2 * i, "%2x", &value);
+			digest[i] = value;
+		}
+		std::string content((const char *)digest, 16);
+
+		index.scanString(buffer);
+		content += buffer[0];
+
+		index.scanString(buffer);
+		uint32 offset = (uint32)strtoul(buffer, NULL, 10);
+		index.scanString(buffer);
+		uint32 size = (uint32)strtoul(buffer, NULL, 10);
+
+		index.scanString(buffer);
+		std::map<std::string, ArchiveEntry>::iterator entry = entries.find(buffer);
+		if ((entry != entries.end()) && (entry->second.offset == offset) && (entry->second.size == size))
+			contents[content] = entry->second;
+
+		index.scanString(buffer);
+	}
+
+	uint16 reusedCount = 0;
+	for (Chunk *curChunk = chunks; curChunk; curChunk = curChunk->next) {
+		if (curChunk->packed == 2)
+			continue;
+
+		std::string content((const char *)curChunk->digest, 16);
+		content += curChunk->pack ? '1' : '0';
+
+		std::map<std::string, ArchiveEntry>::iterator entry = contents.find(content);
+		if (entry == contents.end())
+			continue;
+
+		const ArchiveEntry &prev = entry->second;
+		if ((prev.offset > stkSize) || (prev.size > stkSize - prev.offset))
+			continue;
+		stk.seek(prev.offset, SEEK_SET);
+		if (prev.packed == 1) {
+			if ((prev.size < 4) || (stk.readUint32LE() != curChunk->realSize))
+				continue;
+			stk.seek(prev.offset, SEEK_SET);
+		} else if ((prev.packed != 0) || (prev.size != curChunk->realSize))
+			continue;
+
+		curChunk->reused = (byte *)malloc(prev.size);
+		curChunk->reusedSize = prev.size;
+		curChunk->reusedPacked = prev.packed;
+		stk.read_throwsOnError(curChunk->reused, prev.size);
+		reusedCount++;
+	}
+
+	print("Reusing %d unchanged files from the previous archive", reusedCount);
+}
+
+/*! \brief Write the content index of the archive
+ * \param indexName Index file to be written
+ * \param stkName STK/ITK archive file, as just written
+ * \param chunks List of chunks
+ *
+ * See readPreviousArchive(). The first line holds a signature, the compression
+ * method, the size of the archive and the MD5 of its header, then every stored
+ * file gets a line with its MD5, whether compression was requested for it, the
+ * offset and size of its chunk, and its name.
+ */
+void CompressGob::writeIndex(const Common::Filename &indexName, const Common::Filename &stkName, Chunk *chunks) {
+	Common::File stk(stkName, "rb");
+	std::map<std::string, ArchiveEntry> entries;
+	uint8 headerDigest[16];
+	readArchiveHeader(stk, entries, headerDigest);
+
+	Common::File index(indexName, "w");
+
+	index.print("%s %d %u %s\n", indexSignature, (_execMode & MODE_OPTIMAL) ? 1 : 0, stk.size(), hexDigest(headerDigest).c_str());
+	for (Chunk *curChunk = chunks; curChunk; curChunk = curChunk->next) {
+		if (curChunk->packed == 2)
+			continue;
+
+		index.print("%s %d %u %u %s\n", hexDigest(curChunk->digest).c_str(), curChunk->pack ? 1 : 0, curChunk->offset, curChunk->size, curChunk->name);
+	}
+}
+
 /*! \brief Write an empty header to the STK archive
  * \param stk STK/ITK archive file
  * \param chunkCount Number of chunks to be written in the archive file
@@ -201,39 +578,54 @@ void CompressGob::writeEmptyHeader(Common::File &stk, uint16 chunkCount) {
  * (or skipping duplicate files) the files. It also updates the chunk information
  * with the size of the chunk in the archive, the compression method (if modified),
  * ...
+ * With --jobs, several files are compressed at the same time. They are still
+ * written in the order of the chunk list, so the archive is the same either way.
  */
 void CompressGob::writeBody(Common::Filename *inpath, Common::File &stk, Chunk *chunks) {
-	Chunk *curChunk = chunks;
-	Common::File src;
-	uint32 tmpSize;
+	Common::OrderedJobWindow queue(_numJobs);
 
-	while (curChunk) {
+	for (Chunk *curChunk = chunks; curChunk; curChunk = curChunk->next) {
 		inpath->setFullName(curChunk->name);
-		src.open(*inpath, "rb");
+		queue.push(new PackJob(this, stk, curChunk, *inpath));
+	}
+	queue.completeAll();
+}
 
-		if (curChunk->packed == 2)
-			print("Identical file %12s\t(compressed size %d bytes)", curChunk->name, curChunk->replChunk->size);
+/*! \brief Write a chunk prepared by a PackJob to the STK archive
+ * \param stk STK/ITK archive file
+ * \param job Finished job holding the file, and its compressed version if any
+ */
+void CompressGob::writeBodyChunk(Common::File &stk, PackJob *job) {
+	Chunk *curChunk = job->_chunk;
+
+	if (curChunk->packed == 2)
+		print("Identical file %12s\t(compressed size %d bytes)", curChunk->name, curChunk->replChunk->size);
+
+	curChunk->offset = stk.pos();
+	if (curChunk->reused) {
+		curChunk->packed = curChunk->reusedPacked;
+		curChunk->size = curChunk->reusedSize;
+		stk.write(curChunk->reused, curChunk->size);
+		print("Unchanged %12s\t%d bytes", curChunk->name, curChunk->size);
+		return;
+	}
 
-		curChunk->offset = stk.pos();
-		if (curChunk->packed == 1) {
-			curChunk->size = writeBodyPackFile(stk, src);
-			if (curChunk->size >= curChunk->realSize) {
+	if (curChunk->packed == 1) {
+		curChunk->size = job->_packed.size();
+		if (curChunk->size >= curChunk->realSize) {
 // If compressed size >= realsize, compression is useless
 // => Store instead
-				curChunk->packed = 0;
-				stk.seek(curChunk->offset, SEEK_SET);
-				src.rewind();
-			} else
-				print("Compressing %12s\t%d -> %d bytes", curChunk->name, curChunk->realSize, curChunk->size);
-
+			curChunk->packed = 0;
+		} else {
+			stk.write(job->_packed.getData(), curChunk->size);
+			print("Compressing %12s\t%d -> %d bytes", curChunk->name, curChunk->realSize, curChunk->size);
 		}
+	}
 
-		if (curChunk->packed == 0) {
-			tmpSize = 0;
-			curChunk->size = writeBodyStoreFile(stk, src);
-			print("Storing %12s\t%d bytes", curChunk->name, curChunk->size);
-		}
-		curChunk = curChunk->next;
+	if (curChunk->packed == 0) {
+		stk.write(job->_data, job->_size);
+		curChunk->size = job->_size;
+		print("Storing %12s\t%d bytes", curChunk->name, curChunk->size);
 	}
 }
 
@@ -302,52 +694,34 @@ void CompressGob::rewriteHeader(Common::File &stk, uint16 chunkCount, Chunk *chu
 	}
 }
 
-/*! \brief Stores a file in the archive file
- * \param stk STK/ITK archive file
- * \param src File to be stored
- * \return Size of the file stored
- *
- * This function stores a file in the STK archive
- */
-uint32 CompressGob::writeBodyStoreFile(Common::File &stk, Common::File &src) {
-	int count;
-	char buffer[4096];
-	uint32 tmpSize = 0;
-
-	do {
-		count = src.read_noThrow(buffer, 4096);
-		stk.write(buffer, count);
-		tmpSize += count;
-	} while (count == 4096);
-	return tmpSize;
-}
-
-/*! \brief Compress a file in the archive file
- * \param stk STK/ITK archive file
- * \param src File to be stored
+/*! \brief Compress a file
+ * \param stk Stream receiving the compressed chunk
+ * \param unpacked File to be compressed
+ * \param size Size of the file
  * \return Size of the resulting compressed chunk
  *
- * This function compress a file in the STK archive
+ * This function compress a file for the STK archive. It may be called from
+ * several threads at once.
  */
-uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
-	byte dico[4114];
+uint32 CompressGob::writeBodyPackFile(Common::MemoryWriteStreamDynamic &stk, const byte *unpacked, uint32 size) {
 	byte writeBuffer[17];
 	uint32 counter;
 	uint16 dicoIndex;
-	uint32 unpackedIndex, size;
+	uint32 unpackedIndex;
 	uint8 cmd;
 	uint8 buffIndex, cpt;
 	uint16 resultcheckpos;
 	byte resultchecklength;
+	uint16 *optimalPos = NULL;
+	uint8 *optimalLength = NULL;
 
-	size = src.size();
-
-	byte *unpacked = new byte [size + 1];
-
-	memset(dico, 0x20, 4114);
-	memset(unpacked, 0, size + 1);
+	Dictionary *dico = new Dictionary;
 
-	src.read_throwsOnError(unpacked, size);
+	if (_execMode & MODE_OPTIMAL) {
+		optimalPos = new uint16[size];
+		optimalLength = new uint8[size];
+		planOptimalParse(unpacked, size, optimalPos, optimalLength);
+	}
 
 	writeBuffer[0] = size & 0xFF;
 	writeBuffer[1] = size >> 8;
@@ -358,9 +732,7 @@ uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
 // Size is already checked : small files (less than 8 characters)
 // are not compressed, so copying the first three bytes is safe.
 	dicoIndex = 4078;
-	dico[dicoIndex] = unpacked[0];
-	dico[dicoIndex+1] = unpacked[1];
-	dico[dicoIndex+2] = unpacked[2];
+	dico->write(dicoIndex, unpacked, 3);
 	dicoIndex += 3;
 
 // writeBuffer[0] is reserved for the command byte
@@ -380,8 +752,19 @@ uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
 	resultchecklength = 0;
 
 	while (counter>0) {
-		if (!checkDico(unpacked, unpackedIndex, counter, dico, dicoIndex, resultcheckpos, resultchecklength)) {
-			dico[dicoIndex] = unpacked[unpackedIndex];
+		bool found;
+
+		if (optimalLength) {
+			resultcheckpos = optimalPos[unpackedIndex];
+			resultchecklength = optimalLength[unpackedIndex];
+			found = (resultchecklength != 0);
+		} else {
+			resultchecklength = dico->findMatch(unpacked + unpackedIndex, counter, dicoIndex, resultcheckpos);
+			found = (resultchecklength != 0);
+		}
+
+		if (!found) {
+			dico->write(dicoIndex, unpacked + unpackedIndex, 1);
 			writeBuffer[buffIndex] = unpacked[unpackedIndex];
 // set the operation bit : copy character
 			cmd |= (1 << cpt);
@@ -390,9 +773,8 @@ uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
 			buffIndex++;
 			counter--;
 		} else {
-// Copy the string in the dictionary
-			for (int i = 0; i < resultchecklength; i++)
-				dico[((dicoIndex + i) % 4096)] = dico[((resultcheckpos + i) % 4096)];
+// Copy the string in the dictionary. It matches the characters being compressed.
+			dico->write(dicoIndex, unpacked + unpackedIndex, resultchecklength);
 
 // Write the copy string command
 			writeBuffer[buffIndex] = resultcheckpos & 0xFF;
@@ -403,7 +785,6 @@ uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
 
 			unpackedIndex += resultchecklength;
 			dicoIndex = (dicoIndex + resultchecklength) % 4096;
-			resultcheckpos = (resultcheckpos + resultchecklength) % 4096;
 
 			buffIndex += 2;
 			counter -= resultchecklength;
@@ -422,92 +803,55 @@ uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
 			cpt++;
 	}
 
-	delete[] unpacked;
+	delete[] optimalPos;
+	delete[] optimalLength;
+	delete dico;
 	return size;
 }
 
-/*! \brief Compare a file to a file defined in a chunk
- * \param src1 File to be compared
- * \param compChunk Chunk containing information on second file to be compared
- * \return whether they are identical or not.
+/*! \brief Find the parse giving the smallest compressed chunk
+ * \param unpacked Buffer to be compressed
+ * \param size Size of the buffer
+ * \param pos For each position in the buffer, the position of the string to copy
+ * \param length For each position in the buffer, the length of the string to copy, or 0 to copy a character
  *
- * This function compares a file to another defined in a chunk. The file sizes
- * are already tested outside the function.
+ * The dictionary always holds the last 4096 characters of the file, whatever was
+ * chosen before, so the longest match at every position is known in advance.
+ * From the end of the file backwards, each position then gets the choice which
+ * minimizes the number of bits needed for the rest of the file: 9 for a character,
+ * 17 for a string (plus its operation bit). As the command bytes only hold these
+ * operation bits, this is also the smallest size in bytes.
  */
-bool CompressGob::filcmp(Common::File &src1, Common::Filename &stkName) {
-	uint16 readCount;
-	bool checkFl = true;
-	char buf1[4096];
-	char buf2[4096];
-	Common::File src2;
-
-	src1.rewind();
-	src2.open(stkName.getFullPath(), "rb");
-
-	do {
-		readCount = src1.read_noThrow(buf1, 4096);
-		src2.read_noThrow(buf2, 4096);
-		for (int i = 0; checkFl & (i < readCount); i++)
-			if (buf1[i] != buf2[i])
-				checkFl = false;
-	} while (checkFl & (readCount == 4096));
-
-	src1.rewind();
-	src2.rewind();
-	return checkFl;
-}
+void CompressGob::planOptimalParse(const byte *unpacked, uint32 size, uint16 *pos, uint8 *length) {
+	Dictionary *dico = new Dictionary;
+	uint16 dicoIndex = 4078;
+	uint32 i;
 
-/*! \brief Compare a file to a file defined in a chunk
- * \param unpacked Buffer being compressed
- * \param unpackedIndex Current 'read' position in this buffer
- * \param counter Number of bytes still to be compressed in the file
- * \param dico Dictionary
- * \param currIndex Current 'write' position in the dictionary (used to avoid dictionary collision)
- * \param pos Position of the better match found, if any
- * \param length Length of the better match found, if any
- * \return whether a match has been found or not or not.
- *
- * This function search in the dictionary for matches with the characters still to be compressed.
- * 'A match' is when at least three characters of the buffer (comparing from the current 'read' position)
- * are found in the dictionary. The match lengths are limited to 18 characters, as the
- * length (minus 3) is stored on 4 bits.
- */
-bool CompressGob::checkDico(byte *unpacked, uint32 unpackedIndex, int32 counter, byte *dico, uint16 currIndex, uint16 &pos, uint8 &length) {
-	uint16 tmpPos, bestPos;
-	uint8 tmpLength, bestLength, i;
-
-	bestPos = 0;
-	bestLength = 2;
+	dico->write(dicoIndex, unpacked, 3);
+	dicoIndex += 3;
 
-	if (counter < 3)
-		return false;
-
-	for (tmpPos = 0; tmpPos < 0x1000; tmpPos++) {
-		tmpLength = 0;
-		for (i = 0; ((i < 18) & (i < counter)); i++)
-			if ((unpacked[unpackedIndex + i] == dico[(tmpPos + i) % 4096]) &
-				// avoid dictionary collision
-				(((tmpPos + i) % 4096 != currIndex) | (i == 0)))
-				tmpLength++;
-			else
-				break;
-		if (tmpLength > bestLength)
-		{
-			bestPos = tmpPos;
-			if ((bestLength = tmpLength) == 18)
-				break;
-		}
+	for (i = 3; i < size; i++) {
+		length[i] = dico->findMatch(unpacked + i, size - i, dicoIndex, pos[i]);
+		dico->write(dicoIndex, unpacked + i, 1);
+		dicoIndex = (dicoIndex + 1) % 4096;
 	}
-
-	pos = bestPos;
-	length = bestLength;
-
-	if (bestLength > 2)
-		return true;
-	else {
-		length = 0;
-		return false;
+	delete dico;
+
+	uint32 *cost = new uint32[size + 1];
+	cost[size] = 0;
+	for (i = size; i-- > 3; ) {
+		uint8 maxLength = length[i];
+
+		cost[i] = cost[i + 1] + 9;
+		length[i] = 0;
+		for (uint8 tmpLength = 3; tmpLength <= maxLength; tmpLength++) {
+			if (cost[i + tmpLength] + 17 < cost[i]) {
+				cost[i] = cost[i + tmpLength] + 17;
+				length[i] = tmpLength;
+			}
+		}
 	}
+	delete[] cost;
 }
 
 #ifdef STANDALONE_MAIN
@@ -32,7 +32,9 @@ enum {
 	MODE_NORMAL = 0,
 	MODE_HELP   = 1,
 	MODE_FORCE  = 2,
-	MODE_SET    = 4
+	MODE_SET    = 4,
+	MODE_OPTIMAL = 8,
+	MODE_INCREMENTAL = 16
 };
 
 class CompressGob : public CompressionTool {
@@ -44,6 +46,8 @@ public:
 
 protected:
 	struct Chunk;
+	struct Dictionary;
+	class PackJob;
 
 	uint8 _execMode;
 	Chunk *_chunks;
@@ -51,13 +55,14 @@ protected:
 	void parseExtraArguments();
 
 	Chunk *readChunkConf(Common::File &gobconf, Common::Filename &stkName, uint16 &chunkCount);
+	void readPreviousArchive(const Common::Filename &stkName, const Common::Filename &indexName, Chunk *chunks);
+	void writeIndex(const Common::Filename &indexName, const Common::Filename &stkName, Chunk *chunks);
 	void writeEmptyHeader(Common::File &stk, uint16 chunkCount);
 	void writeBody(Common::Filename *inpath, Common::File &stk, Chunk *chunks);
-	uint32 writeBodyStoreFile(Common::File &stk, Common::File &src);
-	uint32 writeBodyPackFile(Common::File &stk, Common::File &src);
+	void writeBodyChunk(Common::File &stk, PackJob *job);
+	uint32 writeBodyPackFile(Common::MemoryWriteStreamDynamic &stk, const byte *unpacked, uint32 size);
+	void planOptimalParse(const byte *unpacked, uint32 size, uint16 *pos, uint8 *length);
 	void rewriteHeader(Common::File &stk, uint16 chunkCount, Chunk *chunks);
-	bool filcmp(Common::File &src1, Common::Filename &stkName);
-	bool checkDico(byte *unpacked, uint32 unpackedIndex, int32 counter, byte *dico, uint16 currIndex, uint16 &pos, uint8 &length);
 
 };
 
@@ -268,11 +268,7 @@ void ExtractGobStk::extractChunks(Common::Filename &outpath, Common::File &stk)
 		Common::File chunkFile(outpath, "wb");
 
 		if (curChunk->size > 0) {
-			stk.seek(curChunk->offset, SEEK_SET);
-
-			byte *data = new byte[curChunk->size];
-
-			stk.read_throwsOnError(data, curChunk->size);
+			const byte *data = stk.view(curChunk->offset, curChunk->size);
 
 			try {
 				if (curChunk->packed) {
@@ -291,18 +287,16 @@ void ExtractGobStk::extractChunks(Common::Filename &outpath, Common::File &stk)
 					chunkFile.write(data, curChunk->size);
 				}
 			} catch(...) {
-				delete[] data;
 				delete[] unpackedData;
 				throw;
 			}
-			delete[] data;
 		}
 		curChunk = curChunk->next;
 	}
 }
 
 // Some LZ77-variant
-byte *ExtractGobStk::unpackData(byte *src, uint32 &size) {
+byte *ExtractGobStk::unpackData(const byte *src, uint32 &size) {
 	uint32 counter;
 	uint16 cmd;
 	byte tmpBuf[4114];
@@ -360,7 +354,7 @@ byte *ExtractGobStk::unpackData(byte *src, uint32 &size) {
 }
 
 // Some LZ77-variant
-byte *ExtractGobStk::unpackPreGobData(byte *src, uint32 &size, uint32 &compSize) {
+byte *ExtractGobStk::unpackPreGobData(const byte *src, uint32 &size, uint32 &compSize) {
 	uint16 cmd;
 	byte tmpBuf[4114];
 	int16 off;
@@ -39,8 +39,8 @@ protected:
 	void readChunkList(Common::File &stk, Common::File &gobConf);
 	void readChunkListV2(Common::File &stk, Common::File &gobConf);
 	void extractChunks(Common::Filename &outpath, Common::File &stk);
-	byte *unpackData(byte *src, uint32 &size);
-	byte *unpackPreGobData(byte *src, uint32 &size, uint32 &compSize);
+	byte *unpackData(const byte *src, uint32 &size);
+	byte *unpackPreGobData(const byte *src, uint32 &size, uint32 &compSize);
 };
 
 #endif
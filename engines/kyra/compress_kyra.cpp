@@ -30,7 +30,6 @@
 #include "compress.h"
 #include "kyra_pak.h"
 
-#define TEMPFILE "TEMP.VOC"
 
 CompressKyra::CompressKyra(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	ToolInput input;
@@ -81,22 +80,33 @@ void CompressKyra::process(Common::Filename *infile, Common::Filename *outfile)
 
 	for (; list; list = list->next) {
 		// Detect VOC file from content instead of extension. This is needed for Lands of Lore TLK files.
-		if (memcmp(list->data, "Creative Voice File", 19) != 0)
+		// Only the header is read here, the entry itself stays in the archive.
+		uint8 header[27];
+		if (list->size < sizeof(header))
 			continue;
 
-		if (list->data[26] != 1) {
+		input.readFileData(list, 0, header, sizeof(header));
+		if (memcmp(header, "Creative Voice File", 19) != 0)
+			continue;
+
+		if (header[26] != 1) {
 			warning("'%s' contains broken VOC file '%s' skipping it...", infile->getFullPath().c_str(), list->filename);
 			continue;
 		}
 
 		Common::Filename outputName;
-		input.outputFileAs(list->filename, TEMPFILE);
 		outputName._path = list->filename;
 
-		Common::File tempFile(TEMPFILE, "rb");
-		tempFile.seek(26, SEEK_CUR);
-		extractAndEncodeVOC(TEMP_RAW, tempFile, _format);
-		tempFile.close();
+		// The VOC is read straight from the archive
+		Common::SeekableReadStream *vocStream = input.createReadStream(list);
+		try {
+			vocStream->seek(26, SEEK_SET);
+			extractAndEncodeVOC(TEMP_RAW, *vocStream, _format);
+		} catch (...) {
+			delete vocStream;
+			throw;
+		}
+		delete vocStream;
 
 		std::string ext = outputName.getExtension();
 		if (!ext.compare("VOC") || !ext.compare("voc") || !ext.compare("Voc"))
@@ -106,7 +116,6 @@ void CompressKyra::process(Common::Filename *infile, Common::Filename *outfile)
 
 		output.addFile(outputName.getFullPath().c_str(), tempEncoded);
 
-		Common::removeFile(TEMPFILE);
 		Common::removeFile(TEMP_RAW);
 		Common::removeFile(tempEncoded);
 	}
@@ -52,7 +52,7 @@ public:
 	virtual bool outputFileAs(const char *file, const char *outputName);
 
 	struct FileList {
-		FileList() : filename(0), size(0), data(0), next(0) {}
+		FileList() : filename(0), size(0), data(0), offset(0), next(0) {}
 		~FileList() {
 			delete[] filename;
 			delete[] data;
@@ -90,7 +90,9 @@ public:
 
 		char *filename;
 		uint32 size;
+		// NULL while the data is only in the archive, at offset
 		uint8 *data;
+		uint32 offset;
 
 		FileList *next;
 	};
@@ -98,6 +100,12 @@ public:
 	typedef const FileList cFileList;
 
 	virtual cFileList *getFileList() const = 0;
+
+protected:
+	/** Writes the data of an entry to output; returns false if that failed */
+	virtual bool writeFileData(cFileList *entry, FILE *output) {
+		return fwrite(entry->data, 1, entry->size, output) == entry->size;
+	}
 };
 
 #endif
@@ -45,7 +45,7 @@ bool PAKFile::isPakFile(const char *filename) {
 	char lastFilenameByte = 0;
 	while (!f.eos()) {
 		// The start offset of a file should never be in the filelist
-		if (offset < f.pos() || offset > filesize) {
+		if (offset < (int32)f.pos() || offset > filesize) {
 			return false;
 		}
 
@@ -86,43 +86,34 @@ bool PAKFile::loadFile(const char *file, const bool isAmiga) {
 	delete _fileList;
 	_fileList = 0;
 
-	Common::File pakfile(file, "rb");
+	// Only the file table is read here; the data of the entries stays in the
+	// archive, which is mapped into memory, until it is asked for
+	_source.close();
+	_source.open(file, "rb");
 
-	uint32 filesize = pakfile.size();
-
-	// TODO: get rid of temp. buffer
-	uint8 *buffer = new uint8[filesize];
-	assert(buffer);
-
-	pakfile.read_throwsOnError(buffer, filesize);
-
-	const char *currentName = 0;
-
-	uint32 startoffset = _isAmiga ? READ_BE_UINT32(buffer) : READ_LE_UINT32(buffer);
+	uint32 filesize = _source.size();
+	uint32 startoffset = _isAmiga ? _source.readUint32BE() : _source.readUint32LE();
 	uint32 endoffset = 0;
-	uint8* position = buffer + 4;
 
 	while (true) {
-		uint32 strlgt = (uint32)strlen((const char*)position);
-		currentName = (const char*)position;
+		std::string currentName;
+		for (uint8 c = _source.readByte(); c != 0; c = _source.readByte())
+			currentName += (char)c;
 
-		if (!(*currentName))
+		if (currentName.empty())
 			break;
 
-		position += strlgt + 1;
-		endoffset = _isAmiga ? READ_BE_UINT32(position) : READ_LE_UINT32(position);
+		endoffset = _isAmiga ? _source.readUint32BE() : _source.readUint32LE();
 		if (endoffset > filesize) {
 			endoffset = filesize;
 		} else if (endoffset == 0) {
 			endoffset = filesize;
 		}
-		position += 4;
 
-		uint8 *data = new uint8[endoffset - startoffset];
-		assert(data);
-		memcpy(data, buffer + startoffset, endoffset - startoffset);
-		addFile(currentName, data, endoffset - startoffset);
-		data = 0;
+		if (endoffset < startoffset)
+			error("Entry '%s' in '%s' ends before it starts", currentName.c_str(), file);
+
+		addFileFromSource(currentName.c_str(), startoffset, endoffset - startoffset);
 
 		if (endoffset == filesize)
 			break;
@@ -130,11 +121,60 @@ bool PAKFile::loadFile(const char *file, const bool isAmiga) {
 		startoffset = endoffset;
 	}
 
-	delete[] buffer;
 	loadLinkEntry();
 	return true;
 }
 
+void PAKFile::clearFile() {
+	delete _fileList;
+	_fileList = 0;
+	_source.close();
+}
+
+void PAKFile::addFileFromSource(const char *name, uint32 offset, uint32 size) {
+	if ((_fileList && _fileList->findEntry(name)) || (_links && _links->findSrcEntry(name))) {
+		// Only accepted if it holds the same data, which has to be compared
+		uint8 *data = new uint8[size];
+		memcpy(data, _source.view(offset, size), size);
+		addFile(name, data, size);
+		return;
+	}
+
+	FileList *newEntry = new FileList;
+	newEntry->filename = new char[strlen(name)+1];
+	strcpy(newEntry->filename, name);
+	newEntry->size = size;
+	newEntry->offset = offset;
+
+	if (_fileList)
+		_fileList->addEntry(newEntry);
+	else
+		_fileList = newEntry;
+}
+
+void PAKFile::readFileData(cFileList *entry, uint32 offset, uint8 *buffer, uint32 size) {
+	assert(offset + size <= entry->size);
+
+	if (entry->data)
+		memcpy(buffer, entry->data + offset, size);
+	else
+		memcpy(buffer, _source.view(entry->offset + offset, size), size);
+}
+
+Common::SeekableReadStream *PAKFile::createReadStream(cFileList *entry) {
+	if (entry->data)
+		return new Common::MemoryReadStream(entry->data, entry->size);
+
+	return new Common::SeekableSubReadStream(&_source, entry->offset, entry->offset + entry->size);
+}
+
+bool PAKFile::writeFileData(cFileList *entry, FILE *output) {
+	if (entry->data)
+		return Extractor::writeFileData(entry, output);
+
+	return fwrite(_source.view(entry->offset, entry->size), 1, entry->size, output) == entry->size;
+}
+
 bool PAKFile::saveFile(const char *file) {
 	if (!_fileList)
 		return true;
@@ -161,8 +201,12 @@ bool PAKFile::saveFile(const char *file) {
 		f.writeUint32LE(curAddr);
 	f.write(zeroName, 5);
 
-	for (FileList *cur = _fileList; cur; cur = cur->next)
-		f.write(cur->data, cur->size);
+	for (FileList *cur = _fileList; cur; cur = cur->next) {
+		if (cur->data)
+			f.write(cur->data, cur->size);
+		else
+			f.write(_source.view(cur->offset, cur->size), cur->size);
+	}
 
 	return true;
 }
@@ -179,6 +223,12 @@ const uint8 *PAKFile::getFileData(const char *file, uint32 *size) {
 	if (!cur)
 		return 0;
 
+	// Entries are read from the archive the first time they are asked for
+	if (!cur->data) {
+		cur->data = new uint8[cur->size];
+		readFileData(cur, 0, cur->data, cur->size);
+	}
+
 	if (size)
 		*size = cur->size;
 	return cur->data;
@@ -322,8 +372,7 @@ void PAKFile::loadLinkEntry() {
 	delete _links; _links = 0;
 
 	if (_fileList && _fileList->findEntry("LINKLIST")) {
-		const FileList *entry = _fileList->findEntry("LINKLIST");
-		const uint8 *src = entry->data;
+		const uint8 *src = getFileData("LINKLIST", 0);
 
 		uint32 magic = READ_BE_UINT32(src); src += 4;
 		if (magic != MKID_BE('SCVM'))
@@ -461,7 +510,7 @@ bool Extractor::outputAllFiles(Common::Filename *outputPath) {
 			return false;
 		}
 		printf("Extracting file '%s'...", cur->filename);
-		if (fwrite(cur->data, 1, cur->size, file) == cur->size) {
+		if (writeFileData(cur, file)) {
 			printf("OK\n");
 		} else {
 			printf("FAILED\n");
@@ -488,7 +537,7 @@ bool Extractor::outputFileAs(const char *f, const char *fn) {
 		return false;
 	}
 	printf("Extracting file '%s' to file '%s'...", cur->filename, fn);
-	if (fwrite(cur->data, 1, cur->size, file) == cur->size) {
+	if (writeFileData(cur, file)) {
 		printf("OK\n");
 	} else {
 		printf("FAILED\n");
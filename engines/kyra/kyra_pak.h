@@ -34,11 +34,15 @@ public:
 
 	bool loadFile(const char *file, const bool isAmiga);
 	bool saveFile(const char *file);
-	void clearFile() { delete _fileList; _fileList = 0; }
+	void clearFile();
 
 	uint32 getFileSize() const { return _fileList->getTableSize()+5+4+_fileList->getFileSize(); }
 
 	const uint8 *getFileData(const char *file, uint32 *size);
+	/** Reads part of an entry, without reading all of it into memory */
+	void readFileData(cFileList *entry, uint32 offset, uint8 *buffer, uint32 size);
+	/** Returns a stream over an entry, which the caller has to delete */
+	Common::SeekableReadStream *createReadStream(cFileList *entry);
 
 	bool addFile(const char *name, const char *file);
 	bool addFile(const char *name, uint8 *data, uint32 size);
@@ -52,9 +56,17 @@ public:
 	void drawFileList();
 	bool outputAllFiles(Common::Filename *outputPath);
 	bool outputFileAs(const char *file, const char *outputName);
+
+protected:
+	bool writeFileData(cFileList *entry, FILE *output);
+
 private:
 	FileList *_fileList;
 	bool _isAmiga;
+	// The loaded archive, which holds the entries that were not read yet
+	Common::File _source;
+
+	void addFileFromSource(const char *name, uint32 offset, uint32 size);
 
 	struct LinkList {
 		LinkList() : filename(0), linksTo(0), next(0) {}
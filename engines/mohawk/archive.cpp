@@ -56,12 +56,40 @@ void MohawkArchive::close() {
 	delete _mhk; _mhk = NULL;
 	delete[] _types; _types = NULL;
 	delete[] _fileTable; _fileTable = NULL;
+	_resourceIndex.clear();
 
 	_curFile.clear();
 	_curExType = 0;
 	_curExTypeIndex = 0;
 }
 
+// Tables of the resource directory normally lie between the type table and
+// the end of the file table, which open() reads at once. Those that do not
+// are read from the archive itself.
+static Common::SeekableReadStream *getDirStream(Common::MemoryReadStream *dir, Common::SeekableReadStream *archiveDir, uint32 offset, uint32 size) {
+	if (offset <= dir->size() && size <= dir->size() - offset)
+		return dir;
+	return archiveDir;
+}
+
+template<class T>
+void MohawkArchive::indexResources(const T *types) {
+	Common::HashMap<uint32, bool> indexedTypes;
+	for (uint16 i = 0; i < _typeTable.resource_types; i++) {
+		if (indexedTypes.contains(types[i].tag))
+			continue;
+		indexedTypes[types[i].tag] = true;
+
+		for (uint16 j = 0; j < types[i].resTable.resources; j++) {
+			MohawkResourceKey key(types[i].tag, types[i].resTable.entries[j].id);
+			if (!_resourceIndex.contains(key)) {
+				ResourceLocation location = { i, j };
+				_resourceIndex[key] = location;
+			}
+		}
+	}
+}
+
 void MohawkArchive::open(Common::SeekableReadStream *stream) {
 	// Make sure no other file is open...
 	close();
@@ -92,19 +120,35 @@ void MohawkArchive::open(Common::SeekableReadStream *stream) {
 	//Resource Dir
 	/////////////////////////////////
 
-	// Type Table
+	// The resource directory runs from the type table up to the end of
+	// the file table. Read it at once, and parse it from memory.
+	_mhk->seek(_rsrc.abs_offset + _rsrc.file_table_offset);
+	uint16 fileTableAmount = _mhk->readUint32BE();
+	uint32 dirSize = _rsrc.file_table_offset + 4 + fileTableAmount * 10;
+	byte *dirData = (byte *)malloc(dirSize);
+
 	_mhk->seek(_rsrc.abs_offset);
-	_typeTable.name_offset = _mhk->readUint16BE();
-	_typeTable.resource_types = _mhk->readUint16BE();
+	if (_mhk->read(dirData, dirSize) != dirSize)
+		error("Could not read the resource directory");
+
+	Common::MemoryReadStream dir(dirData, dirSize);
+	Common::SeekableSubReadStream archiveDir(_mhk, _rsrc.abs_offset, _mhk->size());
+
+	// Type Table
+	_typeTable.name_offset = dir.readUint16BE();
+	_typeTable.resource_types = dir.readUint16BE();
+
+	Common::SeekableReadStream *typeTable = getDirStream(&dir, &archiveDir, 4, _typeTable.resource_types * 8);
+	typeTable->seek(4);
 
 	debug (0, "Name List Offset = %04x  Number of Resource Types = %04x", _typeTable.name_offset, _typeTable.resource_types);
 
 	_types = new Type[_typeTable.resource_types];
 
 	for (uint16 i = 0; i < _typeTable.resource_types; i++) {
-		_types[i].tag = _mhk->readUint32BE();
-		_types[i].resource_table_offset = _mhk->readUint16BE();
-		_types[i].name_table_offset = _mhk->readUint16BE();
+		_types[i].tag = typeTable->readUint32BE();
+		_types[i].resource_table_offset = typeTable->readUint16BE();
+		_types[i].name_table_offset = typeTable->readUint16BE();
 
 		// HACK: Zoombini's SND resource starts will a NULL.
 		if (_types[i].tag == ID_SND)
@@ -113,65 +157,82 @@ void MohawkArchive::open(Common::SeekableReadStream *stream) {
 			debug (3, "Type[%02d]: Tag = \'%s\' ResTable Offset = %04x  NameTable Offset = %04x", i, tag2str(_types[i].tag), _types[i].resource_table_offset, _types[i].name_table_offset);
 
 		//Resource Table
-		_mhk->seek(_rsrc.abs_offset + _types[i].resource_table_offset);
-		_types[i].resTable.resources = _mhk->readUint16BE();
+		Common::SeekableReadStream *table = getDirStream(&dir, &archiveDir, _types[i].resource_table_offset, 2);
+		table->seek(_types[i].resource_table_offset);
+		_types[i].resTable.resources = table->readUint16BE();
 
 		debug (3, "Resources = %04x", _types[i].resTable.resources);
 
 		_types[i].resTable.entries = new Type::ResourceTable::Entries[_types[i].resTable.resources];
 
+		table = getDirStream(&dir, &archiveDir, _types[i].resource_table_offset + 2, _types[i].resTable.resources * 4);
+		table->seek(_types[i].resource_table_offset + 2);
+
 		for (uint16 j = 0; j < _types[i].resTable.resources; j++) {
-			_types[i].resTable.entries[j].id = _mhk->readUint16BE();
-			_types[i].resTable.entries[j].index = _mhk->readUint16BE();
+			_types[i].resTable.entries[j].id = table->readUint16BE();
+			_types[i].resTable.entries[j].index = table->readUint16BE();
 
 			debug (4, "Entry[%02x]: ID = %04x (%d) Index = %04x", j, _types[i].resTable.entries[j].id, _types[i].resTable.entries[j].id, _types[i].resTable.entries[j].index);
 		}
 
 		// Name Table
-		_mhk->seek(_rsrc.abs_offset + _types[i].name_table_offset);
-		_types[i].nameTable.num = _mhk->readUint16BE();
+		table = getDirStream(&dir, &archiveDir, _types[i].name_table_offset, 2);
+		table->seek(_types[i].name_table_offset);
+		_types[i].nameTable.num = table->readUint16BE();
 
 		debug (3, "Names = %04x", _types[i].nameTable.num);
 
 		_types[i].nameTable.entries = new Type::NameTable::Entries[_types[i].nameTable.num];
 
+		table = getDirStream(&dir, &archiveDir, _types[i].name_table_offset + 2, _types[i].nameTable.num * 4);
+
 		for (uint16 j = 0; j < _types[i].nameTable.num; j++) {
-			_types[i].nameTable.entries[j].offset = _mhk->readUint16BE();
-			_types[i].nameTable.entries[j].index = _mhk->readUint16BE();
+			// Reading a name from the archive moves it, so seek to each entry
+			table->seek(_types[i].name_table_offset + 2 + j * 4);
+			_types[i].nameTable.entries[j].offset = table->readUint16BE();
+			_types[i].nameTable.entries[j].index = table->readUint16BE();
 
 			debug (4, "Entry[%02x]: Name List Offset = %04x  Index = %04x", j, _types[i].nameTable.entries[j].offset, _types[i].nameTable.entries[j].index);
 
+			if (!_types[i].nameIndex.contains(_types[i].nameTable.entries[j].index))
+				_types[i].nameIndex[_types[i].nameTable.entries[j].index] = j;
+
 			// Name List
-			uint32 pos = _mhk->pos();
-			_mhk->seek(_rsrc.abs_offset + _typeTable.name_offset + _types[i].nameTable.entries[j].offset);
-			char c = (char)_mhk->readByte();
-			while (c != 0) {
-				_types[i].nameTable.entries[j].name += c;
-				c = (char)_mhk->readByte();
+			uint32 nameOffset = _typeTable.name_offset + _types[i].nameTable.entries[j].offset;
+			const char *nameEnd = NULL;
+			if (nameOffset < dirSize)
+				nameEnd = (const char *)memchr(dirData + nameOffset, 0, dirSize - nameOffset);
+
+			if (nameEnd) {
+				_types[i].nameTable.entries[j].name = Common::String((const char *)dirData + nameOffset, nameEnd);
+			} else {
+				archiveDir.seek(nameOffset);
+				char c = (char)archiveDir.readByte();
+				while (c != 0) {
+					_types[i].nameTable.entries[j].name += c;
+					c = (char)archiveDir.readByte();
+				}
 			}
 
 			debug (3, "Name = \'%s\'", _types[i].nameTable.entries[j].name.c_str());
-
-			// Get back to next entry
-			_mhk->seek(pos);
 		}
 
 		// Return to next TypeTable entry
-		_mhk->seek(_rsrc.abs_offset + (i + 1) * 8 + 4);
+		typeTable->seek((i + 1) * 8 + 4);
 
 		debug (3, "\n");
 	}
 
-	_mhk->seek(_rsrc.abs_offset + _rsrc.file_table_offset);
-	_fileTableAmount = _mhk->readUint32BE();
+	dir.seek(_rsrc.file_table_offset);
+	_fileTableAmount = dir.readUint32BE();
 	_fileTable = new FileTable[_fileTableAmount];
 
 	for (uint32 i = 0; i < _fileTableAmount; i++) {
-		_fileTable[i].offset = _mhk->readUint32BE();
-		_fileTable[i].dataSize = _mhk->readUint16BE();
-		_fileTable[i].dataSize += _mhk->readByte() << 16; // Get bits 15-24 of dataSize too
-		_fileTable[i].flags = _mhk->readByte();
-		_fileTable[i].unk = _mhk->readUint16BE();
+		_fileTable[i].offset = dir.readUint32BE();
+		_fileTable[i].dataSize = dir.readUint16BE();
+		_fileTable[i].dataSize += dir.readByte() << 16; // Get bits 15-24 of dataSize too
+		_fileTable[i].flags = dir.readByte();
+		_fileTable[i].unk = dir.readUint16BE();
 
 		// Add in another 3 bits for file size from the flags.
 		// The flags are useless to us except for doing this ;)
@@ -179,34 +240,49 @@ void MohawkArchive::open(Common::SeekableReadStream *stream) {
 
 		debug (4, "File[%02x]: Offset = %08x  DataSize = %07x  Flags = %02x  Unk = %04x", i, _fileTable[i].offset, _fileTable[i].dataSize, _fileTable[i].flags, _fileTable[i].unk);
 	}
+
+	free(dirData);
+
+	indexResources(_types);
 }
 
-bool MohawkArchive::hasResource(uint32 tag, uint16 id) {
-	if (!_mhk)
+bool MohawkArchive::findResource(uint32 tag, uint16 id, uint16 &typeIndex, uint16 &idIndex) const {
+	Common::HashMap<MohawkResourceKey, ResourceLocation, MohawkResourceKey_Hash>::const_iterator location = _resourceIndex.find(MohawkResourceKey(tag, id));
+
+	if (location == _resourceIndex.end())
 		return false;
 
-	int16 typeIndex = getTypeIndex(tag);
+	typeIndex = location->_value.typeIndex;
+	idIndex = location->_value.idIndex;
+	return true;
+}
+
+Common::String MohawkArchive::getName(uint16 typeIndex, uint16 fileTableIndex) const {
+	// Name table entries refer to file table indices based off 1
+	Common::HashMap<uint16, uint16>::const_iterator name = _types[typeIndex].nameIndex.find(fileTableIndex + 1);
+
+	if (name == _types[typeIndex].nameIndex.end())
+		return "";
+
+	return _types[typeIndex].nameTable.entries[name->_value].name;
+}
 
-	if (typeIndex < 0)
+bool MohawkArchive::hasResource(uint32 tag, uint16 id) {
+	if (!_mhk)
 		return false;
 
-	return (getIdIndex(typeIndex, id) >= 0);
+	return _resourceIndex.contains(MohawkResourceKey(tag, id));
 }
 
 MohawkOutputStream MohawkArchive::getRawData(uint32 tag, uint16 id) {
-	MohawkOutputStream output = { 0, 0, 0, 0, 0, "" };
+	MohawkOutputStream output = { 0, 0, 0, 0, 0, 0, "" };
 
 	if (!_mhk)
 		return output;
 
-	int16 typeIndex = getTypeIndex(tag);
-
-	if (typeIndex < 0)
-		return output;
-
-	int16 idIndex = getIdIndex(typeIndex, id);
+	uint16 typeIndex, idIndex;
 
-	if (idIndex < 0)
+	if (!findResource(tag, id, typeIndex, idIndex))
 		return output;
 
 	// Note: the fileTableIndex is based off 1, not 0. So, subtract 1
@@ -227,19 +303,15 @@ MohawkOutputStream MohawkArchive::getRawData(uint32 tag, uint16 id) {
 	output.tag = tag;
 	output.id = id;
 	output.index = fileTableIndex;
+	output.offset = _fileTable[fileTableIndex].offset;
 	output.flags = _fileTable[fileTableIndex].flags;
-	for (uint16 i = 0; i < _types[typeIndex].nameTable.num; i++) {
-		if (_types[typeIndex].nameTable.entries[i].index == fileTableIndex+1) {
-			output.name = _types[typeIndex].nameTable.entries[i].name;
-			break;
-		}
-	}
+	output.name = getName(typeIndex, fileTableIndex);
 
 	return output;
 }
 
 MohawkOutputStream MohawkArchive::getNextFile() {
-	MohawkOutputStream output = { 0, 0, 0, 0, 0, "" };
+	MohawkOutputStream output = { 0, 0, 0, 0, 0, 0, "" };
 
 	if (_curExType >= _typeTable.resource_types) // No more!
 		return output;
@@ -268,14 +340,9 @@ MohawkOutputStream MohawkArchive::getNextFile() {
 	output.tag = _types[_curExType].tag;
 	output.id = _types[_curExType].resTable.entries[_curExTypeIndex].id;
 	output.index = fileTableIndex;
+	output.offset = _fileTable[fileTableIndex].offset;
 	output.flags = _fileTable[fileTableIndex].flags;
-
-	for (uint16 i = 0; i < _types[_curExType].nameTable.num; i++) {
-		if (_types[_curExType].nameTable.entries[i].index == fileTableIndex+1) {
-			output.name = _types[_curExType].nameTable.entries[i].name;
-			break;
-		}
-	}
+	output.name = getName(_curExType, fileTableIndex);
 
 	_curExTypeIndex++;
 	return output;
@@ -365,34 +432,31 @@ void LivingBooksArchive_v1::open(Common::SeekableReadStream *stream) {
 	} else
 		error("Could not determine type of Old Mohawk resource");
 
+	indexResources(_types);
 }
 
 MohawkOutputStream LivingBooksArchive_v1::getRawData(uint32 tag, uint16 id) {
-	MohawkOutputStream output = { 0, 0, 0, 0, 0, "" };
+	MohawkOutputStream output = { 0, 0, 0, 0, 0, 0, "" };
 
 	if (!_mhk)
 		return output;
 
-	int16 typeIndex = getTypeIndex(tag);
+	uint16 typeIndex, idIndex;
 
-	if (typeIndex < 0)
-		return output;
-
-	int16 idIndex = getIdIndex(typeIndex, id);
-
-	if (idIndex < 0)
+	if (!findResource(tag, id, typeIndex, idIndex))
 		return output;
 
 	output.stream = new Common::SeekableSubReadStream(_mhk, _types[typeIndex].resTable.entries[idIndex].offset, _types[typeIndex].resTable.entries[idIndex].offset + _types[typeIndex].resTable.entries[idIndex].size);
 	output.tag = tag;
 	output.id = id;
 	output.index = idIndex;
+	output.offset = _types[typeIndex].resTable.entries[idIndex].offset;
 
 	return output;
 }
 
 MohawkOutputStream LivingBooksArchive_v1::getNextFile() {
-	MohawkOutputStream output = { 0, 0, 0, 0, 0, "" };
+	MohawkOutputStream output = { 0, 0, 0, 0, 0, 0, "" };
 
 	if (_curExType >= _typeTable.resource_types) // No more!
 		return output;
@@ -409,6 +473,7 @@ MohawkOutputStream LivingBooksArchive_v1::getNextFile() {
 	output.tag = _types[_curExType].tag;
 	output.id = _types[_curExType].resTable.entries[_curExTypeIndex].id;
 	output.index = _curExType;
+	output.offset = _types[_curExType].resTable.entries[_curExTypeIndex].offset;
 
 	_curExTypeIndex++;
 	return output;
@@ -456,6 +521,8 @@ void CSWorldDeluxeArchive::open(Common::SeekableReadStream *stream) {
 		_mhk->seek(oldPos);
 		debug (3, "\n");
 	}
+
+	indexResources(_types);
 }
 
 MohawkArchive *MohawkArchive::createMohawkArchive(Common::SeekableReadStream *stream) {
@@ -497,8 +564,16 @@ MohawkArchive *MohawkArchive::createMohawkArchive(Common::SeekableReadStream *st
 
 	stream->seek(0);
 
-	if (mohawkArchive)
-		mohawkArchive->open(stream);
+	if (mohawkArchive) {
+		try {
+			mohawkArchive->open(stream);
+		} catch (...) {
+			// The stream stays with the caller
+			mohawkArchive->_mhk = NULL;
+			delete mohawkArchive;
+			throw;
+		}
+	}
 
 	return mohawkArchive;
 }
@@ -25,8 +25,9 @@
 
 #include "common/str.h"
 #include "common/endian.h"
+#include "common/hashmap.h"
 #include "common/util.h"
-#include "engines/mohawk/utils/stream.h"
+#include "common/stream.h"
 
 // Main FourCC's
 #define ID_MHWK MKID_BE('MHWK') // Main FourCC
@@ -125,10 +126,26 @@ struct MohawkOutputStream {
 	uint32 tag;
 	uint32 id;
 	uint32 index;
+	uint32 offset; // Of the data in the archive
 	byte flags;
 	Common::String name;
 };
 
+// Key for looking up resources by tag and id
+struct MohawkResourceKey {
+	uint32 tag;
+	uint16 id;
+
+	MohawkResourceKey() : tag(0), id(0) {}
+	MohawkResourceKey(uint32 t, uint16 i) : tag(t), id(i) {}
+
+	bool operator==(const MohawkResourceKey &key) const { return tag == key.tag && id == key.id; }
+};
+
+struct MohawkResourceKey_Hash {
+	uint operator()(const MohawkResourceKey &key) const { return key.tag ^ (key.id * 2654435761U); }
+};
+
 struct FileTable {
 	uint32 offset;
 	uint32 dataSize; // Really 27 bits
@@ -162,6 +179,9 @@ struct Type {
 			Common::String name;
 		} *entries;
 	} nameTable;
+
+	// Name table entry of each file table index (based off 1) that has a name
+	Common::HashMap<uint16, uint16> nameIndex;
 };
 
 struct TypeTable {
@@ -184,6 +204,7 @@ public:
 	virtual ~MohawkArchive() { close(); }
 
 	// Detect new/old Mohawk archive format. Return NULL if the file is neither.
+	// If reading the directory throws, the stream is left to the caller.
 	static MohawkArchive *createMohawkArchive(Common::SeekableReadStream *stream);
 
 	virtual void open(Common::SeekableReadStream *stream);
@@ -206,6 +227,23 @@ protected:
 
 	FileTable *_fileTable;
 
+	// Position of a resource in the type and resource tables
+	struct ResourceLocation {
+		uint16 typeIndex;
+		uint16 idIndex;
+	};
+
+	// Built once by open(); like a search of the tables, it only knows
+	// the first type of each tag, and the first resource of each id
+	Common::HashMap<MohawkResourceKey, ResourceLocation, MohawkResourceKey_Hash> _resourceIndex;
+
+	// Fills _resourceIndex from the type tables, old and new archives
+	// lay them out differently but share the tag and id fields
+	template<class T>
+	void indexResources(const T *types);
+
+	bool findResource(uint32 tag, uint16 id, uint16 &typeIndex, uint16 &idIndex) const;
+
 private:
 	bool _hasData;
 	uint32 _fileSize;
@@ -215,19 +253,7 @@ private:
 	uint16 _resourceTableAmount;
 	uint16 _fileTableAmount;
 
-	virtual int16 getTypeIndex(uint32 tag) {
-		for (uint16 i = 0; i < _typeTable.resource_types; i++)
-			if (_types[i].tag == tag)
-				return i;
-		return -1;	// not found
-	}
-
-	virtual int16 getIdIndex(int16 typeIndex, uint16 id) {
-		for (uint16 i = 0; i < _types[typeIndex].resTable.resources; i++)
-			if (_types[typeIndex].resTable.entries[i].id == id)
-				return i;
-		return -1;	// not found
-	}
+	Common::String getName(uint16 typeIndex, uint16 fileTableIndex) const;
 };
 
 class LivingBooksArchive_v1 : public MohawkArchive {
@@ -252,20 +278,6 @@ protected:
 			} *entries;
 		} resTable;
 	} *_types;
-
-	int16 getTypeIndex(uint32 tag) {
-		for (uint16 i = 0; i < _typeTable.resource_types; i++)
-			if (_types[i].tag == tag)
-				return i;
-		return -1;	// not found
-	}
-
-	int16 getIdIndex(int16 typeIndex, uint16 id) {
-		for (uint16 i = 0; i < _types[typeIndex].resTable.resources; i++)
-			if (_types[typeIndex].resTable.entries[i].id == id)
-				return i;
-		return -1;	// not found
-	}
 };
 
 class CSWorldDeluxeArchive : public LivingBooksArchive_v1 {
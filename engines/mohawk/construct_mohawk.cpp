@@ -76,18 +76,19 @@ uint16 _resourceTableAmount;
 uint16 _fileTableAmount;
 Common::Array<FileTable> _fileTable;
 
+// Type of each tag, and the resources added so far
+Common::HashMap<uint32, uint16> _typeIndex;
+Common::HashMap<MohawkResourceKey, bool, MohawkResourceKey_Hash> _resourceIds;
+
 int16 getTypeIndex(uint32 tag) {
-	for (uint16 i = 0; i < _typeTable.resource_types; i++)
-		if (_types[i].tag == tag)
-			return i;
-	return -1;	// not found
+	Common::HashMap<uint32, uint16>::const_iterator type = _typeIndex.find(tag);
+	if (type == _typeIndex.end())
+		return -1;	// not found
+	return type->_value;
 }
 
-int16 getIdIndex(int16 typeIndex, uint16 id) {
-	for (uint16 i = 0; i < _types[typeIndex].resTable.resources; i++)
-		if (_types[typeIndex].resTable.entries[i].id == id)
-			return i;
-	return -1;	// not found
+bool hasResourceId(uint32 tag, uint16 id) {
+	return _resourceIds.contains(MohawkResourceKey(tag, id));
 }
 
 Common::String tag2string(uint32 tag) {
@@ -165,6 +166,7 @@ void addTypeToMohawkArchive(const char *resourceTag) {
 	_rsrc.file_table_offset += 12;
 	_typeTable.name_offset += 12;
 
+	_typeIndex[newType.tag] = _typeTable.resource_types;
 	_typeTable.resource_types++;
 	_types.push_back(newType);
 
@@ -178,7 +180,7 @@ void addFileToMohawkArchive(int fileId, byte fileFlags, const char *resourceTag,
 		addTypeToMohawkArchive(resourceTag);
 		typeIndex = getTypeIndex(string2tag(resourceTag));
 	} else {
-		if (getIdIndex(typeIndex, resourceId) != -1) {
+		if (hasResourceId(string2tag(resourceTag), resourceId)) {
 			printf("Error : Duplicate Resource Type \'%s\' Id %d\n", resourceTag, resourceId);
 			return;
 		}
@@ -203,6 +205,7 @@ void addFileToMohawkArchive(int fileId, byte fileFlags, const char *resourceTag,
 
 	_types[typeIndex].resTable.resources++;
 	_types[typeIndex].resTable.entries.insert_at(j, newTypeResource);
+	_resourceIds[MohawkResourceKey(_types[typeIndex].tag, newTypeResource.id)] = true;
 
 	updateTypeTableOffsets();
 
@@ -338,7 +341,7 @@ void writeMohawkArchive(int argc, char **argv, int archiveArg, Common::File *moh
 			return;
 		}
 
-		while (resourceIn->pos() < (int)resourceIn->size()) {
+		while (resourceIn->pos() < resourceIn->size()) {
 			uint32 size = resourceIn->read_noThrow(outputBuffer, MAX_BUF_SIZE);
 			mohawkFile->write(outputBuffer, size);
 		}
@@ -22,7 +22,7 @@
 
 #include "engines/mohawk/archive.h"
 #include "common/util.h"
-#include "engines/mohawk/utils/file.h"
+#include "common/file.h"
 
 #include <assert.h>
 
@@ -199,15 +199,17 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
-	FILE *file = fopen(argv[1], "rb");
-	if (!file) {
+	Common::File *file;
+	try {
+		file = new Common::File(argv[1], "rb");
+	} catch (Common::FileException &) {
 		printf ("Could not open \'%s\'\n", argv[1]);
 		return 1;
 	}
 
 	// Open the file as a Mohawk archive
 	MohawkArchive *mohawkArchive = new MohawkArchive();
-	mohawkArchive->open(new Common::File(file));
+	mohawkArchive->open(file);
 
 	// Load in Variable/External Command Names'
 	Common::StringList exNames = getNameList(mohawkArchive, 3);
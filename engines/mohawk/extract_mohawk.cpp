@@ -21,15 +21,32 @@
  */
 
 #include "engines/mohawk/archive.h"
+#include "common/thread.h"
 #include "common/util.h"
-#include "engines/mohawk/utils/file.h"
+#include "common/file.h"
 
 #include <assert.h>
 
+#ifdef POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// copy_file_range() lets the kernel copy the data without passing it through us
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define USE_COPY_FILE_RANGE
+#endif
+#endif
+
 // Have a maximum buffer size
-#define MAX_BUF_SIZE 16384
+#define MAX_BUF_SIZE 262144
 
-static byte *outputBuffer = NULL;
+// The archive being extracted
+static Common::File *archiveFile = NULL;
+#ifdef POSIX
+// Descriptor of archiveFile, read by the dump jobs with pread()
+static int archiveFd = -1;
+#endif
 
 bool fileExists(const char *filename) {
 	FILE *outputFile = fopen(filename, "rb");
@@ -40,32 +57,141 @@ bool fileExists(const char *filename) {
 	return false;
 }
 
-void dumpRawResource(MohawkOutputStream output) {
-	// Change the extension to bin
-	output.name += ".bin";
+/**
+ * Dumps a resource straight from the archive file. With POSIX, the archive is
+ * only read with pread(), which leaves the file position alone, so several jobs
+ * can run at once, next to the main thread reading the archive. Elsewhere only
+ * one job may run at a time, on the main thread.
+ */
+class DumpJob : public Common::Job {
+public:
+	DumpJob(const MohawkOutputStream &output) :
+		_name(output.name + ".bin"), _offset(output.offset), _size(output.stream->size()), _result(kDumped) {}
+
+	virtual void run();
+
+	/* Prints what happened, on the main thread, so messages stay in order */
+	virtual void complete();
+
+private:
+	enum Result {
+		kDumped,
+		kExists,
+		kCannotOpen,
+		kCannotCopy
+	};
+
+	Common::String _name;
+	uint32 _offset;
+	uint32 _size;
+	Result _result;
+};
+
+#ifdef POSIX
+static bool copyRange(int input, uint32 offset, uint32 size, int output) {
+#ifdef USE_COPY_FILE_RANGE
+	loff_t inputOffset = offset;
+	while (size > 0) {
+		ssize_t copied = copy_file_range(input, &inputOffset, output, NULL, size, 0);
+		if (copied <= 0)
+			break; // Not supported here, copy the rest by hand
+		size -= copied;
+	}
+	offset = inputOffset;
+	if (size == 0)
+		return true;
+#endif
 
-	const char* outputCStr = output.name.c_str();
+	byte *buffer = (byte *)malloc(MIN<uint32>(size, MAX_BUF_SIZE));
+	if (!buffer)
+		return false;
 
-	printf ("Extracting \'%s\'...\n", outputCStr);
+	while (size > 0) {
+		ssize_t len = pread(input, buffer, MIN<uint32>(size, MAX_BUF_SIZE), offset);
+		if (len <= 0)
+			break;
 
-	if(fileExists(outputCStr)) {
-		printf ("File \'%s\' already exists!\n", outputCStr);
+		for (ssize_t written = 0; written < len; ) {
+			ssize_t result = write(output, buffer + written, len - written);
+			if (result < 0) {
+				free(buffer);
+				return false;
+			}
+			written += result;
+		}
+
+		offset += len;
+		size -= len;
+	}
+
+	free(buffer);
+	return size == 0;
+}
+#endif
+
+void DumpJob::run() {
+#ifdef POSIX
+	int output = open(_name.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+	if (output < 0) {
+		_result = (errno == EEXIST) ? kExists : kCannotOpen;
 		return;
 	}
-	FILE *outputFile = fopen(outputCStr, "wb");
-	if (!outputFile) {
-		printf ("Could not open file for output!\n");
+
+	if (!copyRange(archiveFd, _offset, _size, output))
+		_result = kCannotCopy;
+
+	close(output);
+#else
+	if (fileExists(_name.c_str())) {
+		_result = kExists;
+		return;
+	}
+	FILE *output = fopen(_name.c_str(), "wb");
+	if (!output) {
+		_result = kCannotOpen;
 		return;
 	}
 
-	assert(outputBuffer);
+	byte *buffer = (byte *)malloc(MAX_BUF_SIZE);
+	archiveFile->seek(_offset);
 
-	while (output.stream->pos() < output.stream->size()) {
-		uint32 size = output.stream->read(outputBuffer, MAX_BUF_SIZE);
-		fwrite(outputBuffer, 1, size, outputFile);
+	for (uint32 size = _size; size > 0; ) {
+		uint32 len = archiveFile->read(buffer, MIN<uint32>(size, MAX_BUF_SIZE));
+		if (len == 0) {
+			_result = kCannotCopy;
+			break;
+		}
+		fwrite(buffer, 1, len, output);
+		size -= len;
 	}
 
-	fclose(outputFile);
+	free(buffer);
+	fclose(output);
+#endif
+}
+
+void DumpJob::complete() {
+	printf ("Extracting \'%s\'...\n", _name.c_str());
+
+	switch (_result) {
+	case kExists:
+		printf ("File \'%s\' already exists!\n", _name.c_str());
+		break;
+	case kCannotOpen:
+		printf ("Could not open file for output!\n");
+		break;
+	case kCannotCopy:
+		printf ("Could not copy the resource!\n");
+		break;
+	default:
+		break;
+	}
+}
+
+void dumpRawResource(MohawkOutputStream output) {
+	DumpJob job(output);
+	job.run();
+	job.complete();
 }
 
 void convertSoundResource(MohawkOutputStream output) {
@@ -123,7 +249,7 @@ void convertMIDIResource(MohawkOutputStream output) {
 	fclose(outputFile);
 }
 
-void outputMohawkStream(MohawkOutputStream output, bool doConversion, bool fileTableIndex, bool fileTableFlags) {
+Common::String getOutputName(MohawkOutputStream output, bool fileTableIndex, bool fileTableFlags) {
 	// File output naming format preserves all archive information...
 	char *strBuf = (char *)malloc(256);
 	strBuf[0] = '\0';
@@ -147,7 +273,17 @@ void outputMohawkStream(MohawkOutputStream output, bool doConversion, bool fileT
 		}
 		sprintf(strBuf + strlen(strBuf), "_%s", output.name.c_str());
 	}
-	output.name = strBuf;
+	Common::String name = strBuf;
+	free(strBuf);
+	return name;
+}
+
+bool isConvertedTag(uint32 tag) {
+	return tag == ID_TWAV || tag == ID_MSND || tag == ID_SND || tag == ID_TMOV || tag == ID_TMID;
+}
+
+void outputMohawkStream(MohawkOutputStream output, bool doConversion, bool fileTableIndex, bool fileTableFlags) {
+	output.name = getOutputName(output, fileTableIndex, fileTableFlags);
 
 	if (doConversion) {
 		// Intercept the sound tags
@@ -185,6 +321,63 @@ void printUsage(const char *appName) {
 	printf("          --no-ftindex Omit File Table Index from dumped resource names\n");
 	printf("          --ftflags    Prepend File Table Flags to dumped resource names (default)\n");
 	printf("          --no-ftflags Omit File Table Flags from dumped resource names\n");
+	printf("\n");
+	printf("          --list       Only list the resources that would be dumped, with their sizes\n");
+	printf("          --jobs <n>   Dump <n> resources at the same time (default 1)\n");
+}
+
+/* Opens the archive, or says why it could not and returns NULL */
+Common::File *openArchiveFile(const char *path) {
+	try {
+		return new Common::File(path, "rb");
+	} catch (Common::FileException &) {
+		printf ("Could not open \'%s\'\n", path);
+		return NULL;
+	}
+}
+
+/* Reads the archive directory, returns NULL if the file is not a Mohawk archive */
+MohawkArchive *openMohawkArchive(Common::File *file) {
+	try {
+		return MohawkArchive::createMohawkArchive(file);
+	} catch (Common::FileException &) {
+		return NULL;
+	}
+}
+
+/* Dumps (or lists) all resources of the archive, and shows how fast that went */
+void outputAllMohawkStreams(MohawkArchive *mohawkArchive, bool doConversion, bool fileTableIndex, bool fileTableFlags, bool listOnly, int numJobs) {
+	Common::OrderedJobWindow queue(numJobs);
+	uint32 numResources = 0;
+	uint32 totalSize = 0;
+	uint32 start = Common::getMillis();
+
+	MohawkOutputStream output = mohawkArchive->getNextFile();
+	while (output.stream) {
+		numResources++;
+		totalSize += output.stream->size();
+
+		if (listOnly) {
+			output.name = getOutputName(output, fileTableIndex, fileTableFlags);
+			printf("%s %u\n", output.name.c_str(), output.stream->size());
+		} else if (doConversion && isConvertedTag(output.tag)) {
+			// Converters read through the archive stream, and print as they go
+			queue.completeAll();
+			outputMohawkStream(output, doConversion, fileTableIndex, fileTableFlags);
+		} else {
+			output.name = getOutputName(output, fileTableIndex, fileTableFlags);
+			queue.push(new DumpJob(output));
+		}
+
+		delete output.stream;
+		output = mohawkArchive->getNextFile();
+	}
+
+	queue.completeAll();
+
+	uint32 elapsed = Common::getMillis() - start;
+	printf("%s %u resources, %u bytes in %u ms (%.1f MB/s)\n", listOnly ? "Listed" : "Extracted",
+		numResources, totalSize, elapsed, elapsed ? (double)totalSize / elapsed / 1000.0 : 0.0);
 }
 
 int main(int argc, char *argv[]) {
@@ -192,6 +385,8 @@ int main(int argc, char *argv[]) {
 	bool doConversion = false;
 	bool fileTableIndex = true;
 	bool fileTableFlags = true;
+	bool listOnly = false;
+	int numJobs = 1;
 
 	int archiveArg;
 
@@ -215,7 +410,15 @@ int main(int argc, char *argv[]) {
 			fileTableFlags = false;
 		else if (current.equals("--no-ftflags"))
 			fileTableFlags = true;
-		else {
+		else if (current.equals("--list"))
+			listOnly = true;
+		else if (current.equals("--jobs") && archiveArg + 1 < argc) {
+			numJobs = atoi(argv[++archiveArg]);
+			if (numJobs < 1) {
+				printf("Number of jobs (--jobs) must be a number greater than 0\n");
+				return 1;
+			}
+		} else {
 			printf("Unknown argument : \"%s\"\n", argv[archiveArg]);
 			printUsage(argv[0]);
 			return 1;
@@ -227,49 +430,54 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
-	FILE *file = fopen(argv[archiveArg], "rb");
-	if (!file) {
-		printf ("Could not open \'%s\'\n", argv[archiveArg]);
+	Common::File *file = openArchiveFile(argv[archiveArg]);
+	if (!file)
 		return 1;
-	}
 
 	// Open the file as a Mohawk archive
-	MohawkArchive *mohawkArchive = MohawkArchive::createMohawkArchive(new Common::File(file));
+	MohawkArchive *mohawkArchive = openMohawkArchive(file);
 
 	if (!mohawkArchive) {
 		printf("\'%s\' is not a valid Mohawk archive\n", argv[archiveArg]);
-		fclose(file);
+		delete file;
 		return 1;
 	}
 
-	// Allocate a buffer for the output
-	outputBuffer = (byte *)malloc(MAX_BUF_SIZE);
+	archiveFile = file;
+#ifdef POSIX
+	archiveFd = fileno(file->getFileHandle());
+#endif
+
+#ifndef POSIX
+	// Dump jobs share the file position of the archive with the main thread
+	numJobs = 1;
+#endif
+	if (numJobs > 1 && !Common::hasThreadSupport()) {
+		printf("Built without thread support, dumping one resource at a time\n");
+		numJobs = 1;
+	}
 
-	if (argc == archiveArg - 2 - 1) {
+	if (argc == archiveArg + 2 + 1) {
 		uint32 tag = READ_BE_UINT32(argv[archiveArg + 1]);
 		uint16 id = (uint16)atoi(argv[archiveArg + 2]);
 
 		MohawkOutputStream output = mohawkArchive->getRawData(tag, id);
 
 		if (output.stream) {
-			outputMohawkStream(output, doConversion, fileTableIndex, fileTableFlags);
+			if (listOnly)
+				printf("%s %u\n", getOutputName(output, fileTableIndex, fileTableFlags).c_str(), output.stream->size());
+			else
+				outputMohawkStream(output, doConversion, fileTableIndex, fileTableFlags);
 			delete output.stream;
 		} else {
 			printf ("Could not find specified data!\n");
 		}
 	} else {
-		MohawkOutputStream output = mohawkArchive->getNextFile();
-		while (output.stream) {
-			outputMohawkStream(output, doConversion, fileTableIndex, fileTableFlags);
-			delete output.stream;
-			output = mohawkArchive->getNextFile();
-		}
+		outputAllMohawkStreams(mohawkArchive, doConversion, fileTableIndex, fileTableFlags, listOnly, numJobs);
 	}
 
 	printf("Done!\n");
-	free(outputBuffer);
 	mohawkArchive->close();
-	fclose(file);
 	delete mohawkArchive;
 	return 0;
 }
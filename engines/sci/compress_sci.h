@@ -37,6 +37,7 @@ enum SciResourceDataType {
 class CompressSci : public CompressionTool {
 public:
 	CompressSci(const std::string &name = "compress_sci");
+	~CompressSci();
 
 	virtual void execute();
 
@@ -44,6 +45,7 @@ protected:
 	SciResourceDataType detectData(byte *header, bool compressMode);
 	void compressData(SciResourceDataType dataType);
 	uint parseRawAudioMap();
+	byte *getScratch(uint32 size);
 
 	Common::File _input, _output;
 	int _inputOffset;
@@ -52,6 +54,9 @@ protected:
 	int _outputOffset;
 	bool _rawAudio;
 	std::map<uint32,uint32> _rawAudioMap;
+
+	byte *_scratch;
+	uint32 _scratchSize;
 };
 
 #endif
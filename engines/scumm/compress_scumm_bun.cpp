@@ -24,9 +24,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <vector>
 
 #include "common/util.h"
 #include "common/endian.h"
+#include "common/memstream.h"
+#include "common/thread.h"
 #include "compress_scumm_bun.h"
 
 /*
@@ -41,6 +44,11 @@
 
 static byte _imcTableEntryBitCount[89];
 
+/* For every table position and data packet of the size used at that
+ * position, the signed delta it adds to the output and the next position */
+static int32 _imcDeltaTable[89][128];
+static byte _imcNextTablePos[89][128];
+
 static const int16 imcTable[89] = {
 		7,	  8,	9,	 10,   11,	 12,   13,	 14,
 	   16,	 17,   19,	 21,   23,	 25,   28,	 31,
@@ -96,7 +104,7 @@ static const byte imxOtherTable[6][64] = {
 	}
 };
 
-void initializeImcTables() {
+void CompressScummBun::initializeImcTables() {
 	int pos;
 
 	for (pos = 0; pos < ARRAYSIZE(imcTable); ++pos) {
@@ -114,6 +122,41 @@ void initializeImcTables() {
 		}
 		_imcTableEntryBitCount[pos] = put;
 	}
+
+	for (pos = 0; pos < ARRAYSIZE(imcTable); ++pos) {
+		const int bitCount = _imcTableEntryBitCount[pos];
+		const byte signBitMask = (1 << (bitCount - 1));
+		const byte dataBitMask = (signBitMask - 1);
+
+		for (int packet = 0; packet < (1 << bitCount); ++packet) {
+			const byte data = (packet & dataBitMask);
+
+			int32 delta = imcTable[pos] * (2 * data + 1) >> (bitCount - 1);
+			// The topmost bit in the data packet tells is a sign bit
+			if ((packet & signBitMask) != 0)
+				delta = -delta;
+			_imcDeltaTable[pos][packet] = delta;
+
+			int nextPos = pos + (int8)imxOtherTable[bitCount - 2][data];
+			if (nextPos < 0)
+				nextPos = 0;
+			else if (nextPos >= ARRAYSIZE(imcTable))
+				nextPos = ARRAYSIZE(imcTable) - 1;
+			_imcNextTablePos[pos][packet] = nextPos;
+		}
+	}
+}
+
+/* Undoes the two delta passes shared by codecs 3 to 12 in a single pass:
+ * from the second byte on, every byte is summed up twice. */
+static void integrateTwice(byte *p, int32 size) {
+	byte sum = 0, sumOfSums = (size > 0) ? p[0] : 0;
+
+	for (int32 z = 1; z < size; z++) {
+		sum += p[z];
+		sumOfSums += sum;
+		p[z] = sumOfSums;
+	}
 }
 
 #define NextBit                            \
@@ -166,7 +209,8 @@ int32 CompressScummBun::compDecode(byte *src, byte *dst) {
 int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *comp_output, int32 input_size) {
 	int32 output_size, channels;
 	int32 offset1, offset2, offset3, length, k, c, s, j, r, t, z;
-	byte *src, *t_table, *p, *ptr;
+	byte *src, *p, *ptr;
+	byte t_table[0x2000];
 	byte t_tmp1, t_tmp2;
 
 	switch (codec) {
@@ -188,22 +232,14 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 
 	case 3:
 		output_size = compDecode(comp_input, comp_output);
-		p = comp_output;
-		for (z = 2; z < output_size; z++)
-			p[z] += p[z - 1];
-		for (z = 1; z < output_size; z++)
-			p[z] += p[z - 1];
+		integrateTwice(comp_output, output_size);
 		break;
 
 	case 4:
 		output_size = compDecode(comp_input, comp_output);
-		p = comp_output;
-		for (z = 2; z < output_size; z++)
-			p[z] += p[z - 1];
-		for (z = 1; z < output_size; z++)
-			p[z] += p[z - 1];
+		integrateTwice(comp_output, output_size);
+		assert(output_size <= (int32)sizeof(t_table));
 
-		t_table = (byte *)malloc(output_size);
 		memset(t_table, 0, output_size);
 
 		src = comp_output;
@@ -234,18 +270,13 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 		offset1 = ((length - 1) * 3) >> 1;
 		t_table[offset1 + 1] = (t_table[offset1 + 1]) | (src[length - 1] & 0xf0);
 		memcpy(src, t_table, output_size);
-		free(t_table);
 		break;
 
 	case 5:
 		output_size = compDecode(comp_input, comp_output);
-		p = comp_output;
-		for (z = 2; z < output_size; z++)
-			p[z] += p[z - 1];
-		for (z = 1; z < output_size; z++)
-			p[z] += p[z - 1];
+		integrateTwice(comp_output, output_size);
+		assert(output_size <= (int32)sizeof(t_table));
 
-		t_table = (byte *)malloc(output_size);
 		memset(t_table, 0, output_size);
 
 		src = comp_output;
@@ -276,18 +307,13 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 			} while (k < t);
 		}
 		memcpy(src, t_table, output_size);
-		free(t_table);
 		break;
 
 	case 6:
 		output_size = compDecode(comp_input, comp_output);
-		p = comp_output;
-		for (z = 2; z < output_size; z++)
-			p[z] += p[z - 1];
-		for (z = 1; z < output_size; z++)
-			p[z] += p[z - 1];
+		integrateTwice(comp_output, output_size);
+		assert(output_size <= (int32)sizeof(t_table));
 
-		t_table = (byte *)malloc(output_size);
 		memset(t_table, 0, output_size);
 
 		src = comp_output;
@@ -319,19 +345,14 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 			} while (k < t);
 		}
 		memcpy(src, t_table, output_size);
-		free(t_table);
 		break;
 
 	case 10:
 		output_size = compDecode(comp_input, comp_output);
-		p = comp_output;
-		for (z = 2; z < output_size; z++)
-			p[z] += p[z - 1];
-		for (z = 1; z < output_size; z++)
-			p[z] += p[z - 1];
+		integrateTwice(comp_output, output_size);
+		assert(output_size <= (int32)sizeof(t_table));
 
-		t_table = (byte *)malloc(output_size);
-		memcpy(t_table, p, output_size);
+		memcpy(t_table, comp_output, output_size);
 
 		offset1 = output_size / 3;
 		offset2 = offset1 << 1;
@@ -372,19 +393,14 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 		}
 		offset1 = ((length - 1) * 3) >> 1;
 		src[offset1 + 1] = (t_table[length] & 0xf0) | src[offset1 + 1];
-		free(t_table);
 		break;
 
 	case 11:
 		output_size = compDecode(comp_input, comp_output);
-		p = comp_output;
-		for (z = 2; z < output_size; z++)
-			p[z] += p[z - 1];
-		for (z = 1; z < output_size; z++)
-			p[z] += p[z - 1];
+		integrateTwice(comp_output, output_size);
+		assert(output_size <= (int32)sizeof(t_table));
 
-		t_table = (byte *)malloc(output_size);
-		memcpy(t_table, p, output_size);
+		memcpy(t_table, comp_output, output_size);
 
 		offset1 = output_size / 3;
 		offset2 = offset1 << 1;
@@ -425,19 +441,14 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 				k++;
 			} while (k < t);
 		}
-		free(t_table);
 		break;
 
 	case 12:
 		output_size = compDecode(comp_input, comp_output);
-		p = comp_output;
-		for (z = 2; z < output_size; z++)
-			p[z] += p[z - 1];
-		for (z = 1; z < output_size; z++)
-			p[z] += p[z - 1];
+		integrateTwice(comp_output, output_size);
+		assert(output_size <= (int32)sizeof(t_table));
 
-		t_table = (byte *)malloc(output_size);
-		memcpy(t_table, p, output_size);
+		memcpy(t_table, comp_output, output_size);
 
 		offset1 = output_size / 3;
 		offset2 = offset1 << 1;
@@ -478,7 +489,6 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 				k++;
 			} while (k < t);
 		}
-		free(t_table);
 		break;
 
 	case 13:
@@ -496,12 +506,11 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 
 			const int MAX_CHANNELS = 2;
 			int32 outputSamplesLeft;
-			int32 destPos;
 			int16 firstWord;
 			byte initialTablePos[MAX_CHANNELS] = {0, 0};
 			int32 initialimcTableEntry[MAX_CHANNELS] = {7, 7};
 			int32 initialOutputWord[MAX_CHANNELS] = {0, 0};
-			int32 totalBitOffset, curTablePos, outputWord;
+			int32 curTablePos, outputWord;
 			byte *dst;
 			int i;
 
@@ -538,6 +547,7 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 				// Read the seed values for the decoder.
 				for (i = 0; i < channels; i++) {
 					initialTablePos[i] = *src;
+					assert(initialTablePos[i] < ARRAYSIZE(imcTable));
 					src += 1;
 					initialimcTableEntry[i] = READ_BE_UINT32(src);
 					src += 4;
@@ -546,7 +556,11 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 				}
 			}
 
-			totalBitOffset = 0;
+			// The packets are read from the front of a bit buffer, which is
+			// topped up a byte at a time, so no byte is read more than once
+			uint32 bitBuffer = 0;
+			int bitsInBuffer = 0;
+
 			// The channels are encoded separately.
 			for (int chan = 0; chan < channels; chan++) {
 				// Read initial state (this makes it possible for the data stream
@@ -557,7 +571,8 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 
 				// We need to interleave the channels in the output; we achieve
 				// that by using a variables dest offset:
-				destPos = chan * 2;
+				byte *destPos = dst + chan * 2;
+				const int destStep = channels << 1;
 
 				const int bound = (channels == 1)
 									? outputSamplesLeft
@@ -566,46 +581,29 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 										: outputSamplesLeft / 2);
 				for (i = 0; i < bound; ++i) {
 					// Determine the size (in bits) of the next data packet
-					const int32 curTableEntryBitCount = _imcTableEntryBitCount[curTablePos];
-					assert(2 <= curTableEntryBitCount && curTableEntryBitCount <= 7);
+					const int curTableEntryBitCount = _imcTableEntryBitCount[curTablePos];
 
 					// Read the next data packet
-					const byte *readPos = src + (totalBitOffset >> 3);
-					const uint16 readWord = (uint16)(READ_BE_UINT16(readPos) << (totalBitOffset & 7));
-					const byte packet = (byte)(readWord >> (16 - curTableEntryBitCount));
-
-					// Advance read position to the next data packet
-					totalBitOffset += curTableEntryBitCount;
-
-					// Decode the data packet into a delta value for the output signal.
-					const byte signBitMask = (1 << (curTableEntryBitCount - 1));
-					const byte dataBitMask = (signBitMask - 1);
-					const byte data = (packet & dataBitMask);
-
-					int32 delta = imcTable[curTablePos] * (2 * data + 1) >> (curTableEntryBitCount - 1);
-
-					// The topmost bit in the data packet tells is a sign bit
-					if ((packet & signBitMask) != 0) {
-						delta = -delta;
+					while (bitsInBuffer < curTableEntryBitCount) {
+						bitBuffer = (bitBuffer << 8) | *src++;
+						bitsInBuffer += 8;
 					}
+					bitsInBuffer -= curTableEntryBitCount;
+					const int packet = (bitBuffer >> bitsInBuffer) & ((1 << curTableEntryBitCount) - 1);
 
-					// Accumulate the delta onto the output data
-					outputWord += delta;
+					// Accumulate the delta for this packet onto the output data
+					outputWord += _imcDeltaTable[curTablePos][packet];
 
 					// Clip outputWord to 16 bit signed, and write it into the destination stream
 					if (outputWord > 0x7fff)
 						outputWord = 0x7fff;
 					if (outputWord < -0x8000)
 						outputWord = -0x8000;
-					WRITE_BE_UINT16(dst + destPos, outputWord);
-					destPos += channels << 1;
+					WRITE_BE_UINT16(destPos, outputWord);
+					destPos += destStep;
 
 					// Adjust the curTablePos
-					curTablePos += (int8)imxOtherTable[curTableEntryBitCount - 2][data];
-					if (curTablePos < 0)
-						curTablePos = 0;
-					else if (curTablePos >= ARRAYSIZE(imcTable))
-						curTablePos = ARRAYSIZE(imcTable) - 1;
+					curTablePos = _imcNextTablePos[curTablePos][packet];
 				}
 			}
 		}
@@ -620,143 +618,6 @@ int32 CompressScummBun::decompressCodec(int32 codec, byte *comp_input, byte *com
 	return output_size;
 }
 
-void CompressScummBun::encodeWaveWithFlac(char *filename) {
-	char fbuf[2048];
-	char fbuf2[2048];
-	sprintf(fbuf, "%s.wav", filename);
-	sprintf(fbuf2, "%s.fla", filename);
-	encodeAudio(fbuf, false, -1, fbuf2, AUDIO_FLAC);
-}
-
-void CompressScummBun::encodeWaveWithOgg(char *filename) {
-	char fbuf[2048];
-	char fbuf2[2048];
-	sprintf(fbuf, "%s.wav", filename);
-	sprintf(fbuf2, "%s.ogg", filename);
-	encodeAudio(fbuf, false, -1, fbuf2, AUDIO_VORBIS);
-}
-
-void CompressScummBun::encodeWaveWithLame(char *filename) {
-	char fbuf[2048];
-	char fbuf2[2048];
-
-	sprintf(fbuf, "%s.wav", filename);
-	sprintf(fbuf2, "%s.mp3", filename);
-	encodeAudio(fbuf, false, -1, fbuf2, AUDIO_MP3);
-}
-
-void CompressScummBun::writeWaveHeader(int s_size, int rate, int chan) {
-	int bits = 16;
-	byte wav[44];
-	memset(wav, 0, 44);
-	wav[0] = 'R';
-	wav[1] = 'I';
-	wav[2] = 'F';
-	wav[3] = 'F';
-	wav[4] = (s_size + 36) & 0xff;
-	wav[5] = ((s_size +	36)	>> 8) &	0xff;
-	wav[6] = ((s_size +	36)	>> 16) & 0xff;
-	wav[7] = ((s_size +	36)	>> 24) & 0xff;
-	wav[8] = 'W';
-	wav[9] = 'A';
-	wav[10]	= 'V';
-	wav[11]	= 'E';
-	wav[12]	= 'f';
-	wav[13]	= 'm';
-	wav[14]	= 't';
-	wav[15]	= 0x20;
-	wav[16]	= 16;
-	wav[20]	= 1;
-	wav[22]	= chan;
-	wav[24]	= rate & 0xff;
-	wav[25]	= (rate	>> 8) &	0xff;
-	wav[26]	= (rate	>> 16) & 0xff;
-	wav[27]	= (rate	>> 24) & 0xff;
-	wav[28]	= (rate	* chan * (bits / 8)) & 0xff;
-	wav[29]	= ((rate * chan	* (bits	/ 8))>>	8) & 0xff;
-	wav[30]	= ((rate * chan	* (bits	/ 8)) >> 16) & 0xff;
-	wav[31]	= ((rate * chan	* (bits	/ 8)) >> 24) & 0xff;
-	wav[32]	= (chan	* (bits	/ 8)) &	0xff;
-	wav[33]	= ((chan * (bits / 8)) >> 8) & 0xff;
-	wav[34]	= bits;
-	wav[36]	= 'd';
-	wav[37]	= 'a';
-	wav[38]	= 't';
-	wav[39]	= 'a';
-	wav[40]	= s_size & 0xff;
-	wav[41]	= (s_size >> 8)	& 0xff;
-	wav[42]	= (s_size >> 16) & 0xff;
-	wav[43]	= (s_size >> 24) & 0xff;
-
-	_waveTmpFile.seek(0, SEEK_SET);
-	if (_waveTmpFile.write(wav, 44) != 44) {
-		error("error writing temp wave file");
-	}
-	_waveTmpFile.close();
-}
-
-void CompressScummBun::writeToTempWave(char *fileName, byte *output_data, unsigned int size) {
-	if (!_waveTmpFile.isOpen()) {
-		_waveTmpFile.open(fileName, "wb");
-		byte wav[44];
-		memset(wav, 0, 44);
-		_waveTmpFile.write(output_data, 44);
-		_waveDataSize = 0;
-	}
-	for (unsigned int j = 0; j < size - 1; j += 2) {
-		byte tmp = output_data[j + 0];
-		output_data[j + 0] = output_data[j + 1];
-		output_data[j + 1] = tmp;
-	}
-	_waveTmpFile.write(output_data, size);
-	_waveDataSize += size;
-}
-
-typedef struct { int offset, size, codec; } CompTable;
-
-byte *CompressScummBun::decompressBundleSound(int index, Common::File  &input, int32 &finalSize) {
-	byte compOutput[0x2000];
-	int i;
-
-	input.seek(_bundleTable[index].offset, SEEK_SET);
-
-	uint32 tag = input.readUint32BE();
-	assert(tag == 'COMP');
-	int numCompItems = input.readUint32BE();
-	input.seek(8, SEEK_CUR);
-
-	CompTable *compTable = (CompTable *)malloc(sizeof(CompTable) * numCompItems);
-	int32 maxSize = 0;
-	for (i = 0; i < numCompItems; i++) {
-		compTable[i].offset = input.readUint32BE();
-		compTable[i].size = input.readUint32BE();
-		compTable[i].codec = input.readUint32BE();
-		input.seek(4, SEEK_CUR);
-		if (compTable[i].size > maxSize)
-			maxSize = compTable[i].size;
-	}
-	// CMI hack: one more byte at the end of input buffer
-	byte *compInput = (byte *)malloc(maxSize + 1);
-	byte *compFinal = (byte *)malloc(numCompItems * 0x2000);
-
-	finalSize = 0;
-
-	for (i = 0; i < numCompItems; i++) {
-		compInput[compTable[i].size] = 0;
-		input.seek(_bundleTable[index].offset + compTable[i].offset, SEEK_SET);
-		input.read_throwsOnError(compInput, compTable[i].size);
-		int outputSize = decompressCodec(compTable[i].codec, compInput, compOutput, compTable[i].size);
-		assert(outputSize <= 0x2000);
-		memcpy(compFinal + finalSize, compOutput, outputSize);
-		finalSize += outputSize;
-	}
-
-	free(compInput);
-	free(compTable);
-
-	return compFinal;
-}
-
 byte *CompressScummBun::convertTo16bit(byte *ptr, int inputSize, int &outputSize, int bits, int freq, int channels) {
 	outputSize = inputSize;
 	if (bits == 8)
@@ -863,74 +724,179 @@ struct Marker {
 	char *ptr;
 };
 
-static Region *_region;
-static int _numRegions;
+/* Decodes a bundle entry and encodes its regions. The entries are read on
+ * the main thread; the jobs run concurrently, and the results are then
+ * written to the output in order. */
+class CompressScummBun::BundleJob : public Common::Job {
+public:
+	BundleJob(CompressScummBun *tool, Common::File &output, const char *filename, int slot, bool verbose) :
+		_tool(tool), _output(output), _filename(filename), _slot(slot), _verbose(verbose),
+		_compTable(NULL), _numCompItems(0), _compInput(NULL), _region(NULL), _numRegions(0) { }
+	~BundleJob() {
+		free(_compTable);
+		free(_compInput);
+		free(_region);
+	}
+
+	virtual void run();
+	virtual void complete() { _tool->writeBundleSound(this, _output); }
+
+	CompressScummBun *_tool;
+	Common::File &_output;
+	const char *_filename;
+	int _slot;
+	bool _verbose;
+
+	CompTable *_compTable;
+	int _numCompItems;
+	byte *_compInput;
+
+	Region *_region;
+	int _numRegions;
+
+	Common::MemoryWriteStreamDynamic _map;
+	Common::MemoryWriteStreamDynamic _regionData;
+	std::vector<uint32> _regionSizes;
+};
+
+void CompressScummBun::BundleJob::run() {
+	int offsetData = 0, bits = 0, freq = 0, channels = 0;
+	int32 size = 0;
+	byte *compFinal = _tool->decompressBundleSound(this, size);
+	free(_compInput);
+	_compInput = NULL;
+
+	try {
+		_tool->writeToRMAPFile(compFinal, this, offsetData, bits, freq, channels);
+		_tool->writeRegions(compFinal + offsetData, bits, freq, channels, this);
+	} catch (...) {
+		free(compFinal);
+		throw;
+	}
+	free(compFinal);
+}
+
+void CompressScummBun::readCompBlocks(int index, Common::File &input, CompTable *&compTable, int &numCompItems, byte *&compInput) {
+	int i;
+
+	input.seek(_bundleTable[index].offset, SEEK_SET);
+
+	uint32 tag = input.readUint32BE();
+	assert(tag == 'COMP');
+	numCompItems = input.readUint32BE();
+	input.seek(8, SEEK_CUR);
+
+	compTable = (CompTable *)malloc(sizeof(CompTable) * numCompItems);
+	int32 totalSize = 0;
+	for (i = 0; i < numCompItems; i++) {
+		compTable[i].offset = input.readUint32BE();
+		compTable[i].size = input.readUint32BE();
+		compTable[i].codec = input.readUint32BE();
+		input.seek(4, SEEK_CUR);
+		// CMI hack: one more byte at the end of each input buffer
+		totalSize += compTable[i].size + 1;
+	}
+
+	compInput = (byte *)malloc(totalSize);
+	byte *block = compInput;
+	for (i = 0; i < numCompItems; i++) {
+		input.seek(_bundleTable[index].offset + compTable[i].offset, SEEK_SET);
+		input.read_throwsOnError(block, compTable[i].size);
+		block[compTable[i].size] = 0;
+		block += compTable[i].size + 1;
+	}
+}
+
+void CompressScummBun::readBundleSound(int index, Common::File &input, BundleJob *job) {
+	readCompBlocks(index, input, job->_compTable, job->_numCompItems, job->_compInput);
+}
+
+byte *CompressScummBun::decompressBundleSound(BundleJob *job, int32 &finalSize) {
+	byte *compInput = job->_compInput;
+	CompTable *compTable = job->_compTable;
 
-void CompressScummBun::writeRegions(byte *ptr, int bits, int freq, int channels, const char *dir, char *filename, Common::File &output) {
-	char tmpPath[200];
+	byte *compFinal = (byte *)malloc(job->_numCompItems * 0x2000);
 
-	for (int l = 0; l < _numRegions; l++) {
+	finalSize = 0;
+
+	// Every block decodes to at most 0x2000 bytes, so it goes right after the previous one
+	for (int i = 0; i < job->_numCompItems; i++) {
+		int outputSize = decompressCodec(compTable[i].codec, compInput, compFinal + finalSize, compTable[i].size);
+		assert(outputSize <= 0x2000);
+		finalSize += outputSize;
+		compInput += compTable[i].size + 1;
+	}
+
+	return compFinal;
+}
+
+void CompressScummBun::writeRegions(byte *ptr, int bits, int freq, int channels, BundleJob *job) {
+	// The encoded regions are kept in memory until the entry is written
+	RawAudioType type;
+	type.isLittleEndian = true;
+	type.isStereo = (channels == 2);
+	type.bitsPerSample = 16;
+
+	char tempName[32];
+	sprintf(tempName, "tempfile%d", job->_slot);
+
+	for (int l = 0; l < job->_numRegions; l++) {
 		int outputSize = 0;
-		int size = _region[l].length;
-		int offset = _region[l].offset;
+		int size = job->_region[l].length;
+		int offset = job->_region[l].offset;
 		byte *outputData = convertTo16bit(ptr + offset, size, outputSize, bits, freq, channels);
-		sprintf(tmpPath, "%s%s_reg%03d.wav", dir, filename, l);
-		writeToTempWave(tmpPath, outputData, outputSize);
-		writeWaveHeader(_waveDataSize, freq, channels);
-		free(outputData);
-		sprintf(tmpPath, "%s%s_reg%03d", dir, filename, l);
 
-		switch (_format) {
-		case AUDIO_MP3:
-			encodeWaveWithLame(tmpPath);
-			break;
-		case AUDIO_VORBIS:
-			encodeWaveWithOgg(tmpPath);
-			break;
-		case AUDIO_FLAC:
-			encodeWaveWithFlac(tmpPath);
-			break;
-		default:
-			error("Unknown encoding method");
+		// convertTo16bit() produces big endian samples
+		for (int j = 0; j < outputSize - 1; j += 2) {
+			byte tmp = outputData[j + 0];
+			outputData[j + 0] = outputData[j + 1];
+			outputData[j + 1] = tmp;
+		}
+
+		uint32 startPos = job->_regionData.size();
+		try {
+			encodeRawData((char *)outputData, outputSize, freq, type, _format, job->_regionData, tempName, job->_verbose);
+		} catch (...) {
+			free(outputData);
+			throw;
 		}
+		free(outputData);
+
+		job->_regionSizes.push_back(job->_regionData.size() - startPos);
+	}
+}
 
-		sprintf(tmpPath, "%s%s_reg%03d.wav", dir, filename, l);
-		Common::removeFile(tmpPath);
+void CompressScummBun::writeBundleSound(BundleJob *job, Common::File &output) {
+	int32 startPos = output.pos();
+	sprintf(_cbundleTable[_cbundleCurIndex].filename, "%s.map", job->_filename);
+	_cbundleTable[_cbundleCurIndex].offset = startPos;
+	output.write(job->_map.getData(), job->_map.size());
+	_cbundleTable[_cbundleCurIndex].size = output.pos() - startPos;
+	_cbundleCurIndex++;
 
-		int32 startPos = output.pos();
+	const byte *encoded = job->_regionData.getData();
+	for (int l = 0; l < (int)job->_regionSizes.size(); l++) {
 		switch (_format) {
 		case AUDIO_MP3:
-			sprintf(_cbundleTable[_cbundleCurIndex].filename, "%s_reg%03d.mp3", filename, l);
-			sprintf(tmpPath, "%s%s_reg%03d.mp3", dir, filename, l);
+			sprintf(_cbundleTable[_cbundleCurIndex].filename, "%s_reg%03d.mp3", job->_filename, l);
 			break;
 		case AUDIO_VORBIS:
-			sprintf(_cbundleTable[_cbundleCurIndex].filename, "%s_reg%03d.ogg", filename, l);
-			sprintf(tmpPath, "%s%s_reg%03d.ogg", dir, filename, l);
+			sprintf(_cbundleTable[_cbundleCurIndex].filename, "%s_reg%03d.ogg", job->_filename, l);
 			break;
 		case AUDIO_FLAC:
-			sprintf(_cbundleTable[_cbundleCurIndex].filename, "%s_reg%03d.fla", filename, l);
-			sprintf(tmpPath, "%s%s_reg%03d.fla", dir, filename, l);
+			sprintf(_cbundleTable[_cbundleCurIndex].filename, "%s_reg%03d.fla", job->_filename, l);
 			break;
 		default:
 			error("Unknown encoding method");
 		}
-		_cbundleTable[_cbundleCurIndex].offset = startPos;
 
-		Common::File cmpFile(tmpPath, "rb");
-		cmpFile.seek(0, SEEK_END);
-		size = cmpFile.pos();
-		cmpFile.seek(0, SEEK_SET);
-		byte *tmpBuf = (byte *)malloc(size);
-		cmpFile.read_throwsOnError(tmpBuf, size);
-		cmpFile.close();
-		Common::removeFile(tmpPath);
-
-		output.write(tmpBuf, size);
-		free(tmpBuf);
+		startPos = output.pos();
+		_cbundleTable[_cbundleCurIndex].offset = startPos;
+		output.write(encoded, job->_regionSizes[l]);
 		_cbundleTable[_cbundleCurIndex].size = output.pos() - startPos;
 		_cbundleCurIndex++;
+		encoded += job->_regionSizes[l];
 	}
-	free(_region);
 }
 
 void CompressScummBun::recalcRegions(int32 &value, int bits, int freq, int channels) {
@@ -942,7 +908,8 @@ void CompressScummBun::recalcRegions(int32 &value, int bits, int freq, int chann
 	value = size;
 }
 
-void CompressScummBun::writeToRMAPFile(byte *ptr, Common::File &output, char *filename, int &offsetData, int &bits, int &freq, int &channels) {
+void CompressScummBun::writeToRMAPFile(byte *ptr, BundleJob *job, int &offsetData, int &bits, int &freq, int &channels) {
+	Common::MemoryWriteStreamDynamic &output = job->_map;
 	byte *s_ptr = ptr;
 	int32 size = 0;
 	int l;
@@ -959,8 +926,8 @@ void CompressScummBun::writeToRMAPFile(byte *ptr, Common::File &output, char *fi
 	int numRegions = 0, numJumps = 0, numSyncs = 0, numMarkers = 0;
 	countMapElements(ptr, numRegions, numJumps, numSyncs, numMarkers);
 	Region *region = (Region *)malloc(sizeof(Region) * numRegions);
-	_region = (Region *)malloc(sizeof(Region) * numRegions);
-	_numRegions = numRegions;
+	job->_region = (Region *)malloc(sizeof(Region) * numRegions);
+	job->_numRegions = numRegions;
 	Jump *jump = (Jump *)malloc(sizeof(Jump) * numJumps);
 	Sync *sync = (Sync *)malloc(sizeof(Sync) * numSyncs);
 	Marker *marker = (Marker *)malloc(sizeof(Marker) * numMarkers);
@@ -1013,15 +980,11 @@ void CompressScummBun::writeToRMAPFile(byte *ptr, Common::File &output, char *fi
 			ptr += 4;
 			break;
 		default:
-			error("writeToRMAPFile() Unknown tag of Map for sound '%s'", filename);
+			error("writeToRMAPFile() Unknown tag of Map for sound '%s'", job->_filename);
 		}
 	} while (tag != 'DATA');
 	offsetData = (int32)(ptr - s_ptr);
 
-	int32 startPos = output.pos();
-	sprintf(_cbundleTable[_cbundleCurIndex].filename, "%s.map", filename);
-	_cbundleTable[_cbundleCurIndex].offset = startPos;
-
 	output.writeUint32BE('RMAP');
 	output.writeUint32BE(3); // version
 	output.writeUint32BE(16); // bits
@@ -1031,9 +994,9 @@ void CompressScummBun::writeToRMAPFile(byte *ptr, Common::File &output, char *fi
 	output.writeUint32BE(numJumps);
 	output.writeUint32BE(numSyncs);
 	output.writeUint32BE(numMarkers);
-	memcpy(_region, region, sizeof(Region) * numRegions);
+	memcpy(job->_region, region, sizeof(Region) * numRegions);
 	for (l = 0; l < numRegions; l++) {
-		_region[l].offset -= offsetData;
+		job->_region[l].offset -= offsetData;
 		region[l].offset -= offsetData;
 		recalcRegions(region[l].offset, bits, freq, channels);
 		recalcRegions(region[l].length, bits, freq, channels);
@@ -1065,15 +1028,13 @@ void CompressScummBun::writeToRMAPFile(byte *ptr, Common::File &output, char *fi
 	free(jump);
 	free(sync);
 	free(marker);
-
-	_cbundleTable[_cbundleCurIndex].size = output.pos() - startPos;
-	_cbundleCurIndex++;
 }
 
 CompressScummBun::CompressScummBun(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	_cbundleCurIndex = 0;
 
 	_supportsProgressBar = true;
+	_supportsParallelEncoding = true;
 
 	ToolInput input;
 	input.format = "*.bun";
@@ -1083,34 +1044,11 @@ CompressScummBun::CompressScummBun(const std::string &name) : CompressionTool(na
 	_helptext = "\nUsage: " + getName() + " [mode] [mode-params] [-o outputfile = inputfile.bun] <inputfile>\n";
 }
 
-void CompressScummBun::execute() {
-	Common::Filename inpath(_inputPaths[0].path);
-	Common::Filename &outpath = _outputPath;
-
-	uint32 tag;
-	int32 numFiles, offset;
-
-	Common::File input(inpath, "rb");
-
-	if (outpath.empty()) {
-		// Change extension for output
-		outpath = inpath;
-	}
-
-	outpath.setFullName(inpath.getName());
-	outpath.setExtension(".bun");
-	Common::File output(outpath, "wb");
-
-	output.writeUint32BE('LB23');
-	output.writeUint32BE(0); // will be later
-	output.writeUint32BE(0); // will be later
-
-	initializeImcTables();
-
-	tag = input.readUint32BE();
+int CompressScummBun::readBundleTable(Common::File &input) {
+	uint32 tag = input.readUint32BE();
 	assert(tag == 'LB83');
-	offset = input.readUint32BE();
-	numFiles = input.readUint32BE();
+	int32 offset = input.readUint32BE();
+	int32 numFiles = input.readUint32BE();
 
 	_bundleTable = (BundleAudioTable *)malloc(numFiles * sizeof(BundleAudioTable));
 	input.seek(offset, SEEK_SET);
@@ -1133,22 +1071,55 @@ void CompressScummBun::execute() {
 		_bundleTable[i].size = input.readUint32BE();
 	}
 
-	for (int i = 0; i < numFiles; i++) {
+	return numFiles;
+}
+
+void CompressScummBun::execute() {
+	Common::Filename inpath(_inputPaths[0].path);
+	Common::Filename &outpath = _outputPath;
+
+	Common::File input(inpath, "rb");
+
+	if (outpath.empty()) {
+		// Change extension for output
+		outpath = inpath;
+	}
+
+	initializeImcTables();
+	int numFiles = readBundleTable(input);
+
+	outpath.setFullName(inpath.getName());
+	outpath.setExtension(".bun");
+	Common::File output(outpath, "wb");
+
+	output.writeUint32BE('LB23');
+	output.writeUint32BE(0); // will be later
+	output.writeUint32BE(0); // will be later
+
+	// With --jobs, several entries are decoded and encoded at the same time.
+	// They are still written in order, so the output is the same either way.
+	Common::OrderedJobWindow queue(_numJobs);
+	int i;
+
+	for (i = 0; i < numFiles; i++) {
 		if (strcmp(_bundleTable[i].filename, "PRELOAD.") == 0)
 			continue;
 
 		updateProgress(i, numFiles);
 
-		int offsetData = 0, bits = 0, freq = 0, channels = 0;
-		int32 size = 0;
-		byte *compFinal = decompressBundleSound(i, input, size);
-		writeToRMAPFile(compFinal, output, _bundleTable[i].filename, offsetData, bits, freq, channels);
-		writeRegions(compFinal + offsetData, bits, freq, channels, outpath.getPath().c_str(), _bundleTable[i].filename, output);
-		free(compFinal);
+		BundleJob *job = new BundleJob(this, output, _bundleTable[i].filename, queue.getNextSlot(), queue.getNumThreads() == 1);
+		try {
+			readBundleSound(i, input, job);
+		} catch (...) {
+			delete job;
+			throw;
+		}
+		queue.push(job);
 	}
+	queue.completeAll();
 
 	int32 curPos = output.pos();
-	for (int i = 0; i < _cbundleCurIndex; i++) {
+	for (i = 0; i < _cbundleCurIndex; i++) {
 		output.write(_cbundleTable[i].filename, 24);
 		output.writeUint32BE(_cbundleTable[i].offset);
 		output.writeUint32BE(_cbundleTable[i].size);
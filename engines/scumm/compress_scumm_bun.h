@@ -37,27 +37,41 @@ public:
 		int offset;
 	};
 
+	/** A compressed block of a bundle entry */
+	struct CompTable {
+		int offset, size, codec;
+	};
+
 protected:
 
-	Common::File _waveTmpFile;
-	int32 _waveDataSize;
 	BundleAudioTable *_bundleTable;
 	BundleAudioTable _cbundleTable[10000]; // difficult to calculate
 	int32 _cbundleCurIndex;
 
+	class BundleJob;
+
+	/** Builds the tables of the IMC codecs, call before decompressCodec(). */
+	static void initializeImcTables();
+
+	/** Reads the directory of the bundle into _bundleTable, returns the number of entries. */
+	int readBundleTable(Common::File &input);
+
+	/**
+	 * Reads the block table and the compressed blocks of a bundle entry. Each
+	 * block is followed by a zero byte; both buffers must be freed with free().
+	 */
+	void readCompBlocks(int index, Common::File &input, CompTable *&compTable, int &numCompItems, byte *&compInput);
+
 	int32 compDecode(byte *src, byte *dst);
 	int32 decompressCodec(int32 codec, byte *comp_input, byte *comp_output, int32 input_size);
-	void encodeWaveWithFlac(char *filename);
-	void encodeWaveWithOgg(char *filename);
-	void encodeWaveWithLame(char *filename);
-	void writeWaveHeader(int s_size, int rate, int chan);
-	void writeToTempWave(char *fileName, byte *output_data, unsigned int size);
-	byte *decompressBundleSound(int index, Common::File  &input, int32 &finalSize);
+	void readBundleSound(int index, Common::File &input, BundleJob *job);
+	byte *decompressBundleSound(BundleJob *job, int32 &finalSize);
+	void writeBundleSound(BundleJob *job, Common::File &output);
 	byte *convertTo16bit(byte *ptr, int inputSize, int &outputSize, int bits, int freq, int channels);
 	void countMapElements(byte *ptr, int &numRegions, int &numJumps, int &numSyncs, int &numMarkers);
-	void writeRegions(byte *ptr, int bits, int freq, int channels, const char *dir, char *filename, Common::File &output);
+	void writeRegions(byte *ptr, int bits, int freq, int channels, BundleJob *job);
 	void recalcRegions(int32 &value, int bits, int freq, int channels);
-	void writeToRMAPFile(byte *ptr, Common::File &output, char *filename, int &offsetData, int &bits, int &freq, int &channels);
+	void writeToRMAPFile(byte *ptr, BundleJob *job, int &offsetData, int &bits, int &freq, int &channels);
 };
 
 #endif
@@ -28,42 +28,26 @@
 
 #include "compress_scumm_san.h"
 #include "common/endian.h"
+#include "common/thread.h"
+#include "common/util.h"
 
-void CompressScummSan::encodeSanWaveWithOgg(const std::string &filename) {
-	std::string fbuf = filename + ".raw";
-	Common::Filename fbuf2(filename.c_str());
-
-	fbuf2.setExtension(".ogg");
-	encodeAudio(fbuf.c_str(), true, 22050, fbuf2.getFullPath().c_str(), AUDIO_VORBIS);
-}
-
-void CompressScummSan::encodeSanWaveWithLame(const std::string &filename) {
-	std::string fbuf = filename + ".raw";
-	Common::Filename fbuf2(filename.c_str());
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-	fbuf2.setExtension(".mp3");
-	encodeAudio(fbuf.c_str(), true, 22050, fbuf2.getFullPath().c_str(), AUDIO_MP3);
-}
+#define TEMP_MIX	"tempfile.mix"
 
-void CompressScummSan::writeToTempWaveFile(const std::string &fileName, byte *output_data, unsigned int size) {
-	if (!_waveTmpFile.isOpen()) {
-		_waveTmpFile.open(fileName, "wb");
-		if (!_waveTmpFile.isOpen()) {
-			error("error writing temp wave file");
-		}
-		_waveDataSize = 0;
-	}
+void CompressScummSan::writeToWaveData(byte *output_data, unsigned int size) {
 	for (unsigned int j = 0; j < size - 1; j += 2) {
 		byte tmp = output_data[j + 0];
 		output_data[j + 0] = output_data[j + 1];
 		output_data[j + 1] = tmp;
 	}
 
-	_waveTmpFile.write(output_data, size);
-	_waveDataSize += size;
+	_waveFile.write(output_data, size);
 }
 
-void CompressScummSan::decompressComiIACT(const std::string &fileName, byte *output_data, byte *d_src, int bsize) {
+void CompressScummSan::decompressComiIACT(byte *output_data, byte *d_src, int bsize) {
 	byte value;
 
 	while (bsize > 0) {
@@ -103,7 +87,7 @@ void CompressScummSan::decompressComiIACT(const std::string &fileName, byte *out
 						*dst++ = (byte)(val);
 					}
 				} while (--count);
-				writeToTempWaveFile(fileName, output_data, 0x1000);
+				writeToWaveData(output_data, 0x1000);
 				bsize -= len;
 				d_src += len;
 				_IACTpos = 0;
@@ -121,15 +105,14 @@ void CompressScummSan::decompressComiIACT(const std::string &fileName, byte *out
 	}
 }
 
-void CompressScummSan::handleComiIACT(Common::File &input, int size, const std::string &outputDir, const std::string &inputFilename) {
+void CompressScummSan::handleComiIACT(Common::File &input, int size) {
 	input.seek(10, SEEK_CUR);
 	int bsize = size - 18;
 	byte output_data[0x1000];
 	byte *src = (byte *)malloc(bsize);
 	input.read_throwsOnError(src, bsize);
 
-	const std::string tmpPath = outputDir + inputFilename + ".raw";
-	decompressComiIACT(tmpPath, output_data, src, bsize);
+	decompressComiIACT(output_data, src, bsize);
 
 	free(src);
 }
@@ -144,7 +127,7 @@ CompressScummSan::AudioTrackInfo *CompressScummSan::allocAudioTrack(int trackId,
 
 CompressScummSan::AudioTrackInfo *CompressScummSan::findAudioTrack(int trackId) {
 	for (int l = 0; l < COMPRESS_SCUMM_SAN_MAX_TRACKS; l++) {
-		if (_audioTracks[l].trackId == trackId && _audioTracks[l].used && _audioTracks[l].file.isOpen())
+		if (_audioTracks[l].trackId == trackId && _audioTracks[l].used && _audioTracks[l].open)
 			return &_audioTracks[l];
 	}
 	return NULL;
@@ -152,110 +135,60 @@ CompressScummSan::AudioTrackInfo *CompressScummSan::findAudioTrack(int trackId)
 
 void CompressScummSan::flushTracks(int frame) {
 	for (int l = 0; l < COMPRESS_SCUMM_SAN_MAX_TRACKS; l++) {
-		if (_audioTracks[l].used && _audioTracks[l].file.isOpen() && (frame - _audioTracks[l].lastFrame) > 1) {
-			_audioTracks[l].file.close();
+		if (_audioTracks[l].used && _audioTracks[l].open && (frame - _audioTracks[l].lastFrame) > 1) {
+			_audioTracks[l].open = false;
 		}
 	}
 }
 
-void CompressScummSan::prepareForMixing(const std::string &outputDir, const std::string &inputFilename) {
-	char filename[200];
-
-	print("Decompressing tracks files...");
-	for (int l = 0; l < COMPRESS_SCUMM_SAN_MAX_TRACKS; l++) {
-		if (_audioTracks[l].used) {
-			_audioTracks[l].file.close();
-
-			sprintf(filename, "%s%s_%04d_%03d.tmp", outputDir.c_str(), inputFilename.c_str(), _audioTracks[l].animFrame, _audioTracks[l].trackId);
-			_audioTracks[l].file.open(filename, "rb");
-			_audioTracks[l].file.seek(0, SEEK_END);
-			int fileSize = _audioTracks[l].file.pos();
-			_audioTracks[l].file.seek(0, SEEK_SET);
-			byte *audioBuf = (byte *)malloc(fileSize);
-			_audioTracks[l].file.read_throwsOnError(audioBuf, fileSize);
-			_audioTracks[l].file.close();
-
-			int outputSize = fileSize;
-			if (_audioTracks[l].bits == 8)
-				outputSize *= 2;
-			if (_audioTracks[l].bits == 12)
-				outputSize = (outputSize / 3) * 4;
-			if (!_audioTracks[l].stereo)
-				outputSize *= 2;
-			if (_audioTracks[l].freq == 11025)
-				outputSize *= 2;
-
-			byte *outputBuf = (byte *)malloc(outputSize);
-			if (_audioTracks[l].bits == 8) {
-				byte *buf = outputBuf;
-				byte *src = audioBuf;
-				for (int i = 0; i < fileSize; i++) {
-					uint16 val = (*src++ - 0x80) << 8;
-					*buf++ = (byte)val;
-					*buf++ = (byte)(val >> 8);
-					if (_audioTracks[l].freq == 11025) {
-						*buf++ = (byte)val;
-						*buf++ = (byte)(val >> 8);
-					}
-					if (!_audioTracks[l].stereo) {
-						*buf++ = (byte)val;
-						*buf++ = (byte)(val >> 8);
-						if (_audioTracks[l].freq == 11025) {
-							*buf++ = (byte)val;
-							*buf++ = (byte)(val >> 8);
-						}
-					}
-				}
-			}
-			if (_audioTracks[l].bits == 12) {
-				int loop_size = fileSize / 3;
-				byte *decoded = outputBuf;
-				byte *source = audioBuf;
-				uint32 value;
-
-				while (loop_size--) {
-					byte v1 =  *source++;
-					byte v2 =  *source++;
-					byte v3 =  *source++;
-					value = ((((v2 & 0x0f) << 8) | v1) << 4) - 0x8000;
-					*decoded++ = (byte)(value & 0xff);
-					*decoded++ = (byte)((value >> 8) & 0xff);
-					if (_audioTracks[l].freq == 11025) {
-						*decoded++ = (byte)(value & 0xff);
-						*decoded++ = (byte)((value >> 8) & 0xff);
-					}
-					if (!_audioTracks[l].stereo) {
-						*decoded++ = (byte)(value & 0xff);
-						*decoded++ = (byte)((value >> 8) & 0xff);
-						if (_audioTracks[l].freq == 11025) {
-							*decoded++ = (byte)(value & 0xff);
-							*decoded++ = (byte)((value >> 8) & 0xff);
-						}
-					}
-					value = ((((v2 & 0xf0) << 4) | v3) << 4) - 0x8000;
-					*decoded++ = (byte)(value & 0xff);
-					*decoded++ = (byte)((value >> 8) & 0xff);
-					if (_audioTracks[l].freq == 11025) {
-						*decoded++ = (byte)(value & 0xff);
-						*decoded++ = (byte)((value >> 8) & 0xff);
-					}
-					if (!_audioTracks[l].stereo) {
-						*decoded++ = (byte)(value & 0xff);
-						*decoded++ = (byte)((value >> 8) & 0xff);
-						if (_audioTracks[l].freq == 11025) {
-							*decoded++ = (byte)(value & 0xff);
-							*decoded++ = (byte)((value >> 8) & 0xff);
-						}
-					}
-				}
-			}
+/* Size of a track once converted to 16-bit stereo at 22050 Hz, in bytes */
+static int convertedTrackSize(const CompressScummSan::AudioTrackInfo &track) {
+	int outputSize = track.data.size();
+	if (track.bits == 8)
+		outputSize *= 2;
+	if (track.bits == 12)
+		outputSize = (outputSize / 3) * 4;
+	if (!track.stereo)
+		outputSize *= 2;
+	if (track.freq == 11025)
+		outputSize *= 2;
+	return outputSize;
+}
 
-			free(audioBuf);
-			_audioTracks[l].file.open(filename, "wb");
-			_audioTracks[l].file.write(outputBuf, outputSize);
-			free(outputBuf);
+int16 *CompressScummSan::convertTrack(const AudioTrackInfo &track) {
+	const int fileSize = track.data.size();
+	const byte *audioBuf = track.data.getData();
+	// Each sample is repeated for mono, and again for 11 kHz tracks
+	const int repeat = (track.stereo ? 1 : 2) * (track.freq == 11025 ? 2 : 1);
+
+	int16 *outputBuf = (int16 *)calloc(convertedTrackSize(track) / 2 + 1, sizeof(int16));
+	int16 *decoded = outputBuf;
+	if (track.bits == 8) {
+		const byte *src = audioBuf;
+		for (int i = 0; i < fileSize; i++) {
+			int16 val = (int16)((*src++ - 0x80) << 8);
+			for (int k = 0; k < repeat; k++)
+				*decoded++ = val;
+		}
+	}
+	if (track.bits == 12) {
+		int loop_size = fileSize / 3;
+		const byte *source = audioBuf;
+
+		while (loop_size--) {
+			byte v1 =  *source++;
+			byte v2 =  *source++;
+			byte v3 =  *source++;
+			int16 value = (int16)(((((v2 & 0x0f) << 8) | v1) << 4) - 0x8000);
+			for (int k = 0; k < repeat; k++)
+				*decoded++ = value;
+			value = (int16)(((((v2 & 0xf0) << 4) | v3) << 4) - 0x8000);
+			for (int k = 0; k < repeat; k++)
+				*decoded++ = value;
 		}
 	}
+
+	return outputBuf;
 }
 
 #define ST_SAMPLE_MAX 0x7fffL
@@ -272,84 +205,211 @@ static inline void clampedAdd(int16& a, int b) {
 
 	a = val;
 }
-void CompressScummSan::mixing(const std::string &outputDir, const std::string &inputFilename, int frames, int fps) {
-	int l, r, z;
 
-	const std::string wavPath = outputDir + inputFilename + ".raw";
-	Common::File &wavFile(_waveTmpFile);
+/* Adds numSamples samples of a track at the given volume to the mix, clipping
+ * after every track like a chain of clampedAdd() calls would. */
+static void mixSamples(int16 *mix, const int16 *track, int numSamples, int volume) {
+	int i = 0;
+
+#ifdef __SSE2__
+	// The products fit in a float without rounding, and the correctly rounded
+	// quotient truncates to the same value as the integer division
+	if (volume >= 0 && volume <= 255) {
+		const __m128 vol = _mm_set1_ps((float)volume);
+		const __m128 div = _mm_set1_ps(255.0f);
+		for (; i + 8 <= numSamples; i += 8) {
+			__m128i samples = _mm_loadu_si128((const __m128i *)(track + i));
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+			lo = _mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(lo), vol), div));
+			hi = _mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(hi), vol), div));
+			__m128i sum = _mm_adds_epi16(_mm_loadu_si128((const __m128i *)(mix + i)), _mm_packs_epi32(lo, hi));
+			_mm_storeu_si128((__m128i *)(mix + i), sum);
+		}
+	}
+#endif
 
-	wavFile.open(wavPath.c_str(), "wb+");
+	for (; i < numSamples; i++)
+		clampedAdd(mix[i], (track[i] * volume) / 255);
+}
 
-	int frameAudioSize = 0;
-	if (fps == 12) {
-		frameAudioSize = 7352;
-	} else if (fps == 10) {
-		frameAudioSize = 8802;
-	} else {
-		error("Unsupported fps value %d", fps);
+static int getFrameAudioSize(int fps) {
+	if (fps == 12)
+		return 7352;
+	if (fps == 10)
+		return 8802;
+	error("Unsupported fps value %d", fps);
+	return 0;
+}
+
+/* Position of a track in the wave data, in samples */
+static uint32 trackPosition(const CompressScummSan::AudioTrackInfo &track, int fps) {
+	return getFrameAudioSize(fps) * track.animFrame / 2;
+}
+
+/* Mixes the tracks which are complete into the wave data. They are mixed in
+ * the order of their slots, so that they are clipped in the same order as if
+ * they were all mixed at the end; with finish set, the rest is mixed too.
+ * frame is the next frame to be read, no track starts before it any more. */
+void CompressScummSan::mixTracks(int frame, int fps, bool finish) {
+	while (_nextTrackToMix < COMPRESS_SCUMM_SAN_MAX_TRACKS) {
+		AudioTrackInfo &track = _audioTracks[_nextTrackToMix];
+		// A free slot may still be taken by a later track
+		if (!finish && (!track.used || track.open))
+			break;
+		if (track.used)
+			mixTrack(track, fps);
+		_nextTrackToMix++;
 	}
 
-	print("Creating silent wav file...");
-	for (l = 0; l < frameAudioSize * frames; l++) {
-		wavFile.writeByte(0);
+	// The samples which no track left to mix overlaps are final. The slots
+	// before _nextTrackToMix are all taken, so later tracks get one after it.
+	uint32 end = getFrameAudioSize(fps) * frame / 2;
+	for (int l = _nextTrackToMix; l < COMPRESS_SCUMM_SAN_MAX_TRACKS; l++) {
+		if (_audioTracks[l].used)
+			end = MIN(end, trackPosition(_audioTracks[l], fps));
 	}
 
-	print("Mixing tracks into wav file...");
-	for (l = 0; l < COMPRESS_SCUMM_SAN_MAX_TRACKS; l++) {
-		if (_audioTracks[l].used) {
-			char filename[200];
-			sprintf(filename, "%s%s_%04d_%03d.tmp", outputDir.c_str(), inputFilename.c_str(), _audioTracks[l].animFrame, _audioTracks[l].trackId);
-			_audioTracks[l].file.open(filename, "rb");
-			const uint32 fileSize = _audioTracks[l].file.size();
-			byte *tmpBuf = (byte *)malloc(fileSize);
-			_audioTracks[l].file.read_throwsOnError(tmpBuf, fileSize);
-			_audioTracks[l].file.close();
-			Common::removeFile(filename);
-
-			byte *wavBuf = (byte *)malloc(fileSize);
-			memset(wavBuf, 0, fileSize);
-			wavFile.seek(frameAudioSize * _audioTracks[l].animFrame, SEEK_SET);
-			try {
-				wavFile.read_throwsOnError(wavBuf, fileSize);
-			} catch (...) {
-				// ... pass through
-				wavFile.clearErr();
-			}
+	// Tracks may run past the end of the animation, they are written in full
+	if (finish)
+		end = MAX<uint32>(end, _mixStart + _mix.size());
 
-			int offset = 0;
-			for (z = 0; z < _audioTracks[l].countFrames; z++) {
-				int length = _audioTracks[l].sizes[z];
-				if (length == 0) {
-					warning("zero length audio frame");
-					break;
-				}
-				if (_audioTracks[l].sdatSize != 0 && (offset + length) > _audioTracks[l].sdatSize) {
-					length = _audioTracks[l].sdatSize - offset;
-				}
-				int volume = _audioTracks[l].volumes[z];
-				for (r = 0; r < length; r += 4) {
-					int16 wavSampleL = (int16)READ_LE_UINT16(wavBuf + offset + r + 0);
-					int16 wavSampleR = (int16)READ_LE_UINT16(wavBuf + offset + r + 2);
-					int32 tmpSampleL = (int16)READ_LE_UINT16(tmpBuf + offset + r + 0);
-					int32 tmpSampleR = (int16)READ_LE_UINT16(tmpBuf + offset + r + 2);
-					tmpSampleL = (tmpSampleL * volume) / 255;
-					tmpSampleR = (tmpSampleR * volume) / 255;
-					clampedAdd(wavSampleL, tmpSampleL);
-					clampedAdd(wavSampleR, tmpSampleR);
-					WRITE_LE_UINT16(wavBuf + offset + r + 0, wavSampleL);
-					WRITE_LE_UINT16(wavBuf + offset + r + 2, wavSampleR);
-				}
-				offset += length;
-			}
-			wavFile.seek(frameAudioSize * _audioTracks[l].animFrame, SEEK_SET);
-			wavFile.write(wavBuf, fileSize);
+	flushMix(end);
+}
+
+void CompressScummSan::mixTrack(AudioTrackInfo &track, int fps) {
+	const int trackSize = convertedTrackSize(track);
+	assert(trackPosition(track, fps) >= _mixStart);
+	const uint32 trackPos = trackPosition(track, fps) - _mixStart;
+
+	if (_mix.size() < trackPos + trackSize / 2)
+		_mix.resize(trackPos + trackSize / 2);
 
-			free(wavBuf);
-			free(tmpBuf);
+	int16 *trackBuf = convertTrack(track);
+	track.data.clear();
+
+	int offset = 0;
+	for (int z = 0; z < track.countFrames; z++) {
+		int length = track.sizes[z];
+		if (length == 0) {
+			warning("zero length audio frame");
+			break;
+		}
+		if (track.sdatSize != 0 && (offset + length) > track.sdatSize) {
+			length = track.sdatSize - offset;
 		}
+		// Whole stereo samples, within the track
+		int numSamples = MIN((length + 3) / 4 * 2, (trackSize - offset) / 2);
+		if (numSamples > 0)
+			mixSamples(&_mix[trackPos + offset / 2], trackBuf + offset / 2, numSamples, track.volumes[z]);
+		offset += length;
 	}
 
-	_waveDataSize = frames * frameAudioSize;
+	free(trackBuf);
+	free(track.volumes);
+	free(track.pans);
+	free(track.sizes);
+	track.volumes = track.pans = track.sizes = NULL;
+}
+
+/* Moves the mix up to the given sample to the wave data, with silence where no track plays */
+void CompressScummSan::flushMix(uint32 end) {
+	if (end <= _mixStart)
+		return;
+
+	const uint32 count = end - _mixStart;
+	if (_mix.size() < count)
+		_mix.resize(count);
+
+	// The mix is kept in native byte order until here
+	byte *mixBytes = (byte *)&_mix[0];
+	for (uint32 i = 0; i < count; i++)
+		WRITE_LE_UINT16(mixBytes + i * 2, _mix[i]);
+
+	_waveFile.write(mixBytes, count * 2);
+	_mix.erase(_mix.begin(), _mix.begin() + count);
+	_mixStart = end;
+}
+
+/* The output of one frame. Frames are read on the main thread; the jobs
+ * compress their first FOBJ concurrently, and the frames are then written
+ * in order. */
+class CompressScummSan::FrameJob : public Common::Job {
+public:
+	FrameJob(CompressScummSan *tool, Common::File &output, FrameInfo *frameInfo, int frame, int32 frameSize) :
+		_tool(tool), _output(output), _frameInfo(frameInfo), _frame(frame), _frameSize(frameSize), _fobj(NULL), _fobjSize(0), _fobjPos(0) { }
+	~FrameJob() { free(_fobj); }
+
+	virtual void run();
+	virtual void complete() { _tool->writeFrame(this, _output, _frameInfo); }
+
+	CompressScummSan *_tool;
+	Common::File &_output;
+	FrameInfo *_frameInfo;
+
+	int _frame;
+	int32 _frameSize;
+
+	// The chunks to copy, the ZFOB chunk goes at _fobjPos
+	Common::MemoryWriteStreamDynamic _data;
+
+	byte *_fobj;
+	int32 _fobjSize;
+	uint32 _fobjPos;
+	Common::MemoryWriteStreamDynamic _zfob;
+	uint32 _fobjCompressedSize;
+};
+
+void CompressScummSan::FrameJob::run() {
+	if (!_fobj)
+		return;
+
+	unsigned long outputSize = compressBound(_fobjSize);
+	byte *zlibOutputBuffer = (byte *)malloc(outputSize + 1);
+	int result = compress2(zlibOutputBuffer, &outputSize, _fobj, _fobjSize, 9);
+	if (result != Z_OK) {
+		free(zlibOutputBuffer);
+		throw ToolException("compression error");
+	}
+	if ((outputSize & 1) != 0)
+		zlibOutputBuffer[outputSize++] = 0;
+	_fobjCompressedSize = outputSize;
+	_zfob.writeUint32BE('ZFOB');
+	_zfob.writeUint32BE(outputSize + 4);
+	_zfob.writeUint32BE(_fobjSize);
+	_zfob.write(zlibOutputBuffer, outputSize); // compressed FOBJ datas
+	free(zlibOutputBuffer);
+
+	free(_fobj);
+	_fobj = NULL;
+}
+
+/* Copies size bytes of the input through a buffer of fixed size */
+static void copyData(Common::File &input, Common::MemoryWriteStreamDynamic &output, int32 size) {
+	byte buffer[0x8000];
+
+	while (size > 0) {
+		int32 count = MIN<int32>(size, sizeof(buffer));
+		input.read_throwsOnError(buffer, count);
+		output.write(buffer, count);
+		size -= count;
+	}
+}
+
+void CompressScummSan::writeFrame(FrameJob *job, Common::File &output, FrameInfo *frameInfo) {
+	FrameInfo &info = frameInfo[job->_frame];
+
+	output.writeUint32BE('FRME');
+	info.offsetOutput = output.pos();
+	output.writeUint32BE(job->_frameSize);
+
+	output.write(job->_data.getData(), job->_fobjPos);
+	if (job->_zfob.size() != 0) {
+		info.fobjDecompressedSize = job->_fobjSize;
+		info.fobjCompressedSize = job->_fobjCompressedSize;
+		output.write(job->_zfob.getData(), job->_zfob.size());
+	}
+	output.write(job->_data.getData() + job->_fobjPos, job->_data.size() - job->_fobjPos);
 }
 
 void CompressScummSan::handleMapChunk(AudioTrackInfo *audioTrack, Common::File &input) {
@@ -420,8 +480,7 @@ int32 CompressScummSan::handleSaudChunk(AudioTrackInfo *audioTrack, Common::File
 	return size;
 }
 
-void CompressScummSan::handleAudioTrack(int index, int trackId, int frame, int nbframes, Common::File &input, const std::string &outputDir,
-					  const std::string &inputFilename, int &size, int volume, int pan, bool iact) {
+void CompressScummSan::handleAudioTrack(int index, int trackId, int frame, int nbframes, Common::File &input, int &size, int volume, int pan, bool iact) {
 	AudioTrackInfo *audioTrack = NULL;
 	if (index == 0) {
 		audioTrack = allocAudioTrack(trackId, frame);
@@ -448,12 +507,7 @@ void CompressScummSan::handleAudioTrack(int index, int trackId, int frame, int n
 			size -= (input.pos() - pos) + 10;
 			audioTrack->lastFrame = frame;
 		}
-		char tmpPath[1024];
-		sprintf(tmpPath, "%s%s_%04d_%03d.tmp", outputDir.c_str(), inputFilename.c_str(), frame, trackId);
-		audioTrack->file.open(tmpPath, "wb");
-		if (!audioTrack->file.isOpen()) {
-			error("error writing temp file");
-		}
+		audioTrack->open = true;
 	} else {
 		if (!iact)
 			flushTracks(frame);
@@ -468,7 +522,7 @@ void CompressScummSan::handleAudioTrack(int index, int trackId, int frame, int n
 	}
 	byte *buffer = (byte *)malloc(size);
 	input.read_throwsOnError(buffer, size);
-	audioTrack->file.write(buffer, size);
+	audioTrack->data.write(buffer, size);
 	free(buffer);
 	audioTrack->volumes[index] = volume;
 	audioTrack->pans[index] = pan;
@@ -485,11 +539,11 @@ void CompressScummSan::handleAudioTrack(int index, int trackId, int frame, int n
 
 	// FIXME. This doesn't work with Russian FT
 	if ((index + 1) >= nbframes) {
-		audioTrack->file.close();
+		audioTrack->open = false;
 	}
 }
 
-void CompressScummSan::handleDigIACT(Common::File &input, int size, const std::string &outputDir, const std::string &inputFilename,int flags, int track_flags, int frame) {
+void CompressScummSan::handleDigIACT(Common::File &input, int size, int flags, int track_flags, int frame) {
 	int track = input.readUint16LE();
 	int index = input.readUint16LE();
 	int nbframes = input.readUint16LE();
@@ -517,10 +571,10 @@ void CompressScummSan::handleDigIACT(Common::File &input, int size, const std::s
 		error("handleDigIACT() Bad track_flags: %d", track_flags);
 	}
 
-	handleAudioTrack(index, trackId, frame, nbframes, input, outputDir, inputFilename, size, volume, pan, true);
+	handleAudioTrack(index, trackId, frame, nbframes, input, size, volume, pan, true);
 }
 
-void CompressScummSan::handlePSAD(Common::File &input, int size, const std::string &outputDir, const std::string &inputFilename, int frame) {
+void CompressScummSan::handlePSAD(Common::File &input, int size, int frame) {
 	int trackId = input.readUint16LE();
 	int index = input.readUint16LE();
 	int nbframes = input.readUint16LE();
@@ -528,7 +582,7 @@ void CompressScummSan::handlePSAD(Common::File &input, int size, const std::stri
 	int volume = input.readByte();
 	int pan = input.readByte();
 
-	handleAudioTrack(index, trackId, frame, nbframes, input, outputDir, inputFilename, size, volume, pan, false);
+	handleAudioTrack(index, trackId, frame, nbframes, input, size, volume, pan, false);
 }
 
 CompressScummSan::CompressScummSan(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
@@ -536,6 +590,7 @@ CompressScummSan::CompressScummSan(const std::string &name) : CompressionTool(na
 
 	_supportedFormats = AudioFormat(AUDIO_MP3 | AUDIO_VORBIS);
 	_supportsProgressBar = true;
+	_supportsParallelEncoding = true;
 
 	ToolInput input;
 	input.format = "*.san";
@@ -605,8 +660,11 @@ void CompressScummSan::execute() {
 	int32 nbframes = input.readUint16LE(); // number frames
 	output.writeUint16LE(nbframes);
 	output.writeUint16BE(input.readUint16BE()); // unk
-	for (l = 0; l < size - 6; l++) {
-		output.writeByte(input.readByte()); // 0x300 palette + some bytes
+	if (size > 6) {
+		byte *palette = (byte *)malloc(size - 6);
+		input.read_throwsOnError(palette, size - 6);
+		output.write(palette, size - 6); // 0x300 palette + some bytes
+		free(palette);
 	}
 
 	FrameInfo *frameInfo = (FrameInfo *)malloc(sizeof(FrameInfo) * nbframes);
@@ -618,6 +676,7 @@ void CompressScummSan::execute() {
 		_audioTracks[l].stereo = 0;
 		_audioTracks[l].freq = 0;
 		_audioTracks[l].used = 0;
+		_audioTracks[l].open = false;
 		_audioTracks[l].waveDataSize = 0;
 		_audioTracks[l].volumes = 0;
 		_audioTracks[l].pans = 0;
@@ -628,12 +687,23 @@ void CompressScummSan::execute() {
 		_audioTracks[l].sdatSize = 0;
 	}
 
+	_nextTrackToMix = 0;
+	_mixStart = 0;
+	_mix.clear();
+	_waveFile.open(TEMP_MIX, "wb");
+
 	bool tracksCompress = false;
 	int fps = 0;
 	uint32 inputSize = input.size();
 
 	print("Frames: %d", nbframes);
 
+	// With --jobs, the FOBJ chunks of several frames are compressed at the
+	// same time, while the next frames are read and their audio collected.
+	// Only a few frames are in memory at a time, audio tracks are mixed as
+	// soon as they are complete, and the mix is written out as it is final.
+	Common::OrderedJobWindow queue(_numJobs);
+
 	for (l = 0; l < nbframes; l++) {
 		// Compression takes place in this loops, which takes the most time by far
 		updateProgress(l, nbframes);
@@ -642,126 +712,118 @@ void CompressScummSan::execute() {
 		bool first_fobj = true;
 		uint32 tag = input.readUint32BE(); // chunk tag
 		assert(tag == 'FRME');
-		output.writeUint32BE(tag); // FRME
 		int32 frameSize = input.readUint32BE(); // FRME size
 		frameInfo[l].frameSize = frameSize;
-		frameInfo[l].offsetOutput = output.pos();
+		frameInfo[l].offsetOutput = 0;
 		frameInfo[l].fobjDecompressedSize = 0;
 		frameInfo[l].fobjCompressedSize = 0;
 		frameInfo[l].lessIACTSize = 0;
 		frameInfo[l].lessPSADSize = 0;
-		output.writeUint32BE(frameSize);
-		for (;;) {
-			try {
-				tag = input.readUint32BE(); // chunk tag
-			} catch (...) {
-				break;
-			}
 
-			if (input.eos())
-				break;
-			if (tag == 'FRME') {
-				input.seek(-4, SEEK_CUR);
-				break;
-			} else if ((tag == 'FOBJ') && (first_fobj)) {
-				size = input.readUint32BE(); // FOBJ size
-				if ((size & 1) != 0)
-					size++;
-				first_fobj = false;
-				unsigned long outputSize = size + (size / 9) + 100;
-				byte *zlibInputBuffer = (byte *)malloc(size);
-				byte *zlibOutputBuffer = (byte *)malloc(outputSize);
-				for (int k = 0; k < size; k++) {
-					*(zlibInputBuffer + k) = input.readByte(); // FOBJ datas
-				}
-				int result = compress2(zlibOutputBuffer, &outputSize, zlibInputBuffer, size, 9);
-				if (result != Z_OK) {
-					error("compression error");
-				}
-				if ((outputSize & 1) != 0)
-					outputSize++;
-				frameInfo[l].fobjDecompressedSize = size;
-				frameInfo[l].fobjCompressedSize = outputSize;
-				output.writeUint32BE('ZFOB');
-				output.writeUint32BE(outputSize + 4);
-				output.writeUint32BE(size);
-				for (unsigned int k = 0; k < outputSize; k++) {
-					output.writeByte(*(zlibOutputBuffer + k)); // compressed FOBJ datas
+		FrameJob *job = new FrameJob(this, output, frameInfo, l, frameSize);
+		try {
+			for (;;) {
+				try {
+					tag = input.readUint32BE(); // chunk tag
+				} catch (...) {
+					break;
 				}
-				free(zlibInputBuffer);
-				free(zlibOutputBuffer);
-				continue;
-			} else if ((tag == 'IACT') && (!flu_in.isOpen())) {
-				size = input.readUint32BE(); // chunk size
-				int code = input.readUint16LE();
-				int flags = input.readUint16LE();
-				int unk = input.readUint16LE();
-				int track_flags = input.readUint16LE();
-				if ((code == 8) && (track_flags == 0) && (unk == 0) && (flags == 46)) {
-					handleComiIACT(input, size, outpath.getPath(), inpath.getFullName());
-				} else if ((code == 8) && (track_flags != 0) && (unk == 0) && (flags == 46)) {
-					handleDigIACT(input, size, outpath.getPath(), inpath.getFullName(), flags, track_flags, l);
+
+				if (input.eos())
+					break;
+				if (tag == 'FRME') {
+					input.seek(-4, SEEK_CUR);
+					break;
+				} else if ((tag == 'FOBJ') && (first_fobj)) {
+					size = input.readUint32BE(); // FOBJ size
+					if ((size & 1) != 0)
+						size++;
+					first_fobj = false;
+					job->_fobj = (byte *)malloc(size);
+					job->_fobjSize = size;
+					job->_fobjPos = job->_data.size();
+					input.read_throwsOnError(job->_fobj, size); // FOBJ datas
+					continue;
+				} else if ((tag == 'IACT') && (!flu_in.isOpen())) {
+					size = input.readUint32BE(); // chunk size
+					int code = input.readUint16LE();
+					int flags = input.readUint16LE();
+					int unk = input.readUint16LE();
+					int track_flags = input.readUint16LE();
+					if ((code == 8) && (track_flags == 0) && (unk == 0) && (flags == 46)) {
+						handleComiIACT(input, size);
+					} else if ((code == 8) && (track_flags != 0) && (unk == 0) && (flags == 46)) {
+						handleDigIACT(input, size, flags, track_flags, l);
+						tracksCompress = true;
+						fps = 12;
+					} else {
+						input.seek(-12, SEEK_CUR);
+						goto skip;
+					}
+
+					if ((size & 1) != 0) {
+						input.seek(1, SEEK_CUR);
+						size++;
+					}
+					frameInfo[l].lessIACTSize += size + 8;
+					continue;
+				} else if ((tag == 'PSAD') && (!flu_in.isOpen())) {
+					size = input.readUint32BE(); // chunk size
+					handlePSAD(input, size, l);
+					if ((size & 1) != 0) {
+						input.seek(1, SEEK_CUR);
+						size++;
+					}
+					frameInfo[l].lessPSADSize += size + 8;
 					tracksCompress = true;
-					fps = 12;
+					fps = 10;
 				} else {
-					input.seek(-12, SEEK_CUR);
-					goto skip;
-				}
-
-				if ((size & 1) != 0) {
-					input.seek(1, SEEK_CUR);
-					size++;
-				}
-				frameInfo[l].lessIACTSize += size + 8;
-				continue;
-			} else if ((tag == 'PSAD') && (!flu_in.isOpen())) {
-				size = input.readUint32BE(); // chunk size
-				handlePSAD(input, size, outpath.getPath(), inpath.getFullName(), l);
-				if ((size & 1) != 0) {
-					input.seek(1, SEEK_CUR);
-					size++;
-				}
-				frameInfo[l].lessPSADSize += size + 8;
-				tracksCompress = true;
-				fps = 10;
-			} else {
 skip:
-				size = input.readUint32BE(); // chunk size
+					size = input.readUint32BE(); // chunk size
 
-				// Some files have garbage at the end
-				if ((uint32)(size + input.pos()) > inputSize) {
-					print("Skipping rest of the file (%d bytes)", inputSize - input.pos());
-					break;
-				}
+					// Some files have garbage at the end
+					if ((uint32)(size + input.pos()) > inputSize) {
+						print("Skipping rest of the file (%d bytes)", inputSize - input.pos());
+						break;
+					}
 
-				output.writeUint32BE(tag);
-				output.writeUint32BE(size);
-				if ((size & 1) != 0)
-					size++;
-				for (int k = 0; k < size; k++) {
-					output.writeByte(input.readByte()); // chunk datas
+					job->_data.writeUint32BE(tag);
+					job->_data.writeUint32BE(size);
+					if ((size & 1) != 0)
+						size++;
+					copyData(input, job->_data, size); // chunk datas
 				}
 			}
+			if (!job->_fobj)
+				job->_fobjPos = job->_data.size();
+		} catch (...) {
+			delete job;
+			throw;
 		}
+
+		queue.push(job);
+
+		if (tracksCompress)
+			mixTracks(l + 1, fps, false);
 	}
 
+	queue.completeAll();
+
 	if (tracksCompress) {
-		prepareForMixing(outpath.getPath(), inpath.getFullName());
 		assert(fps);
-		mixing(outpath.getPath(), inpath.getFullName(), nbframes, fps);
+		mixTracks(nbframes, fps, true);
 	}
 
-	if (_waveTmpFile.isOpen()) {
-		std::string tmpPath = outpath.getPath() + inpath.getFullName();
+	uint32 waveSize = _waveFile.pos();
+	_waveFile.close();
+	if (waveSize != 0) {
+		Common::Filename audioPath(outpath.getPath() + inpath.getFullName());
+		audioPath.setExtension(_format == AUDIO_VORBIS ? ".ogg" : ".mp3");
 		setRawAudioType(true, true, 16); // LE, stereo, 16-bit
 
-		if (_format == AUDIO_VORBIS)
-			encodeSanWaveWithOgg(tmpPath);
-		else
-			encodeSanWaveWithLame(tmpPath);
-		tmpPath += ".raw";
-		Common::removeFile(tmpPath.c_str());
+		encodeAudio(TEMP_MIX, true, 22050, audioPath.getFullPath().c_str(), _format);
 	}
+	Common::removeFile(TEMP_MIX);
 
 	input.close();
 
@@ -25,6 +25,8 @@
 
 #include "compress.h"
 
+#include <vector>
+
 enum {
 	COMPRESS_SCUMM_SAN_MAX_TRACKS = 150
 };
@@ -51,7 +53,8 @@ public:
 		bool stereo;
 		int freq;
 		bool used;
-		Common::File file;
+		bool open;
+		Common::MemoryWriteStreamDynamic data;
 		int waveDataSize;
 		int *volumes;
 		int *pans;
@@ -65,26 +68,32 @@ public:
 protected:
 	byte _IACToutput[0x1000];
 	int _IACTpos;
-	Common::File _waveTmpFile;
-	int32 _waveDataSize;
+	Common::File _waveFile;
 	AudioTrackInfo _audioTracks[COMPRESS_SCUMM_SAN_MAX_TRACKS];
+	int _nextTrackToMix;
+
+	// The part of the wave data which tracks are still mixed into
+	std::vector<int16> _mix;
+	uint32 _mixStart;
+
+	class FrameJob;
 
-	void encodeSanWaveWithOgg(const std::string &filename);
-	void encodeSanWaveWithLame(const std::string &filename);
-	void writeToTempWaveFile(const std::string &fileName, byte *output_data, unsigned int size);
-	void decompressComiIACT(const std::string &fileName, byte *output_data, byte *d_src, int bsize);
-	void handleComiIACT(Common::File &input, int size, const std::string &outputDir, const std::string &inputFilename);
+	void writeToWaveData(byte *output_data, unsigned int size);
+	void decompressComiIACT(byte *output_data, byte *d_src, int bsize);
+	void handleComiIACT(Common::File &input, int size);
 	AudioTrackInfo *allocAudioTrack(int trackId, int frame);
 	AudioTrackInfo *findAudioTrack(int trackId);
 	void flushTracks(int frame);
-	void prepareForMixing(const std::string &outputDir, const std::string &inputFilename);
-	void mixing(const std::string &outputDir, const std::string &inputFilename, int frames, int fps);
+	int16 *convertTrack(const AudioTrackInfo &track);
+	void mixTracks(int frame, int fps, bool finish);
+	void mixTrack(AudioTrackInfo &track, int fps);
+	void flushMix(uint32 end);
+	void writeFrame(FrameJob *job, Common::File &output, FrameInfo *frameInfo);
 	void handleMapChunk(AudioTrackInfo *audioTrack, Common::File &input);
 	int32 handleSaudChunk(AudioTrackInfo *audioTrack, Common::File &input);
-	void handleAudioTrack(int index, int trackId, int frame, int nbframes, Common::File &input, const std::string &outputDir,
-		const std::string &inputFilename, int &size, int volume, int pan, bool iact);
-	void handleDigIACT(Common::File &input, int size, const std::string &outputDir, const std::string &inputFilename,int flags, int track_flags, int frame);
-	void handlePSAD(Common::File &input, int size, const std::string &outputDir, const std::string &inputFilename, int frame);
+	void handleAudioTrack(int index, int trackId, int frame, int nbframes, Common::File &input, int &size, int volume, int pan, bool iact);
+	void handleDigIACT(Common::File &input, int size, int flags, int track_flags, int frame);
+	void handlePSAD(Common::File &input, int size, int frame);
 };
 
 #endif
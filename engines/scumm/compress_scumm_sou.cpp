@@ -21,6 +21,7 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "compress_scumm_sou.h"
@@ -33,6 +34,49 @@ static const char f_hdr[] = {
 #define TEMP_DAT	"tempfile.dat"
 #define TEMP_IDX	"tempfile.idx"
 
+/**
+ * A voice entry: the index entry, the VCTL tags and the encoded voice.
+ * They are only written once the voice has been encoded, as the index
+ * refers to positions in the sound data.
+ */
+class SouVoiceJob : public EncodeJob {
+public:
+	SouVoiceJob(Common::File &idx, Common::File &snd, uint32 pos, char *tags, uint32 tagsSize) :
+		_idx(idx), _snd(snd), _pos(pos), _tags(tags), _tagsSize(tagsSize), _hasVoice(false) {}
+
+	~SouVoiceJob() {
+		free(_tags);
+	}
+
+	void setVoice(char *rawData, int length, int samplerate) {
+		setRawData(rawData, length, samplerate);
+		_hasVoice = true;
+	}
+
+	virtual void finish(const byte *encoded, uint32 size) {
+		_idx.writeUint32BE(_pos);
+		_idx.writeUint32BE((uint32)_snd.pos());
+		_idx.writeUint32BE(_tagsSize);
+		if (_tagsSize > 0)
+			_snd.write(_tags, _tagsSize);
+
+		if (!_hasVoice)
+			return;
+
+		/* Append the converted data to the master output file */
+		if (size > 0)
+			_snd.write(encoded, size);
+		_idx.writeUint32BE(size);
+	}
+
+private:
+	Common::File &_idx, &_snd;
+	uint32 _pos;
+	char *_tags;
+	uint32 _tagsSize;
+	bool _hasVoice;
+};
+
 
 CompressScummSou::CompressScummSou(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	ToolInput input;
@@ -40,11 +84,14 @@ CompressScummSou::CompressScummSou(const std::string &name) : CompressionTool(na
 	_inputPaths.push_back(input);
 
 	_shorthelp = "Used to compress .sou files of SCUMM games.";
-	_helptext = "\nUsage: " + getName() + " [mode] [mode params] monster.sou\n";
+	_helptext = "\nUsage: " + getName() + " [mode] [mode params] [--jobs <n>] monster.sou\n";
 	_supportsProgressBar = true;
+	_supportsParallelEncoding = true;
 }
 
 void CompressScummSou::end_of_file() {
+	flushEncodeQueue();
+
 	int idx_size = _output_idx.pos();
 	size_t size;
 	char buf[2048];
@@ -71,8 +118,6 @@ void CompressScummSou::end_of_file() {
 	/* And some clean-up :-) */
 	Common::removeFile(TEMP_IDX);
 	Common::removeFile(TEMP_DAT);
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(tempEncoded);
 }
 
 void CompressScummSou::append_byte(int size, char buf[]) {
@@ -83,11 +128,11 @@ void CompressScummSou::append_byte(int size, char buf[]) {
 }
 
 bool CompressScummSou::get_part() {
-	uint32 tot_size;
-	int size;
 	char buf[2048];
 	int pos = _input.pos();
 	uint32 tags;
+	char *tagsData;
+	int length, samplerate;
 
 	try {
 		/* Scan for the VCTL header */
@@ -106,44 +151,38 @@ bool CompressScummSou::get_part() {
 	assert(tags >= 8);
 	tags -= 8;
 
-	_output_idx.writeUint32BE((uint32)pos);
-	_output_idx.writeUint32BE((uint32)_output_snd.pos());
-	_output_idx.writeUint32BE(tags);
-	// FIXME/TODO: Copying "tags" bytes one by one is
-	// inefficient; should use a buffer (say, "buf") to copy
-	// larger amounts at a time.
-	while (tags > 0) {
-		_output_snd.writeChar(_input.readChar());
-		tags--;
-	}
+	tagsData = (char *)malloc(tags);
+	if (tags > 0)
+		_input.read_throwsOnError(tagsData, tags);
+
+	SouVoiceJob *job = new SouVoiceJob(_output_idx, _output_snd, (uint32)pos, tagsData, tags);
 
 	/* The German Sam & Max MONSTER.SOU seems to have a VCTL without an
 	 * associated SOU entry at the end (Bug ID 3280674). 
 	 */
-	if (_input.pos() == _file_size)
+	if (_input.pos() == _file_size) {
+		queueEncode(job);
 		return false;
-
-	_input.read_throwsOnError(buf, 8);
-	if (!memcmp(buf, "Creative", 8))
-		_input.seek(18, SEEK_CUR);
-	else if (!memcmp(buf, "VTLK", 4))
-		_input.seek(26, SEEK_CUR);
-	else
-		error("Unexpected data encountered");
-	print("Voice file found (pos = %d) :", pos);
-
-	/* Convert the VOC data */
-	extractAndEncodeVOC(TEMP_RAW, _input, _format);
-
-	/* Append the converted data to the master output file */
-	Common::File f(tempEncoded, "rb");
-	tot_size = 0;
-	while ((size = f.read_noThrow(buf, 2048)) > 0) {
-		tot_size += size;
-		_output_snd.write(buf, size);
 	}
 
-	_output_idx.writeUint32BE(tot_size);
+	try {
+		_input.read_throwsOnError(buf, 8);
+		if (!memcmp(buf, "Creative", 8))
+			_input.seek(18, SEEK_CUR);
+		else if (!memcmp(buf, "VTLK", 4))
+			_input.seek(26, SEEK_CUR);
+		else
+			error("Unexpected data encountered");
+		print("Voice file found (pos = %d) :", pos);
+
+		/* Read the VOC data, it is converted by the encode queue */
+		char *vocData = extractVOC(_input, length, samplerate);
+		job->setVoice(vocData, length, samplerate);
+	} catch (...) {
+		delete job;
+		throw;
+	}
+	queueEncode(job);
 
 	updateProgress(_input.pos(), _file_size);
 
@@ -54,7 +54,6 @@ void ExtractScummMac::execute() {
 	unsigned long file_off, file_len;
 	unsigned long data_file_len;
 	char file_name[0x20];
-	char *buf;
 	unsigned long i;
 	int j;
 
@@ -128,18 +127,10 @@ void ExtractScummMac::execute() {
 		}
 
 		/* Write a file */
-		ifp.seek(file_off, SEEK_SET);
-
 		outpath.setFullName(file_name);
 		Common::File ofp(outpath, "wb");
 
-		if (!(buf = (char *)malloc(file_len))) {
-			error("Could not allocate %ld bytes of memory.", file_len);
-		}
-
-		ifp.read_throwsOnError(buf, file_len);
-		ofp.write(buf, file_len);
-		free(buf);
+		ofp.write(ifp.view(file_off, file_len), file_len);
 	}
 }
 
@@ -376,23 +376,23 @@ void CompressSword1::guessEndianness(int16 *data, int16 length) {
 	setRawAudioType(_speechEndianness == LittleEndian, false, 16);
 }
 
-uint8 *CompressSword1::convertData(uint8 *rawData, uint32 rawSize, uint32 *resSize) {
-	uint8 *resBuf;
-
-	uint32 size;
-	Common::File temp(TEMP_RAW, "wb");
-	size = temp.write(rawData, rawSize);
-	assert(size == rawSize);
-	temp.close();
-	encodeAudio(TEMP_RAW, true, 11025, _audioOuputFilename.c_str(), _format);
-	temp.open(_audioOuputFilename, "rb");
-	temp.seek(0, SEEK_END);
-	*resSize = size = temp.pos();
-	resBuf = (uint8*)malloc(size);
-	temp.seek(0, SEEK_SET);
-	temp.read_throwsOnError(resBuf, size);
-	return resBuf;
-}
+/**
+ * A speech sample, stored in the cluster once it has been encoded.
+ */
+class SpeechSampleJob : public EncodeJob {
+public:
+	SpeechSampleJob(Common::File &cl3, uint32 *indexEntry) : _cl3(cl3), _indexEntry(indexEntry) {}
+
+	virtual void finish(const byte *encoded, uint32 size) {
+		_indexEntry[0] = _cl3.pos();
+		_indexEntry[1] = size;
+		_cl3.write(encoded, size);
+	}
+
+private:
+	Common::File &_cl3;
+	uint32 *_indexEntry;
+};
 
 void CompressSword1::convertClu(Common::File &clu, Common::File &cl3) {
 	uint32 *cowHeader;
@@ -400,8 +400,8 @@ void CompressSword1::convertClu(Common::File &clu, Common::File &cl3) {
 	uint32 numSamples;
 	uint32 cnt;
 	uint32 *cl3Index, *sampleIndex;
-	uint32 smpSize, mp3Size;
-	uint8 *smpData, *mp3Data;
+	uint32 smpSize;
+	uint8 *smpData;
 
 	uint32 headerSize = clu.readUint32LE();
 
@@ -441,18 +441,15 @@ void CompressSword1::convertClu(Common::File &clu, Common::File &cl3) {
 			if ((!smpData) || (!smpSize))
 				error("unable to handle speech sample %d!", cnt);
 
-			mp3Data = convertData(smpData, smpSize, &mp3Size);
-			cl3Index[cnt << 1] = cl3.pos();
-			cl3Index[(cnt << 1) | 1] = mp3Size;
-			cl3.write(mp3Data, mp3Size);
-
-			free(smpData);
-			free(mp3Data);
+			SpeechSampleJob *job = new SpeechSampleJob(cl3, cl3Index + (cnt << 1));
+			job->setRawData((char *)smpData, smpSize, 11025);
+			queueEncode(job);
 		} else {
 			cl3Index[cnt << 1] = cl3Index[(cnt << 1) | 1] = 0;
 			print("sample %5d: skipped", cnt);
 		}
 	}
+	flushEncodeQueue();
 	cl3.seek((numRooms + 2) * 4, SEEK_SET);	/* Now write the sample index into the CL3 file */
 	for (cnt = 0; cnt < numSamples * 2; cnt++)
 		cl3.writeUint32LE(cl3Index[cnt]);
@@ -522,8 +519,6 @@ void CompressSword1::compressSpeech(const Common::Filename *inpath, const Common
 		print("Converting CD %d...", i);
 		convertClu(clu, cl3);
 	}
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(_audioOuputFilename.c_str());
 }
 
 void CompressSword1::compressMusic(const Common::Filename *inpath, const Common::Filename *outpath) {
@@ -716,13 +711,14 @@ CompressSword1::CompressSword1(const std::string &name) : CompressionTool(name,
 	_speechEndianness = LittleEndian;
 
 	_supportsProgressBar = true;
+	_supportsParallelEncoding = true;
 
 	ToolInput input;
 	input.format = "*.*";
 	_inputPaths.push_back(input);
 
 	_shorthelp = "Used to compress Broken Sword 1 data files.";
-	_helptext = "\nUsage: " + getName() + " [mode] [mode params] [-o outputdir] [only] <inputfile>\n"
+	_helptext = "\nUsage: " + getName() + " [mode] [mode params] [--jobs <n>] [-o outputdir] [only] <inputfile>\n"
 		"only can be either:\n"
 		" --speech-only  only encode speech clusters\n"
 		" --music-only   only encode music files\n\n"
@@ -744,21 +740,6 @@ void CompressSword1::execute() {
 	Common::Filename inpath(_inputPaths[0].path);
 	Common::Filename &outpath = _outputPath;
 
-	switch (_format) {
-	case AUDIO_MP3:
-		_audioOuputFilename = TEMP_MP3;
-		break;
-	case AUDIO_VORBIS:
-		_audioOuputFilename = TEMP_OGG;
-		break;
-	case AUDIO_FLAC:
-		_audioOuputFilename = TEMP_FLAC;
-		break;
-	default:
-		throw ToolException("Unknown audio format");
-		break;
-	}
-
 	if (outpath.empty())
 		// Extensions change between the in/out files, so we can use the same directory
 		outpath = inpath;
@@ -21,7 +21,11 @@
  */
 
 
+#include <stdlib.h>
+
 #include "compress_sword2.h"
+#include "common/endian.h"
+#include "common/util.h"
 
 #define TEMP_IDX	"tempfile.idx"
 #define TEMP_DAT	"tempfile.dat"
@@ -46,6 +50,38 @@ uint32 CompressSword2::append_to_file(Common::File &f1, const char *filename) {
 	return orig_length;
 }
 
+/**
+ * A speech or music sample. The index entry refers to the position of the
+ * encoded sample, so both are written once it has been encoded.
+ */
+class ClusterSampleJob : public EncodeJob {
+public:
+	ClusterSampleJob(Common::File &idx, Common::File &snd, uint32 &totalSize, uint32 length, bool empty = false) :
+		_idx(idx), _snd(snd), _totalSize(totalSize), _length(length), _empty(empty) {}
+
+	virtual void finish(const byte *encoded, uint32 size) {
+		if (_empty) {
+			_idx.writeUint32LE(0);
+			_idx.writeUint32LE(0);
+			_idx.writeUint32LE(0);
+			return;
+		}
+
+		_snd.write(encoded, size);
+
+		_idx.writeUint32LE(_totalSize);
+		_idx.writeUint32LE(_length);
+		_idx.writeUint32LE(size);
+		_totalSize += size;
+	}
+
+private:
+	Common::File &_idx, &_snd;
+	uint32 &_totalSize;
+	uint32 _length;
+	bool _empty;
+};
+
 #define GetCompressedShift(n)      ((n) >> 4)
 #define GetCompressedSign(n)       (((n) >> 3) & 1)
 #define GetCompressedAmplitude(n)  ((n) & 7)
@@ -57,8 +93,10 @@ CompressSword2::CompressSword2(const std::string &name) : CompressionTool(name,
 	input.format = "*.clu";
 	_inputPaths.push_back(input);
 
+	_supportsParallelEncoding = true;
+
 	_shorthelp = "Used to compress Broken Sword 2 data files.";
-	_helptext = "\nUsage: " + getName() + " [params] <file>\n\n";
+	_helptext = "\nUsage: " + getName() + " [params] [--jobs <n>] <file>\n\n";
 }
 
 void CompressSword2::execute() {
@@ -76,15 +114,12 @@ void CompressSword2::execute() {
 
 	switch (_format) {
 	case AUDIO_MP3:
-		_audioOutputFilename = TEMP_MP3;
 		outpath.setExtension(".cl3");
 		break;
 	case AUDIO_VORBIS:
-		_audioOutputFilename = TEMP_OGG;
 		outpath.setExtension(".clg");
 		break;
 	case AUDIO_FLAC:
-		_audioOutputFilename = TEMP_FLAC;
 		outpath.setExtension(".clf");
 		break;
 	default:
@@ -113,7 +148,6 @@ void CompressSword2::execute() {
 		updateProgress(i, indexSize);
 
 		uint32 pos;
-		uint32 enc_length;
 
 		_input.seek(8 * (i + 1), SEEK_SET);
 
@@ -122,8 +156,7 @@ void CompressSword2::execute() {
 
 		if (pos != 0 && length != 0) {
 			uint16 prev;
-
-			Common::File f(TEMP_WAV, "wb");
+			char *rawData;
 
 			/*
 			 * The number of decodeable 16-bit samples is one less
@@ -132,25 +165,8 @@ void CompressSword2::execute() {
 
 			length--;
 
-			/*
-			 * Back when this tool was written, encodeAudio() had
-			 * no way of encoding 16-bit data, so it was simpler to
-			 * output a WAV file.
-			 */
-
-			f.writeUint32BE(0x52494646);	/* "RIFF" */
-			f.writeUint32LE(2 * length + 36);
-			f.writeUint32BE(0x57415645);	/* "WAVE" */
-			f.writeUint32BE(0x666d7420);	/* "fmt " */
-			f.writeUint32LE(16);
-			f.writeUint16LE(1);				/* PCM */
-			f.writeUint16LE(1);				/* mono */
-			f.writeUint32LE(22050);			/* sample rate */
-			f.writeUint32LE(44100);			/* bytes per second */
-			f.writeUint16LE(2);				/* basic block size */
-			f.writeUint16LE(16);			/* sample width */
-			f.writeUint32BE(0x64617461);	/* "data" */
-			f.writeUint32LE(2 * length);
+			/* The first sample is always there, even if the length says otherwise */
+			rawData = (char *)malloc(2 * MAX<uint32>(length, 1));
 
 			_input.seek(pos, SEEK_SET);
 
@@ -161,7 +177,7 @@ void CompressSword2::execute() {
 
 			prev = _input.readUint16LE();
 
-			f.writeUint16LE(prev);
+			WRITE_LE_UINT16(rawData, prev);
 
 			for (j = 1; j < (int)length; j++) {
 				byte data;
@@ -173,26 +189,23 @@ void CompressSword2::execute() {
 				else
 					out = prev + (GetCompressedAmplitude(data) << GetCompressedShift(data));
 
-				f.writeUint16LE(out);
+				WRITE_LE_UINT16(rawData + 2 * j, out);
 				prev = out;
 			}
 
-			f.close();
-
-			encodeAudio(TEMP_WAV, false, -1, tempEncoded, _format);
-			enc_length = append_to_file(_output_snd, tempEncoded);
+			/* 16-bit mono at 22050 Hz */
+			setRawAudioType(true, false, 16);
 
-			_output_idx.writeUint32LE(totalSize);
-			_output_idx.writeUint32LE(length);
-			_output_idx.writeUint32LE(enc_length);
-			totalSize = totalSize + enc_length;
+			ClusterSampleJob *job = new ClusterSampleJob(_output_idx, _output_snd, totalSize, length);
+			job->setRawData(rawData, 2 * length, 22050);
+			queueEncode(job);
 		} else {
-			_output_idx.writeUint32LE(0);
-			_output_idx.writeUint32LE(0);
-			_output_idx.writeUint32LE(0);
+			queueEncode(new ClusterSampleJob(_output_idx, _output_snd, totalSize, 0, true));
 		}
 	}
 
+	flushEncodeQueue();
+
 	_output_snd.close();
 	_output_idx.close();
 
@@ -205,10 +218,6 @@ void CompressSword2::execute() {
 
 	Common::removeFile(TEMP_DAT);
 	Common::removeFile(TEMP_IDX);
-	Common::removeFile(TEMP_MP3);
-	Common::removeFile(TEMP_OGG);
-	Common::removeFile(TEMP_FLAC);
-	Common::removeFile(TEMP_WAV);
 }
 
 #ifdef STANDALONE_MAIN
@@ -34,7 +34,6 @@ public:
 protected:
 
 	Common::File _input, _output_snd, _output_idx;
-	std::string _audioOutputFilename;
 
 	uint32 append_to_file(Common::File &f1, const char *filename);
 };
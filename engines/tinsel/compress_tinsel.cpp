@@ -26,6 +26,7 @@
 
 #include "compress.h"
 #include "common/endian.h"
+#include "sound/adpcm.h"
 
 #include "compress_tinsel.h"
 
@@ -46,8 +47,56 @@
 
 #define TEMP_IDX "compressed.idx"
 #define TEMP_SMP "compressed.smp"
-#define TEMP_RAW "tempfile.raw"
-#define TEMP_ENC "tempfile.enc"
+
+// Index entries point into the sample file, and the sample file holds the size of each
+// encoded sample, so they are written once all samples before them have been encoded.
+
+/* Writes an index entry: either the current position in output_smp, or a fixed value */
+class TinselIndexJob : public EncodeJob {
+public:
+	TinselIndexJob(Common::File &output_idx, Common::File &output_smp) :
+		_output_idx(output_idx), _output_smp(output_smp), _isOffset(true), _isSignature(false), _value(0), _sampleCount(0) {}
+
+	/* Index 0 holds the data format */
+	void setSignature(uint32 signature) { _isOffset = false; _isSignature = true; _value = signature; }
+	void setValue(uint32 value) { _isOffset = false; _value = value; }
+	/* Multiple samples start with their count */
+	void setSampleCount(uint32 sampleCount) { _sampleCount = sampleCount; }
+
+	virtual void finish(const byte *encoded, uint32 size) {
+		if (_isOffset)
+			_output_idx.writeUint32LE(_output_smp.pos());
+		else if (_isSignature)
+			_output_idx.writeUint32BE(_value);
+		else
+			_output_idx.writeUint32LE(_value);
+
+		if (_sampleCount)
+			_output_smp.writeUint32LE(_sampleCount);
+	}
+
+private:
+	Common::File &_output_idx, &_output_smp;
+	bool _isOffset, _isSignature;
+	uint32 _value;
+	uint32 _sampleCount;
+};
+
+/* Appends an encoded sample and its size to output_smp */
+class TinselSampleJob : public EncodeJob {
+public:
+	TinselSampleJob(Common::File &output_smp) : _output_smp(output_smp) {}
+
+	virtual void finish(const byte *encoded, uint32 size) {
+		// Write size of compressed data
+		_output_smp.writeUint32LE(size);
+		// Write actual data
+		_output_smp.write(encoded, size);
+	}
+
+private:
+	Common::File &_output_smp;
+};
 
 CompressTinsel::CompressTinsel(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	_supportsProgressBar = true;
@@ -60,198 +109,65 @@ CompressTinsel::CompressTinsel(const std::string &name) : CompressionTool(name,
 	input2.format = "*.idx";
 	_inputPaths.push_back(input2);
 
+	_supportsParallelEncoding = true;
+
 	_shorthelp = "Used to compress Tinsel .smp files.";
-	_helptext = "\nUsage: " + getName() + " [mode-params] [-o outputname] <infile.smp> <infile.idx>\n";
+	_helptext = "\nUsage: " + getName() + " [mode-params] [--jobs <n>] [-o outputname] <infile.smp> <infile.idx>\n";
+
+	_inBuffer = NULL;
+	_inBufferSize = 0;
+}
+
+CompressTinsel::~CompressTinsel() {
+	free(_inBuffer);
 }
 
 /* Converts raw-data sample in input_smp of size SampleSize to requested dataformat and writes to output_smp */
 void CompressTinsel::convertTinselRawSample (uint32 sampleSize) {
-	uint32 copyLeft = 0;
-	uint32 doneRead = 0;
-	char buffer[2048];
-	Common::File curFileHandle;
+	char *rawData;
 
 	print("Assuming DW1 sample being 8-bit raw...");
 
-	Common::removeFile(TEMP_RAW); Common::removeFile(TEMP_ENC);
-	curFileHandle.open(TEMP_RAW, "wb");
-	copyLeft = sampleSize;
-	while (copyLeft > 0) {
-		doneRead = _input_smp.read_noThrow(buffer, copyLeft > sizeof(buffer) ? sizeof(buffer) : copyLeft);
-		if (doneRead <= 0)
-			break;
-		copyLeft -= (int)doneRead;
-		curFileHandle.write(buffer, doneRead);
-	}
-	curFileHandle.close();
+	rawData = (char *)malloc(sampleSize);
+	sampleSize = _input_smp.read_noThrow(rawData, sampleSize);
 
 	// Encode this raw data...
 	setRawAudioType(true, false, 8); // LE, mono, 8-bit (??)
-	encodeAudio(TEMP_RAW, true, 22050, TEMP_ENC, _format);
-
-	// Append compressed data to output_smp
-	curFileHandle.open(TEMP_ENC, "rb");
-	curFileHandle.seek(0, SEEK_END);
-	copyLeft = curFileHandle.pos();
-	curFileHandle.seek(0, SEEK_SET);
-	// Write size of compressed data
-	_output_smp.writeUint32LE(copyLeft);
-	// Write actual data
-	while (copyLeft > 0) {
-		doneRead = curFileHandle.read_noThrow(buffer, copyLeft > sizeof(buffer) ? sizeof(buffer) : copyLeft);
-		if (doneRead <= 0)
-			break;
-		copyLeft -= (int)doneRead;
-		_output_smp.write(buffer, doneRead);
-	}
+	TinselSampleJob *job = new TinselSampleJob(_output_smp);
+	job->setRawData(rawData, sampleSize, 22050);
+	queueEncode(job);
 }
 
-static const double TinselFilterTable[4][2] = {
-	{0, 0 },
-	{0.9375, 0},
-	{1.796875, -0.8125},
-	{1.53125, -0.859375}
-};
-
-template<typename T> inline T CLIP (T v, T amin, T amax) {
-	if (v < amin)
-		return amin;
-	else if (v > amax)
-		return amax;
-	else
-		return v;
+/* Returns a buffer of at least size bytes, which is reused by later calls */
+byte *CompressTinsel::getInputBuffer(uint32 size) {
+	if (size > _inBufferSize) {
+		free(_inBuffer);
+		_inBuffer = (byte *)malloc(size);
+		if (!_inBuffer)
+			error("Out of memory");
+		_inBufferSize = size;
+	}
+	return _inBuffer;
 }
 
 /* Converts ADPCM-data sample in input_smp of size SampleSize to requested dataformat and writes to output_smp */
-/* Quick hack together from adpcm.cpp */
 void CompressTinsel::convertTinselADPCMSample (uint32 sampleSize) {
-	byte *inBuffer, *inPos;
-	int16 *outBuffer, *outPos;
-	double predictor = 0;
-	double k0 = 0, k1 = 0;
-	double d0 = 0, d1 = 0;
-	uint32 blockAlign, blockPos;
-	uint16 chunkData = 0;
-	int16 chunkWord = 0;
-	uint8 headerByte, filterVal, chunkPos = 0;
-	const double eVal = 1.032226562;
-	uint32 decodeLeft = 0, decodedCount = 0;
-	uint32 uncompressedSize;
-	double sample;
-
-	uint32 copyLeft = 0;
-	uint32 doneRead = 0;
-	char buffer[2048];
-	Common::File curFileHandle;
-
 	print("Assuming DW2 sample using ADPCM 6-bit, decoding to 16-bit raw...");
 
-	// Allocate buffer for the ADPCM-compressed sample
-	inBuffer = (byte *)malloc(sampleSize);
-	if (!inBuffer) {
-		print("malloc failed!");
-		return;
-	}
-
-	// Allocate buffer for uncompressed sample data (3 bytes will be uncompressed to 8 bytes)
-	uncompressedSize = (sampleSize/3)*4*2+16;
-	outBuffer = (int16 *)malloc(uncompressedSize);
-	if (!outBuffer) {
-		print("malloc failed!");
-		free(inBuffer);
-		return;
-	}
-
+	byte *inBuffer = getInputBuffer(sampleSize);
 	_input_smp.read_throwsOnError(inBuffer, sampleSize);
 
-	// 1 channel, 22050 rate, block align 24,
-	blockAlign = 24; // Fixed for Tinsel 6-bit
-	blockPos = blockAlign; // To make sure first header is read
-
-	inPos = inBuffer; outPos = outBuffer;
-	decodeLeft = sampleSize;
-	while (decodeLeft > 0) {
-		if (blockPos == blockAlign) {
-			// read Tinsel header
-			headerByte = *inPos; inPos++; decodeLeft--;
-			filterVal = (headerByte & 0xC0) >> 6;
-
-			if ((headerByte & 0x20) != 0) {
-				//Lower 6 bit are negative
-				// Negate
-				headerByte = ~(headerByte | 0xC0) + 1;
-				predictor = 1 << headerByte;
-			} else {
-				// Lower 6 bit are positive
-				// Truncate
-				headerByte &= 0x1F;
-				predictor = ((double) 1.0) / (1 << headerByte);
-			}
-			k0 = TinselFilterTable[filterVal][0];
-			k1 = TinselFilterTable[filterVal][1];
-			blockPos = 0;
-			chunkPos = 0;
-		}
-
-		switch (chunkPos) {
-		case 0:
-			chunkData = *inPos; inPos++; decodeLeft--;
-			chunkWord = (chunkData << 8) & 0xFC00;
-			break;
-		case 1:
-			chunkData = (chunkData << 8) | *inPos; inPos++; decodeLeft--;
-			blockPos++;
-			chunkWord = (chunkData << 6) & 0xFC00;
-			break;
-		case 2:
-			chunkData = (chunkData << 8) | *inPos; inPos++; decodeLeft--;
-			blockPos++;
-			chunkWord = (chunkData << 4) & 0xFC00;
-			break;
-		case 3:
-			chunkData = chunkData << 8;
-			blockPos++;
-			chunkWord = (chunkData << 2) & 0xFC00;
-			break;
-		}
-		sample = chunkWord;
-		sample *= eVal * predictor;
-		sample += (d0 * k0) + (d1 * k1);
-		d1 = d0;
-		d0 = sample;
-		*outPos = (int16) CLIP<double>(sample, -32768.0, 32767.0); outPos++;
-		decodedCount++;
-		chunkPos = (chunkPos + 1) % 4;
-	}
-
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(TEMP_ENC);
-
-	curFileHandle.open(TEMP_RAW, "wb");
-	curFileHandle.write(outBuffer, decodedCount*2);
-
-	free(inBuffer);
-	free(outBuffer);
+	// The encode job takes over the decoded sample
+	byte *outBuffer = (byte *)malloc(8 * (sampleSize / 3 + 1));
+	if (!outBuffer)
+		error("Out of memory");
+	uint32 decodedCount = Audio::decodeTinsel6(outBuffer, inBuffer, sampleSize);
 
 	// Encode this raw data...
 	setRawAudioType(true, false, 16); // LE, mono, 16-bit
-	encodeAudio(TEMP_RAW, true, 22050, TEMP_ENC, _format);
-
-	// Append compressed data to output_smp
-	curFileHandle.open(TEMP_ENC, "rb");
-	curFileHandle.seek(0, SEEK_END);
-	copyLeft = curFileHandle.pos();
-	curFileHandle.seek(0, SEEK_SET);
-	// Write size of compressed data
-	_output_smp.writeUint32LE(copyLeft);
-	// Write actual data
-	while (copyLeft > 0) {
-		doneRead = curFileHandle.read_noThrow(buffer, copyLeft > sizeof(buffer) ? sizeof(buffer) : copyLeft);
-		if (doneRead <= 0)
-			break;
-		copyLeft -= (int)doneRead;
-		_output_smp.write(buffer, doneRead);
-	}
+	TinselSampleJob *job = new TinselSampleJob(_output_smp);
+	job->setRawData((char *)outBuffer, decodedCount * 2, 22050);
+	queueEncode(job);
 }
 
 void CompressTinsel::execute() {
@@ -296,13 +212,14 @@ void CompressTinsel::execute() {
 			sampleSize = _input_smp.readUint32LE();
 
 			// Write offset of new data to new index file
-			_output_idx.writeUint32LE(_output_smp.pos());
+			TinselIndexJob *indexJob = new TinselIndexJob(_output_idx, _output_smp);
 
 			if (sampleSize & 0x80000000) {
 				// multiple samples in ADPCM format
 				sampleCount = sampleSize & ~0x80000000;
 				// Write sample count to new sample file
-				_output_smp.writeUint32LE(sampleSize);
+				indexJob->setSampleCount(sampleSize);
+				queueEncode(indexJob);
 				while (sampleCount>0) {
 					sampleSize = _input_smp.readUint32LE();
 					convertTinselADPCMSample(sampleSize);
@@ -310,28 +227,29 @@ void CompressTinsel::execute() {
 				}
 			} else {
 				// just one sample in raw format
+				queueEncode(indexJob);
 				convertTinselRawSample(sampleSize);
 			}
 		} else {
+			TinselIndexJob *indexJob = new TinselIndexJob(_output_idx, _output_smp);
 			if (indexNo==0) {
 				// Write signature as index 0
 				switch (_format) {
-				case AUDIO_MP3: _output_idx.writeUint32BE(MKID_BE('MP3 ')); break;
-				case AUDIO_VORBIS: _output_idx.writeUint32BE(MKID_BE('OGG ')); break;
-				case AUDIO_FLAC: _output_idx.writeUint32BE(MKID_BE('FLAC')); break;
-				default: throw ToolException("Unknown audio format!");
+				case AUDIO_MP3: indexJob->setSignature(MKID_BE('MP3 ')); break;
+				case AUDIO_VORBIS: indexJob->setSignature(MKID_BE('OGG ')); break;
+				case AUDIO_FLAC: indexJob->setSignature(MKID_BE('FLAC')); break;
+				default: delete indexJob; throw ToolException("Unknown audio format!");
 				}
 			} else {
-				_output_idx.writeUint32LE(0);
+				indexJob->setValue(0);
 			}
+			queueEncode(indexJob);
 		}
 		loopCount--;
 		indexNo++;
 	}
 
-	/* And some clean-up :-) */
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(TEMP_ENC);
+	flushEncodeQueue();
 }
 
 
@@ -28,12 +28,16 @@
 class CompressTinsel : public CompressionTool {
 public:
 	CompressTinsel(const std::string &name = "compress_tinsel");
+	~CompressTinsel();
 
 	virtual void execute();
 
 protected:
 	Common::File _input_idx, _input_smp, _output_idx, _output_smp;
+	byte *_inBuffer;
+	uint32 _inBufferSize;
 
+	byte *getInputBuffer(uint32 size);
 	void convertTinselRawSample(uint32 sampleSize);
 	void convertTinselADPCMSample(uint32 sampleSize);
 };
@@ -25,50 +25,197 @@
 #include "common/util.h"
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
 namespace Audio {
 
-// TODO: Switch from a SeekableReadStream to a plain ReadStream. This requires
-// some internal refactoring but is definitely possible and will increase the
-// flexibility of this code.
+// Routines to convert 12 bit linear samples to the
+// Dialogic or Oki ADPCM coding format aka VOX.
+// See also <http://www.comptek.ru/telephony/tnotes/tt1-13.html>
+//
+// In addition, also MS IMA ADPCM is supported. See
+//   <http://wiki.multimedia.cx/index.php?title=Microsoft_IMA_ADPCM>.
+
+struct IMAStatus {
+	int32 last;
+	int32 stepIndex;
+};
+
+struct ADPCMChannelStatus {
+	byte predictor;
+	int16 delta;
+	int16 coeff1;
+	int16 coeff2;
+	int16 sample1;
+	int16 sample2;
+};
+
+// adjust the step for use on the next sample.
+static inline int16 stepAdjust(byte code) {
+	static const int16 adjusts[] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+	return adjusts[code & 0x07];
+}
+
+static const int16 okiStepSize[49] = {
+	  16,   17,   19,   21,   23,   25,   28,   31,
+	  34,   37,   41,   45,   50,   55,   60,   66,
+	  73,   80,   88,   97,  107,  118,  130,  143,
+	 157,  173,  190,  209,  230,  253,  279,  307,
+	 337,  371,  408,  449,  494,  544,  598,  658,
+	 724,  796,  876,  963, 1060, 1166, 1282, 1411,
+	1552
+};
+
+// Decode Linear to ADPCM
+static inline int16 decodeOKI(IMAStatus &s, byte code) {
+	int16 diff, E, samp;
+
+	E = (2 * (code & 0x7) + 1) * okiStepSize[s.stepIndex] / 8;
+	diff = (code & 0x08) ? -E : E;
+	samp = s.last + diff;
+
+    // Clip the values to +/- 2^11 (supposed to be 12 bits)
+	if (samp > 2048)
+		samp = 2048;
+	if (samp < -2048)
+		samp = -2048;
+
+	s.last = samp;
+	s.stepIndex += stepAdjust(code);
+	if (s.stepIndex < 0)
+		s.stepIndex = 0;
+	if (s.stepIndex > ARRAYSIZE(okiStepSize) - 1)
+		s.stepIndex = ARRAYSIZE(okiStepSize) - 1;
+
+	// * 16 effectively converts 12-bit input to 16-bit output
+	return samp * 16;
+}
+
+
+static const uint16 imaStepTable[89] = {
+		7,	  8,	9,	 10,   11,	 12,   13,	 14,
+	   16,	 17,   19,	 21,   23,	 25,   28,	 31,
+	   34,	 37,   41,	 45,   50,	 55,   60,	 66,
+	   73,	 80,   88,	 97,  107,	118,  130,	143,
+	  157,	173,  190,	209,  230,	253,  279,	307,
+	  337,	371,  408,	449,  494,	544,  598,	658,
+	  724,	796,  876,	963, 1060, 1166, 1282, 1411,
+	 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+	 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+	 7132, 7845, 8630, 9493,10442,11487,12635,13899,
+	15289,16818,18500,20350,22385,24623,27086,29794,
+	32767
+};
+
+static inline int16 decodeMSIMA(IMAStatus &s, byte code) {
+	int32 diff, E, samp;
+
+	E = (2 * (code & 0x7) + 1) * imaStepTable[s.stepIndex] / 8;
+	diff = (code & 0x08) ? -E : E;
+	samp = s.last + diff;
+
+	if (samp < -0x8000)
+		samp = -0x8000;
+	else if (samp > 0x7fff)
+		samp = 0x7fff;
+
+	s.last = samp;
+
+	s.stepIndex += stepAdjust(code);
+	if (s.stepIndex < 0)
+		s.stepIndex = 0;
+	if (s.stepIndex > ARRAYSIZE(imaStepTable) - 1)
+		s.stepIndex = ARRAYSIZE(imaStepTable) - 1;
+
+	return samp;
+}
+
+static const int MSADPCMAdaptCoeff1[] = {
+	256, 512, 0, 192, 240, 460, 392
+};
+
+static const int MSADPCMAdaptCoeff2[] = {
+	0, -256, 0, 64, 0, -208, -232
+};
+
+static const int MSADPCMAdaptationTable[] = {
+	230, 230, 230, 230, 307, 409, 512, 614,
+	768, 614, 512, 409, 307, 230, 230, 230
+};
+
+
+static inline int16 decodeMS(ADPCMChannelStatus &c, byte code) {
+	int32 predictor;
+
+	predictor = (((c.sample1) * (c.coeff1)) + ((c.sample2) * (c.coeff2))) / 256;
+	predictor += (signed)((code & 0x08) ? (code - 0x10) : (code)) * c.delta;
+
+	if (predictor < -0x8000)
+		predictor = -0x8000;
+	else if (predictor > 0x7fff)
+		predictor = 0x7fff;
+
+	c.sample2 = c.sample1;
+	c.sample1 = predictor;
+	c.delta = (MSADPCMAdaptationTable[(int)code] * c.delta) >> 8;
+
+	if (c.delta < 16)
+		c.delta = 16;
+
+	return (int16)predictor;
+}
+
+// The block header holds the predictors, then the deltas, then the two
+// initial samples, each field interleaved by channel.
+static void readMSHeader(ADPCMChannelStatus &c, const byte *header, int channels, int channel) {
+	c.predictor = CLIP(header[channel], (byte)0, (byte)6);
+	c.coeff1 = MSADPCMAdaptCoeff1[c.predictor];
+	c.coeff2 = MSADPCMAdaptCoeff2[c.predictor];
+	c.delta = (int16)READ_LE_UINT16(header + channels + channel * 2);
+	c.sample1 = (int16)READ_LE_UINT16(header + channels * 3 + channel * 2);
+	c.sample2 = (int16)READ_LE_UINT16(header + channels * 5 + channel * 2);
+}
+
+/**
+ * Decodes ADPCM data block by block. The data comes either from memory or
+ * from a stream; a stream is read in chunks of up to BUFFER_SIZE bytes, but
+ * never beyond the size given to the constructor.
+ */
 class ADPCMInputStream : public AudioStream {
 private:
-	Common::File *_stream;
-	uint32 _endpos;
+	enum {
+		BUFFER_SIZE = 4096
+	};
+
+	Common::ReadStream *_stream;
+	uint32 _streamLeft;
+	byte *_buffer;
+	const byte *_data;
+	const byte *_dataEnd;
+
 	int _channels;
 	typesADPCM _type;
 	uint32 _blockAlign;
 	uint32 _blockPos;
-	int _blockLen;
 	int _rate;
 
-	struct ADPCMChannelStatus {
-		byte predictor;
-		int16 delta;
-		int16 coeff1;
-		int16 coeff2;
-		int16 sample1;
-		int16 sample2;
-	};
-
 	struct adpcmStatus {
 		// IMA
-		int32 last;
-		int32 stepIndex;
+		IMAStatus ima;
 
 		// MS ADPCM
 		ADPCMChannelStatus ch[2];
 	} _status;
 
-	int16 stepAdjust(byte);
-	int16 decodeOKI(byte);
-	int16 decodeMSIMA(byte);
-	int16 decodeMS(ADPCMChannelStatus *c, byte);
+	void init();
+	uint32 fillBuffer(uint32 needed);
 
 public:
-	ADPCMInputStream(Common::File *stream, uint32 size, typesADPCM type, int rate, int channels = 2, uint32 blockAlign = 0);
-	~ADPCMInputStream() {}
+	ADPCMInputStream(Common::ReadStream *stream, uint32 size, typesADPCM type, int rate, int channels = 2, uint32 blockAlign = 0);
+	ADPCMInputStream(const byte *data, uint32 size, typesADPCM type, int rate, int channels = 2, uint32 blockAlign = 0);
+	~ADPCMInputStream() { free(_buffer); }
 
 	int readBuffer(int16 *buffer, const int numSamples);
 	int readBufferOKI(int16 *buffer, const int numSamples);
@@ -76,31 +223,62 @@ public:
 	int readBufferMSIMA2(int16 *buffer, const int numSamples);
 	int readBufferMS(int channels, int16 *buffer, const int numSamples);
 
-	bool endOfData() const { return (_stream->eos() || _stream->pos() >= (int)_endpos); }
+	bool endOfData() const { return _data == _dataEnd && _streamLeft == 0; }
 	bool isStereo() const	{ return false; }
 	int getRate() const	{ return _rate; }
 };
 
-// Routines to convert 12 bit linear samples to the
-// Dialogic or Oki ADPCM coding format aka VOX.
-// See also <http://www.comptek.ru/telephony/tnotes/tt1-13.html>
-//
-// In addition, also MS IMA ADPCM is supported. See
-//   <http://wiki.multimedia.cx/index.php?title=Microsoft_IMA_ADPCM>.
+ADPCMInputStream::ADPCMInputStream(Common::ReadStream *stream, uint32 size, typesADPCM type, int rate, int channels, uint32 blockAlign)
+	: _stream(stream), _streamLeft(size), _channels(channels), _type(type), _blockAlign(blockAlign), _rate(rate) {
 
-ADPCMInputStream::ADPCMInputStream(Common::File *stream, uint32 size, typesADPCM type, int rate, int channels, uint32 blockAlign)
-	: _stream(stream), _channels(channels), _type(type), _blockAlign(blockAlign), _rate(rate) {
+	_buffer = (byte *)malloc(MIN<uint32>(size, BUFFER_SIZE) + 1);
+	assert(_buffer);
+	_data = _dataEnd = _buffer;
+	init();
+}
+
+ADPCMInputStream::ADPCMInputStream(const byte *data, uint32 size, typesADPCM type, int rate, int channels, uint32 blockAlign)
+	: _stream(NULL), _streamLeft(0), _buffer(NULL), _data(data), _dataEnd(data + size),
+	  _channels(channels), _type(type), _blockAlign(blockAlign), _rate(rate) {
+
+	init();
+}
 
-	_status.last = 0;
-	_status.stepIndex = 0;
+void ADPCMInputStream::init() {
+	_status.ima.last = 0;
+	_status.ima.stepIndex = 0;
 	memset(_status.ch, 0, sizeof(_status.ch));
-	_endpos = stream->pos() + size;
-	_blockPos = _blockLen = 0;
+	// The first block starts with a header as well
+	_blockPos = _blockAlign;
 
-	if (type == kADPCMMSIma && blockAlign == 0)
+	if (_type == kADPCMMSIma && _blockAlign == 0)
 		error("ADPCMInputStream(): blockAlign isn't specifiled for MS IMA ADPCM");
-	if (type == kADPCMMS && blockAlign == 0)
+	if (_type == kADPCMMS && _blockAlign == 0)
 		error("ADPCMInputStream(): blockAlign isn't specifiled for MS ADPCM");
+	if ((_type == kADPCMMSIma && _channels == 1 && _blockAlign <= 4) || (_type == kADPCMMS && _blockAlign < (uint32)_channels * 7))
+		error("ADPCMInputStream(): blockAlign leaves no room for the block header and data");
+}
+
+/**
+ * Makes at least needed bytes available between _data and _dataEnd, unless
+ * the data ends before that.
+ *
+ * @return the number of bytes available
+ */
+uint32 ADPCMInputStream::fillBuffer(uint32 needed) {
+	uint32 avail = _dataEnd - _data;
+	if (avail >= needed || _streamLeft == 0)
+		return avail;
+
+	memmove(_buffer, _data, avail);
+	uint32 toRead = MIN<uint32>(_streamLeft, BUFFER_SIZE - avail);
+	uint32 bytesRead = _stream->read(_buffer + avail, toRead);
+	// A stream ending early ends the sample data
+	_streamLeft = (bytesRead == toRead) ? _streamLeft - toRead : 0;
+
+	_data = _buffer;
+	_dataEnd = _buffer + avail + bytesRead;
+	return avail + bytesRead;
 }
 
 int ADPCMInputStream::readBuffer(int16 *buffer, const int numSamples) {
@@ -125,43 +303,64 @@ int ADPCMInputStream::readBuffer(int16 *buffer, const int numSamples) {
 }
 
 int ADPCMInputStream::readBufferOKI(int16 *buffer, const int numSamples) {
-	int samples;
-	byte data;
+	IMAStatus status = _status.ima;
+	int samples = 0;
 
 	assert(numSamples % 2 == 0);
 
-	for (samples = 0; samples < numSamples && !_stream->eos() && _stream->pos() < (int)_endpos; samples += 2) {
-		data = _stream->readByte();
-		WRITE_LE_UINT16(buffer + samples,     decodeOKI((data >> 4) & 0x0f));
-		WRITE_LE_UINT16(buffer + samples + 1, decodeOKI(data & 0x0f));
+	while (samples < numSamples) {
+		uint32 count = MIN<uint32>(fillBuffer(1), (numSamples - samples) / 2);
+		if (count == 0)
+			break;
+
+		const byte *data = _data;
+		for (const byte *end = data + count; data < end; data++, samples += 2) {
+			WRITE_LE_UINT16(buffer + samples,     decodeOKI(status, (*data >> 4) & 0x0f));
+			WRITE_LE_UINT16(buffer + samples + 1, decodeOKI(status, *data & 0x0f));
+		}
+		_data = data;
 	}
+
+	_status.ima = status;
 	return samples;
 }
 
 
 int ADPCMInputStream::readBufferMSIMA1(int16 *buffer, const int numSamples) {
-	int samples;
-	byte data;
+	IMAStatus status = _status.ima;
+	int samples = 0;
 
 	assert(numSamples % 2 == 0);
 
-	samples = 0;
-
-	while (samples < numSamples && !_stream->eos() && _stream->pos() < (int)_endpos) {
+	while (samples < numSamples) {
 		if (_blockPos == _blockAlign) {
 			// read block header
-			_status.last = _stream->readSint16LE();
-			_status.stepIndex = _stream->readSint16LE();
+			if (fillBuffer(4) < 4) {
+				_data = _dataEnd;
+				break;
+			}
+			status.last = (int16)READ_LE_UINT16(_data);
+			status.stepIndex = CLIP<int32>((int16)READ_LE_UINT16(_data + 2), 0, ARRAYSIZE(imaStepTable) - 1);
+			_data += 4;
 			_blockPos = 4;
 		}
 
-		for (; samples < numSamples && _blockPos < _blockAlign && !_stream->eos() && _stream->pos() < (int)_endpos; samples += 2) {
-			data = _stream->readByte();
-			_blockPos++;
-			WRITE_LE_UINT16(buffer + samples,     decodeMSIMA(data & 0x0f));
-			WRITE_LE_UINT16(buffer + samples + 1, decodeMSIMA((data >> 4) & 0x0f));
+		uint32 avail = fillBuffer(1);
+		if (avail == 0)
+			break;
+		uint32 count = MIN<uint32>(avail, (numSamples - samples) / 2);
+		count = MIN<uint32>(count, _blockAlign - _blockPos);
+
+		const byte *data = _data;
+		for (const byte *end = data + count; data < end; data++, samples += 2) {
+			WRITE_LE_UINT16(buffer + samples,     decodeMSIMA(status, *data & 0x0f));
+			WRITE_LE_UINT16(buffer + samples + 1, decodeMSIMA(status, (*data >> 4) & 0x0f));
 		}
+		_data = data;
+		_blockPos += count;
 	}
+
+	_status.ima = status;
 	return samples;
 }
 
@@ -169,190 +368,202 @@ int ADPCMInputStream::readBufferMSIMA1(int16 *buffer, const int numSamples) {
 // Microsoft as usual tries to implement it differently. This method
 // is used for stereo data.
 int ADPCMInputStream::readBufferMSIMA2(int16 *buffer, const int numSamples) {
-	int samples;
-	uint32 data;
-	int nibble;
-
-	for (samples = 0; samples < numSamples && !_stream->eos() && _stream->pos() < (int)_endpos;) {
-		for (int channel = 0; channel < 2; channel++) {
-			data = _stream->readUint32LE();
-
-			for (nibble = 0; nibble < 8; nibble++) {
-				byte k = ((data & 0xf0000000) >> 28);
-				WRITE_LE_UINT16(buffer + samples + channel + nibble * 2, decodeMSIMA(k));
-				data <<= 4;
+	IMAStatus status = _status.ima;
+	int samples = 0;
+
+	while (samples < numSamples) {
+		// Every 8 bytes hold 8 samples of each channel
+		uint32 avail = fillBuffer(8);
+		if (avail < 8) {
+			_data = _dataEnd;
+			break;
+		}
+		uint32 count = MIN<uint32>(avail / 8, (numSamples - samples + 15) / 16);
+
+		const byte *data = _data;
+		for (const byte *end = data + count * 8; data < end; data += 8, samples += 16) {
+			for (int channel = 0; channel < 2; channel++) {
+				uint32 word = READ_LE_UINT32(data + channel * 4);
+
+				for (int nibble = 0; nibble < 8; nibble++) {
+					WRITE_LE_UINT16(buffer + samples + channel + nibble * 2, decodeMSIMA(status, word >> 28));
+					word <<= 4;
+				}
 			}
 		}
-		samples += 16;
+		_data = data;
 	}
+
+	_status.ima = status;
 	return samples;
 }
 
-static const int MSADPCMAdaptCoeff1[] = {
-	256, 512, 0, 192, 240, 460, 392
-};
-
-static const int MSADPCMAdaptCoeff2[] = {
-	0, -256, 0, 64, 0, -208, -232
-};
-
 int ADPCMInputStream::readBufferMS(int channels, int16 *buffer, const int numSamples) {
-	int samples;
-	byte data;
-	int stereo = channels - 1; // We use it in index
+	ADPCMChannelStatus &left = _status.ch[0];
+	ADPCMChannelStatus &right = _status.ch[channels - 1];
+	int samples = 0;
 
-	samples = 0;
-
-	while (samples < numSamples && !_stream->eos() && _stream->pos() < (int)_endpos) {
+	while (samples < numSamples) {
 		if (_blockPos == _blockAlign) {
 			// read block header
-			_status.ch[0].predictor = CLIP(_stream->readByte(), (byte)0, (byte)6);
-			_status.ch[0].coeff1 = MSADPCMAdaptCoeff1[_status.ch[0].predictor];
-			_status.ch[0].coeff2 = MSADPCMAdaptCoeff2[_status.ch[0].predictor];
-			if (stereo) {
-				_status.ch[1].predictor = CLIP(_stream->readByte(), (byte)0, (byte)6);
-				_status.ch[1].coeff1 = MSADPCMAdaptCoeff1[_status.ch[1].predictor];
-				_status.ch[1].coeff2 = MSADPCMAdaptCoeff2[_status.ch[1].predictor];
+			uint32 headerSize = channels * 7;
+			if (fillBuffer(headerSize) < headerSize) {
+				_data = _dataEnd;
+				break;
 			}
 
-			_status.ch[0].delta = _stream->readSint16LE();
-			if (stereo)
-				_status.ch[1].delta = _stream->readSint16LE();
+			readMSHeader(_status.ch[0], _data, channels, 0);
+			if (channels == 2)
+				readMSHeader(_status.ch[1], _data, channels, 1);
 
-			buffer[samples++] = _status.ch[0].sample1 = _stream->readSint16LE();
-			if (stereo)
-				buffer[samples++] = _status.ch[1].sample1 = _stream->readSint16LE();
+			buffer[samples++] = _status.ch[0].sample1;
+			if (channels == 2)
+				buffer[samples++] = _status.ch[1].sample1;
 
-			buffer[samples++] = _status.ch[0].sample2 = _stream->readSint16LE();
-			if (stereo)
-				buffer[samples++] = _status.ch[1].sample2 = _stream->readSint16LE();
+			buffer[samples++] = _status.ch[0].sample2;
+			if (channels == 2)
+				buffer[samples++] = _status.ch[1].sample2;
 
-			_blockPos = channels * 7;
+			_data += headerSize;
+			_blockPos = headerSize;
 		}
 
+		uint32 avail = fillBuffer(1);
+		if (avail == 0)
+			break;
+		uint32 count = MIN<uint32>(avail, (numSamples - samples + 1) / 2);
+		count = MIN<uint32>(count, _blockAlign - _blockPos);
 
-		for (; samples < numSamples && _blockPos < _blockAlign && !_stream->eos() && _stream->pos() < (int)_endpos; samples += 2) {
-			data = _stream->readByte();
-			_blockPos++;
-			WRITE_LE_UINT16(buffer + samples,     decodeMS(&_status.ch[0], (data >> 4) & 0x0f));
-			WRITE_LE_UINT16(buffer + samples + 1, decodeMS(&_status.ch[stereo], data & 0x0f));
+		const byte *data = _data;
+		for (const byte *end = data + count; data < end; data++, samples += 2) {
+			WRITE_LE_UINT16(buffer + samples,     decodeMS(left, (*data >> 4) & 0x0f));
+			WRITE_LE_UINT16(buffer + samples + 1, decodeMS(right, *data & 0x0f));
 		}
+		_data = data;
+		_blockPos += count;
 	}
 
 	return samples;
 }
 
-
-// adjust the step for use on the next sample.
-int16 ADPCMInputStream::stepAdjust(byte code) {
-	static const int16 adjusts[] = {-1, -1, -1, -1, 2, 4, 6, 8};
-
-	return adjusts[code & 0x07];
-}
-
-static const int16 okiStepSize[49] = {
-	  16,   17,   19,   21,   23,   25,   28,   31,
-	  34,   37,   41,   45,   50,   55,   60,   66,
-	  73,   80,   88,   97,  107,  118,  130,  143,
-	 157,  173,  190,  209,  230,  253,  279,  307,
-	 337,  371,  408,  449,  494,  544,  598,  658,
-	 724,  796,  876,  963, 1060, 1166, 1282, 1411,
-	1552
+const double TinselFilterTable[4][2] = {
+	{0, 0 },
+	{0.9375, 0},
+	{1.796875, -0.8125},
+	{1.53125, -0.859375}
 };
 
-// Decode Linear to ADPCM
-int16 ADPCMInputStream::decodeOKI(byte code) {
-	int16 diff, E, samp;
-
-	E = (2 * (code & 0x7) + 1) * okiStepSize[_status.stepIndex] / 8;
-	diff = (code & 0x08) ? -E : E;
-	samp = _status.last + diff;
-
-    // Clip the values to +/- 2^11 (supposed to be 12 bits)
-	if (samp > 2048)
-		samp = 2048;
-	if (samp < -2048)
-		samp = -2048;
-
-	_status.last = samp;
-	_status.stepIndex += stepAdjust(code);
-	if (_status.stepIndex < 0)
-		_status.stepIndex = 0;
-	if (_status.stepIndex > ARRAYSIZE(okiStepSize) - 1)
-		_status.stepIndex = ARRAYSIZE(okiStepSize) - 1;
-
-	// * 16 effectively converts 12-bit input to 16-bit output
-	return samp * 16;
-}
-
-
-static const uint16 imaStepTable[89] = {
-		7,	  8,	9,	 10,   11,	 12,   13,	 14,
-	   16,	 17,   19,	 21,   23,	 25,   28,	 31,
-	   34,	 37,   41,	 45,   50,	 55,   60,	 66,
-	   73,	 80,   88,	 97,  107,	118,  130,	143,
-	  157,	173,  190,	209,  230,	253,  279,	307,
-	  337,	371,  408,	449,  494,	544,  598,	658,
-	  724,	796,  876,	963, 1060, 1166, 1282, 1411,
-	 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
-	 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
-	 7132, 7845, 8630, 9493,10442,11487,12635,13899,
-	15289,16818,18500,20350,22385,24623,27086,29794,
-	32767
+// The predictor has to stay in double precision: eVal is not a power of two,
+// so fixed point math would round differently from the samples the tools
+// have always produced.
+struct Tinsel6Status {
+	double scale;
+	double k0, k1;
+	double d0, d1;
 };
 
-int16 ADPCMInputStream::decodeMSIMA(byte code) {
-	int32 diff, E, samp;
-
-	E = (2 * (code & 0x7) + 1) * imaStepTable[_status.stepIndex] / 8;
-	diff = (code & 0x08) ? -E : E;
-	samp = _status.last + diff;
-
-	if (samp < -0x8000)
-		samp = -0x8000;
-	else if (samp > 0x7fff)
-		samp = 0x7fff;
-
-	_status.last = samp;
-
-	_status.stepIndex += stepAdjust(code);
-	if (_status.stepIndex < 0)
-		_status.stepIndex = 0;
-	if (_status.stepIndex > ARRAYSIZE(imaStepTable) - 1)
-		_status.stepIndex = ARRAYSIZE(imaStepTable) - 1;
-
-	return samp;
+// Filters 0 and 1 have zero coefficients; leaving out their products gives
+// the same sums, and a much shorter dependency from one sample to the next.
+template<int filter>
+static inline void writeTinsel6(byte *&out, Tinsel6Status &s, int16 chunkWord) {
+	double sample = chunkWord * s.scale;
+	if (filter == 1)
+		sample += s.d0 * s.k0;
+	else if (filter > 1)
+		sample += (s.d0 * s.k0) + (s.d1 * s.k1);
+	s.d1 = s.d0;
+	s.d0 = sample;
+
+	if (sample < -32768.0)
+		sample = -32768.0;
+	else if (sample > 32767.0)
+		sample = 32767.0;
+	WRITE_LE_UINT16(out, (int16)sample);
+	out += 2;
 }
 
-static const int MSADPCMAdaptationTable[] = {
-	230, 230, 230, 230, 307, 409, 512, 614,
-	768, 614, 512, 409, 307, 230, 230, 230
-};
-
-
-int16 ADPCMInputStream::decodeMS(ADPCMChannelStatus *c, byte code) {
-	int32 predictor;
-
-	predictor = (((c->sample1) * (c->coeff1)) + ((c->sample2) * (c->coeff2))) / 256;
-	predictor += (signed)((code & 0x08) ? (code - 0x10) : (code)) * c->delta;
-
-	if (predictor < -0x8000)
-		predictor = -0x8000;
-	else if (predictor > 0x7fff)
-		predictor = 0x7fff;
+// Decodes the 8 groups of 3 bytes following a block header, each group holding
+// 4 signed 6-bit samples. A clip may end inside a block, and its very last
+// sample is never decoded.
+template<int filter>
+static void decodeTinsel6Block(byte *&out, const byte *&in, const byte *end, Tinsel6Status &s) {
+	uint32 left = end - in;
+	uint32 groups = (left > 24) ? 8 : (left - 1) / 3;
+
+	for (; groups > 0; groups--) {
+		uint32 chunk = (in[0] << 16) | (in[1] << 8) | in[2];
+		writeTinsel6<filter>(out, s, (int16)((chunk >> 8) & 0xFC00));
+		writeTinsel6<filter>(out, s, (int16)((chunk >> 2) & 0xFC00));
+		writeTinsel6<filter>(out, s, (int16)((chunk << 4) & 0xFC00));
+		writeTinsel6<filter>(out, s, (int16)((chunk << 10) & 0xFC00));
+		in += 3;
+	}
 
-	c->sample2 = c->sample1;
-	c->sample1 = predictor;
-	c->delta = (MSADPCMAdaptationTable[(int)code] * c->delta) >> 8;
+	if (left <= 24) {
+		left = end - in;
+		uint32 chunk = in[0] << 16;
+		if (left > 1)
+			chunk |= in[1] << 8;
+		if (left > 2)
+			chunk |= in[2];
+
+		writeTinsel6<filter>(out, s, (int16)((chunk >> 8) & 0xFC00));
+		if (left > 1)
+			writeTinsel6<filter>(out, s, (int16)((chunk >> 2) & 0xFC00));
+		if (left > 2)
+			writeTinsel6<filter>(out, s, (int16)((chunk << 4) & 0xFC00));
+		in = end;
+	}
+}
 
-	if (c->delta < 16)
-		c->delta = 16;
+uint32 decodeTinsel6(byte *out, const byte *in, uint32 size) {
+	const double eVal = 1.032226562;
+	const byte *end = in + size;
+	byte *start = out;
+	Tinsel6Status s;
+
+	s.d0 = s.d1 = 0;
+
+	while (end - in >= 2) {
+		byte headerByte = *in++;
+		byte filterVal = (headerByte & 0xC0) >> 6;
+		double predictor;
+
+		if ((headerByte & 0x20) != 0) {
+			// Lower 6 bit are negative
+			headerByte = ~(headerByte | 0xC0) + 1;
+			predictor = 1 << headerByte;
+		} else {
+			// Lower 6 bit are positive
+			headerByte &= 0x1F;
+			predictor = ((double) 1.0) / (1 << headerByte);
+		}
+		s.scale = eVal * predictor;
+		s.k0 = TinselFilterTable[filterVal][0];
+		s.k1 = TinselFilterTable[filterVal][1];
+
+		switch (filterVal) {
+		case 0:
+			decodeTinsel6Block<0>(out, in, end, s);
+			break;
+		case 1:
+			decodeTinsel6Block<1>(out, in, end, s);
+			break;
+		default:
+			decodeTinsel6Block<2>(out, in, end, s);
+			break;
+		}
+	}
 
-	return (int16)predictor;
+	return (out - start) / 2;
 }
 
-AudioStream *makeADPCMStream(Common::File *stream, uint32 size, typesADPCM type, int rate, int channels, uint32 blockAlign) {
+AudioStream *makeADPCMStream(Common::ReadStream *stream, uint32 size, typesADPCM type, int rate, int channels, uint32 blockAlign) {
 	return new ADPCMInputStream(stream, size, type, rate, channels, blockAlign);
 }
 
+AudioStream *makeADPCMStream(const byte *data, uint32 size, typesADPCM type, int rate, int channels, uint32 blockAlign) {
+	return new ADPCMInputStream(data, size, type, rate, channels, blockAlign);
+}
+
 } // End of namespace Audio
@@ -24,7 +24,7 @@
 #define SOUND_ADPCM_H
 
 #include "sound/audiostream.h"
-#include "common/file.h"
+#include "common/stream.h"
 
 namespace Audio {
 
@@ -36,7 +36,32 @@ enum typesADPCM {
 	kADPCMMS
 };
 
-AudioStream *makeADPCMStream(Common::File *stream, uint32 size, typesADPCM type, int rate = 22050, int channels = 2, uint32 blockAlign = 0);
+/**
+ * Creates a stream decoding size bytes of ADPCM data from stream, starting at
+ * its current position. The data is read ahead in chunks, but never beyond
+ * those size bytes. The stream is not deleted with the audio stream.
+ */
+AudioStream *makeADPCMStream(Common::ReadStream *stream, uint32 size, typesADPCM type, int rate = 22050, int channels = 2, uint32 blockAlign = 0);
+
+/**
+ * Creates a stream decoding size bytes of ADPCM data straight from memory,
+ * such as a sample loaded from an archive. The data must stay valid for the
+ * lifetime of the audio stream, which does not free it.
+ */
+AudioStream *makeADPCMStream(const byte *data, uint32 size, typesADPCM type, int rate = 22050, int channels = 2, uint32 blockAlign = 0);
+
+/**
+ * Decodes the 6-bit ADPCM of Tinsel (DiscWorld 2) speech samples: blocks of
+ * a header byte followed by 24 bytes, every 3 bytes holding 4 samples. The
+ * mono 16-bit samples are written in little endian byte order, so out must
+ * hold 8 * (size / 3 + 1) bytes.
+ *
+ * @return the number of samples written to out
+ */
+uint32 decodeTinsel6(byte *out, const byte *in, uint32 size);
+
+/** The prediction filters of Tinsel 6-bit ADPCM, picked by the top 2 bits of each block header */
+extern const double TinselFilterTable[4][2];
 
 } // End of namespace Audio
 
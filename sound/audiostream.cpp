@@ -21,6 +21,7 @@
  */
 
 #include "audiostream.h"
+#include "pcm.h"
 
 #include "common/endian.h"
 #include "common/util.h"
@@ -69,6 +70,10 @@ protected:
 	const int _rate;
 	const byte *_origPtr;
 
+	enum {
+		FORMAT_FLAGS = (is16Bit ? Mixer::FLAG_16BITS : 0) | (isUnsigned ? Mixer::FLAG_UNSIGNED : 0) | (isLE ? Mixer::FLAG_LITTLE_ENDIAN : 0)
+	};
+
 	inline bool eosIntern() const	{ return _ptr >= _end; }
 public:
 	LinearMemoryStream(int rate, const byte *ptr, uint32 len, uint32 loopOffset, uint32 loopLen, bool autoFreeMemory)
@@ -105,11 +110,10 @@ int LinearMemoryStream<stereo, is16Bit, isUnsigned, isLE>::readBuffer(int16 *buf
 	int samples = 0;
 	while (samples < numSamples && !eosIntern()) {
 		const int len = MIN(numSamples, samples + (int)(_end - _ptr) / (is16Bit ? 2 : 1));
-		while (samples < len) {
-			*buffer++ = READ_ENDIAN_SAMPLE(is16Bit, isUnsigned, _ptr, isLE);
-			_ptr += (is16Bit ? 2 : 1);
-			samples++;
-		}
+		convertPCMToInt16(buffer, _ptr, len - samples, FORMAT_FLAGS);
+		buffer += len - samples;
+		_ptr += (len - samples) * (is16Bit ? 2 : 1);
+		samples = len;
 		// Loop, if looping was specified
 		if (_loopPtr && eosIntern()) {
 			_ptr = _loopPtr;
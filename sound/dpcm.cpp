@@ -0,0 +1,131 @@
+/* Scumm Tools
+ * Copyright (C) 2004-2006  The ScummVM Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#include "sound/dpcm.h"
+#include "common/endian.h"
+
+namespace Audio {
+
+static const uint16 tableDPCM16[128] = {
+	0x0000, 0x0008, 0x0010, 0x0020, 0x0030, 0x0040, 0x0050, 0x0060, 0x0070, 0x0080,
+	0x0090, 0x00A0, 0x00B0, 0x00C0, 0x00D0, 0x00E0, 0x00F0, 0x0100, 0x0110, 0x0120,
+	0x0130, 0x0140, 0x0150, 0x0160, 0x0170, 0x0180, 0x0190, 0x01A0, 0x01B0, 0x01C0,
+	0x01D0, 0x01E0, 0x01F0, 0x0200, 0x0208, 0x0210, 0x0218, 0x0220, 0x0228, 0x0230,
+	0x0238, 0x0240, 0x0248, 0x0250, 0x0258, 0x0260, 0x0268, 0x0270, 0x0278, 0x0280,
+	0x0288, 0x0290, 0x0298, 0x02A0, 0x02A8, 0x02B0, 0x02B8, 0x02C0, 0x02C8, 0x02D0,
+	0x02D8, 0x02E0, 0x02E8, 0x02F0, 0x02F8, 0x0300, 0x0308, 0x0310, 0x0318, 0x0320,
+	0x0328, 0x0330, 0x0338, 0x0340, 0x0348, 0x0350, 0x0358, 0x0360, 0x0368, 0x0370,
+	0x0378, 0x0380, 0x0388, 0x0390, 0x0398, 0x03A0, 0x03A8, 0x03B0, 0x03B8, 0x03C0,
+	0x03C8, 0x03D0, 0x03D8, 0x03E0, 0x03E8, 0x03F0, 0x03F8, 0x0400, 0x0440, 0x0480,
+	0x04C0, 0x0500, 0x0540, 0x0580, 0x05C0, 0x0600, 0x0640, 0x0680, 0x06C0, 0x0700,
+	0x0740, 0x0780, 0x07C0, 0x0800, 0x0900, 0x0A00, 0x0B00, 0x0C00, 0x0D00, 0x0E00,
+	0x0F00, 0x1000, 0x1400, 0x1800, 0x1C00, 0x2000, 0x3000, 0x4000
+};
+
+// The deltas for both halves of a byte of 8-bit DPCM
+static const int8 tableDPCM8[16] = {
+	0, 1, 2, 3, 6, 10, 15, 21,
+	-21, -15, -10, -6, -3, -2, -1, 0
+};
+// TODO: SCI2.1 reverses the order of the negative values, but there is no
+// easy way to identify SCI2.1+ yet
+
+static inline int32 clipDPCM16(int32 s) {
+	if (s < -32768)
+		return -32768;
+	if (s > 32767)
+		return 32767;
+	return s;
+}
+
+void decodeSOLDPCM16(byte *out, const byte *in, uint32 size) {
+	int32 s = 0;
+	uint32 i = 0;
+
+	// Whole blocks of samples which can't go out of range are decoded
+	// without clipping. That is most of them, unless the sound is very loud.
+	while (i + 8 <= size) {
+		int32 range = 0;
+		for (int j = 0; j < 8; j++)
+			range += tableDPCM16[in[i + j] & 0x7f];
+
+		if (s - range >= -32768 && s + range <= 32767) {
+			for (int j = 0; j < 8; j++, i++) {
+				byte b = in[i];
+				if (b & 0x80)
+					s -= tableDPCM16[b & 0x7f];
+				else
+					s += tableDPCM16[b];
+				WRITE_LE_UINT16(out + i * 2, s);
+			}
+		} else {
+			for (int j = 0; j < 8; j++, i++) {
+				byte b = in[i];
+				if (b & 0x80)
+					s = clipDPCM16(s - tableDPCM16[b & 0x7f]);
+				else
+					s = clipDPCM16(s + tableDPCM16[b]);
+				WRITE_LE_UINT16(out + i * 2, s);
+			}
+		}
+	}
+
+	for (; i < size; i++) {
+		byte b = in[i];
+		if (b & 0x80)
+			s = clipDPCM16(s - tableDPCM16[b & 0x7f]);
+		else
+			s = clipDPCM16(s + tableDPCM16[b]);
+		WRITE_LE_UINT16(out + i * 2, s);
+	}
+}
+
+static inline int32 clipDPCM8(int32 s) {
+	if (s < 0)
+		return 0;
+	if (s > 255)
+		return 255;
+	return s;
+}
+
+void decodeSOLDPCM8(byte *out, const byte *in, uint32 size) {
+	int32 s = 0x80;
+
+	for (uint32 i = 0; i < size; i++) {
+		byte b = in[i];
+
+		// Two nibbles move the sample by 42 at most
+		if (s >= 42 && s <= 255 - 42) {
+			s += tableDPCM8[b >> 4];
+			*out++ = s;
+			s += tableDPCM8[b & 0xf];
+			*out++ = s;
+		} else {
+			s = clipDPCM8(s + tableDPCM8[b >> 4]);
+			*out++ = s;
+			s = clipDPCM8(s + tableDPCM8[b & 0xf]);
+			*out++ = s;
+		}
+	}
+}
+
+} // End of namespace Audio
@@ -0,0 +1,45 @@
+/* Scumm Tools
+ * Copyright (C) 2004-2006  The ScummVM Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#ifndef SOUND_DPCM_H
+#define SOUND_DPCM_H
+
+#include "common/scummsys.h"
+
+namespace Audio {
+
+/**
+ * Decodes the 16-bit DPCM of Sierra SOL audio. Every input byte becomes
+ * one sample; the samples are written in little endian byte order, so out
+ * must hold 2 * size bytes.
+ */
+void decodeSOLDPCM16(byte *out, const byte *in, uint32 size);
+
+/**
+ * Decodes the 8-bit DPCM of Sierra SOL audio. Every input byte holds two
+ * unsigned 8-bit samples, so out must hold 2 * size bytes.
+ */
+void decodeSOLDPCM8(byte *out, const byte *in, uint32 size);
+
+} // End of namespace Audio
+
+#endif
@@ -0,0 +1,176 @@
+/* Scumm Tools
+ * Copyright (C) 2004-2006  The ScummVM Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#include "sound/pcm.h"
+#include "sound/audiostream.h"
+#include "common/endian.h"
+
+// SSE2 is part of every x86-64 CPU; 32-bit builds only use it when the
+// compiler was told the CPU supports it.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Audio {
+
+template<bool is16Bit, bool isUnsigned, bool isLE>
+static inline int16 readSample(const byte *src) {
+	return (int16)READ_ENDIAN_SAMPLE(is16Bit, isUnsigned, src, isLE);
+}
+
+#ifdef USE_SSE2
+// Loads 8 samples as native signed 16-bit samples
+template<bool is16Bit, bool isUnsigned, bool isLE>
+static inline __m128i loadSamples(const byte *src) {
+	__m128i v;
+
+	if (is16Bit) {
+		v = _mm_loadu_si128((const __m128i *)src);
+		if (!isLE)
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+	} else {
+		// Interleaving with zeros puts each byte in the high half of a sample
+		v = _mm_unpacklo_epi8(_mm_setzero_si128(), _mm_loadl_epi64((const __m128i *)src));
+	}
+
+	if (isUnsigned)
+		v = _mm_xor_si128(v, _mm_set1_epi16((short)0x8000));
+	return v;
+}
+
+// Sign extends the low or high 4 samples to 32 bits, then shifts them down
+template<int shift>
+static inline __m128i widenLow(__m128i v) {
+	return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), shift);
+}
+
+template<int shift>
+static inline __m128i widenHigh(__m128i v) {
+	return _mm_srai_epi32(_mm_unpackhi_epi16(v, v), shift);
+}
+#endif
+
+template<bool is16Bit, bool isUnsigned, bool isLE>
+static void toInt16(int16 *dst, const byte *src, uint32 count) {
+	const int bytes = is16Bit ? 2 : 1;
+	uint32 i = 0;
+
+#ifdef USE_SSE2
+	for (; i + 8 <= count; i += 8)
+		_mm_storeu_si128((__m128i *)(dst + i), loadSamples<is16Bit, isUnsigned, isLE>(src + i * bytes));
+#endif
+	for (; i < count; i++)
+		dst[i] = readSample<is16Bit, isUnsigned, isLE>(src + i * bytes);
+}
+
+template<bool is16Bit, bool isUnsigned, bool isLE>
+static void toInt32(int32 *dst, const byte *src, uint32 count) {
+	const int bytes = is16Bit ? 2 : 1;
+	// 8-bit samples were scaled up while loading them
+	const int shift = is16Bit ? 0 : 8;
+	uint32 i = 0;
+
+#ifdef USE_SSE2
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = loadSamples<is16Bit, isUnsigned, isLE>(src + i * bytes);
+		_mm_storeu_si128((__m128i *)(dst + i), widenLow<16 + shift>(v));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), widenHigh<16 + shift>(v));
+	}
+#endif
+	for (; i < count; i++)
+		dst[i] = readSample<is16Bit, isUnsigned, isLE>(src + i * bytes) >> shift;
+}
+
+template<bool is16Bit, bool isUnsigned, bool isLE>
+static void toFloat(float *const *dst, const byte *src, uint32 frames, int channels) {
+	// Scaling by a power of two is exact, so this matches dividing by 32768
+	const float scale = 1.0f / 32768;
+	const int bytes = is16Bit ? 2 : 1;
+	uint32 i = 0;
+
+#ifdef USE_SSE2
+	const __m128 vscale = _mm_set1_ps(scale);
+
+	if (channels == 1) {
+		for (; i + 8 <= frames; i += 8) {
+			__m128i v = loadSamples<is16Bit, isUnsigned, isLE>(src + i * bytes);
+			_mm_storeu_ps(dst[0] + i, _mm_mul_ps(_mm_cvtepi32_ps(widenLow<16>(v)), vscale));
+			_mm_storeu_ps(dst[0] + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(widenHigh<16>(v)), vscale));
+		}
+	} else if (channels == 2) {
+		for (; i + 4 <= frames; i += 4) {
+			__m128i v = loadSamples<is16Bit, isUnsigned, isLE>(src + i * 2 * bytes);
+			__m128 low = _mm_mul_ps(_mm_cvtepi32_ps(widenLow<16>(v)), vscale);
+			__m128 high = _mm_mul_ps(_mm_cvtepi32_ps(widenHigh<16>(v)), vscale);
+			_mm_storeu_ps(dst[0] + i, _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(dst[1] + i, _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+#endif
+	for (; i < frames; i++) {
+		for (int j = 0; j < channels; j++)
+			dst[j][i] = readSample<is16Bit, isUnsigned, isLE>(src + (i * channels + j) * bytes) * scale;
+	}
+}
+
+// Calls CONVERT with the template arguments matching the flags. The byte
+// order does not matter for 8-bit samples.
+#define DISPATCH_PCM(CONVERT) \
+	if (flags & Mixer::FLAG_16BITS) { \
+		if (flags & Mixer::FLAG_LITTLE_ENDIAN) { \
+			if (flags & Mixer::FLAG_UNSIGNED) \
+				CONVERT(true, true, true); \
+			else \
+				CONVERT(true, false, true); \
+		} else { \
+			if (flags & Mixer::FLAG_UNSIGNED) \
+				CONVERT(true, true, false); \
+			else \
+				CONVERT(true, false, false); \
+		} \
+	} else { \
+		if (flags & Mixer::FLAG_UNSIGNED) \
+			CONVERT(false, true, false); \
+		else \
+			CONVERT(false, false, false); \
+	}
+
+void convertPCMToInt16(int16 *dst, const byte *src, uint32 count, byte flags) {
+#define TO_INT16(IS16BIT, UNSIGNED, LE) toInt16<IS16BIT, UNSIGNED, LE>(dst, src, count)
+	DISPATCH_PCM(TO_INT16)
+#undef TO_INT16
+}
+
+void convertPCMToInt32(int32 *dst, const byte *src, uint32 count, byte flags) {
+#define TO_INT32(IS16BIT, UNSIGNED, LE) toInt32<IS16BIT, UNSIGNED, LE>(dst, src, count)
+	DISPATCH_PCM(TO_INT32)
+#undef TO_INT32
+}
+
+void convertPCMToFloat(float *const *dst, const byte *src, uint32 frames, int channels, byte flags) {
+#define TO_FLOAT(IS16BIT, UNSIGNED, LE) toFloat<IS16BIT, UNSIGNED, LE>(dst, src, frames, channels)
+	DISPATCH_PCM(TO_FLOAT)
+#undef TO_FLOAT
+}
+
+} // End of namespace Audio
@@ -0,0 +1,57 @@
+/* Scumm Tools
+ * Copyright (C) 2004-2006  The ScummVM Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#ifndef SOUND_PCM_H
+#define SOUND_PCM_H
+
+#include "common/scummsys.h"
+
+namespace Audio {
+
+/*
+ * Conversion of raw PCM data to the sample formats the decoders and encoders
+ * work with. The source format is given by the Mixer flags FLAG_16BITS,
+ * FLAG_UNSIGNED and FLAG_LITTLE_ENDIAN, the other flags are ignored. Where
+ * the CPU allows it, the conversion uses SSE2.
+ */
+
+/**
+ * Converts count interleaved samples to native signed 16-bit samples;
+ * 8-bit samples are scaled up.
+ */
+void convertPCMToInt16(int16 *dst, const byte *src, uint32 count, byte flags);
+
+/**
+ * Converts count interleaved samples to signed 32-bit samples, keeping the
+ * range of the source, so 8-bit samples lie within -128 and 127.
+ */
+void convertPCMToInt32(int32 *dst, const byte *src, uint32 count, byte flags);
+
+/**
+ * Converts frames interleaved frames of the given number of channels to one
+ * plane of floats within -1.0 and 1.0 per channel.
+ */
+void convertPCMToFloat(float *const *dst, const byte *src, uint32 frames, int channels, byte flags);
+
+} // End of namespace Audio
+
+#endif
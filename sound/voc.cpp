@@ -24,7 +24,7 @@
 #include "audiostream.h"
 
 #include "common/endian.h"
-#include "common/file.h"
+#include "common/stream.h"
 #include "common/util.h"
 
 #include <assert.h>
@@ -47,17 +47,17 @@ int getSampleRateFromVOCRate(int vocSR) {
 	}
 }
 
-byte *loadVOCFromStream(Common::File &stream, int &size, int &rate, int &loops, int &begin_loop, int &end_loop) {
+byte *loadVOCFromStream(Common::ReadStream &stream, int &size, int &rate, int &loops, int &begin_loop, int &end_loop) {
 	VocFileHeader fileHeader;
 
-	if (stream.read_noThrow(&fileHeader, 8) != 8)
+	if (stream.read(&fileHeader, 8) != 8)
 		goto invalid;
 
 	if (!memcmp(&fileHeader, "VTLK", 4)) {
-		if (stream.read_noThrow(&fileHeader, sizeof(VocFileHeader)) != sizeof(VocFileHeader))
+		if (stream.read(&fileHeader, sizeof(VocFileHeader)) != sizeof(VocFileHeader))
 			goto invalid;
 	} else if (!memcmp(&fileHeader, "Creative", 8)) {
-		if (stream.read_noThrow(((byte *)&fileHeader) + 8, sizeof(VocFileHeader) - 8) != sizeof(VocFileHeader) - 8)
+		if (stream.read(((byte *)&fileHeader) + 8, sizeof(VocFileHeader) - 8) != sizeof(VocFileHeader) - 8)
 			goto invalid;
 	} else {
 	invalid:;
@@ -103,7 +103,7 @@ byte *loadVOCFromStream(Common::File &stream, int &size, int &rate, int &loops,
 				} else {
 					ret_sound = (byte *)malloc(len);
 				}
-				stream.read_noThrow(ret_sound + size, len);
+				stream.read(ret_sound + size, len);
 				size += len;
 				begin_loop = size;
 				end_loop = size;
@@ -127,12 +127,12 @@ byte *loadVOCFromStream(Common::File &stream, int &size, int &rate, int &loops,
 	return ret_sound;
 }
 
-byte *loadVOCFromStream(Common::File &stream, int &size, int &rate) {
+byte *loadVOCFromStream(Common::ReadStream &stream, int &size, int &rate) {
 	int loops, begin_loop, end_loop;
 	return loadVOCFromStream(stream, size, rate, loops, begin_loop, end_loop);
 }
 
-AudioStream *makeVOCStream(Common::File &stream) {
+AudioStream *makeVOCStream(Common::ReadStream &stream) {
 	int size, rate;
 	byte *data = loadVOCFromStream(stream, size, rate);
 
@@ -26,7 +26,7 @@
 #include "common/scummsys.h"
 
 namespace Common {
-	class File;
+	class ReadStream;
 }
 
 namespace Audio {
@@ -64,21 +64,21 @@ struct VocBlockHeader {
 extern int getSampleRateFromVOCRate(int vocSR);
 
 /**
- * Try to load a VOC from the given seekable stream. Returns a pointer to memory
+ * Try to load a VOC from the given stream. Returns a pointer to memory
  * containing the PCM sample data (allocated with malloc). It is the callers
  * responsibility to dellocate that data again later on! Currently this
  * function only supports uncompressed raw PCM data.
  */
-extern byte *loadVOCFromStream(Common::File &stream, int &size, int &rate);
+extern byte *loadVOCFromStream(Common::ReadStream &stream, int &size, int &rate);
 
 /**
- * Try to load a VOC from the given seekable stream and create an AudioStream
+ * Try to load a VOC from the given stream and create an AudioStream
  * from that data. Currently this function only supports uncompressed raw PCM
  * data. Looping is not supported.
  *
  * This function uses loadVOCFromStream() internally.
  */
-AudioStream *makeVOCStream(Common::File &stream);
+AudioStream *makeVOCStream(Common::ReadStream &stream);
 
 } // End of namespace Audio
 
@@ -22,7 +22,7 @@
 
 #include "sound/audiostream.h"
 #include "sound/adpcm.h"
-#include "common/file.h"
+#include "common/stream.h"
 #include "common/util.h"
 
 #include <stdlib.h>
@@ -31,13 +31,13 @@
 
 namespace Audio {
 
-bool loadWAVFromStream(Common::File &stream, int &size, int &rate, byte &flags, uint16 *wavType, int *blockAlign_) {
+bool loadWAVFromStream(Common::SeekableReadStream &stream, int &size, int &rate, byte &flags, uint16 *wavType, int *blockAlign_) {
 	const uint32 initialPos = stream.pos();
 	byte buf[4+1];
 
 	buf[4] = 0;
 
-	stream.read_noThrow(buf, 4);
+	stream.read(buf, 4);
 	if (memcmp(buf, "RIFF", 4) != 0) {
 		warning("getWavInfo: No 'RIFF' header");
 		return false;
@@ -45,13 +45,13 @@ bool loadWAVFromStream(Common::File &stream, int &size, int &rate, byte &flags,
 
 	uint32 wavLength = stream.readUint32LE();
 
-	stream.read_noThrow(buf, 4);
+	stream.read(buf, 4);
 	if (memcmp(buf, "WAVE", 4) != 0) {
 		warning("getWavInfo: No 'WAVE' header");
 		return false;
 	}
 
-	stream.read_noThrow(buf, 4);
+	stream.read(buf, 4);
 	if (memcmp(buf, "fmt ", 4) != 0) {
 		warning("getWavInfo: No 'fmt' header");
 		return false;
@@ -142,11 +142,11 @@ bool loadWAVFromStream(Common::File &stream, int &size, int &rate, byte &flags,
 
 	do {
 		stream.seek(offset, SEEK_CUR);
-		if (stream.pos() >= int(initialPos + wavLength + 8)) {
+		if (stream.pos() >= initialPos + wavLength + 8) {
 			warning("getWavInfo: Cannot find 'data' chunk");
 			return false;
 		}
-		stream.read_noThrow(buf, 4);
+		stream.read(buf, 4);
 		offset = stream.readUint32LE();
 
 #if 0
@@ -160,7 +160,7 @@ bool loadWAVFromStream(Common::File &stream, int &size, int &rate, byte &flags,
 	return true;
 }
 
-AudioStream *makeWAVStream(Common::File &stream) {
+AudioStream *makeWAVStream(Common::SeekableReadStream &stream) {
 	int size, rate;
 	byte flags;
 	uint16 type;
@@ -176,7 +176,7 @@ AudioStream *makeWAVStream(Common::File &stream) {
 
 	byte *data = (byte *)malloc(size);
 	assert(data);
-	stream.read_noThrow(data, size);
+	stream.read(data, size);
 
 	// Since we allocated our own buffer for the data, we must set the autofree flag.
 	flags |= Audio::Mixer::FLAG_AUTOFREE;
@@ -26,7 +26,7 @@
 #include "common/scummsys.h"
 
 namespace Common {
-	class File;
+	class SeekableReadStream;
 }
 
 namespace Audio {
@@ -40,7 +40,7 @@ class AudioStream;
  * necessary for playback. Currently this function only supports uncompressed
  * raw PCM data as well as IMA ADPCM.
  */
-extern bool loadWAVFromStream(Common::File &stream, int &size, int &rate, byte &flags, uint16 *wavType = 0, int *blockAlign = 0);
+extern bool loadWAVFromStream(Common::SeekableReadStream &stream, int &size, int &rate, byte &flags, uint16 *wavType = 0, int *blockAlign = 0);
 
 /**
  * Try to load a WAVE from the given seekable stream and create an AudioStream
@@ -49,7 +49,7 @@ extern bool loadWAVFromStream(Common::File &stream, int &size, int &rate, byte &
  *
  * This function uses loadWAVFromStream() internally.
  */
-AudioStream *makeWAVStream(Common::File &stream);
+AudioStream *makeWAVStream(Common::SeekableReadStream &stream);
 
 } // End of namespace Audio
 